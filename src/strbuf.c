@@ -3,6 +3,7 @@
 /* Copyright (C) 2013, 2020 Eric Herman <eric@freesa.org> */
 
 #include "strbuf.h"
+#include "strbuf_private.h"
 
 /* freestanding headers */
 #include <float.h>
@@ -18,7 +19,10 @@
 #include "eembed.h"
 
 #if EEMBED_HOSTED
+#include <locale.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 int (*strbuf_vsnprintf)(char *str, size_t size, const char *format, va_list ap)
     = vsnprintf;
 #else
@@ -41,13 +45,33 @@ struct strbuf {
 	size_t start;
 	size_t end;
 	struct eembed_allocator *ea;
+	strbuf_sizehint_s *hint;
+	uint64_t hash;
+	/* if gap_len, the string is [start, gap) then [gap + gap_len, end) */
+	size_t gap;
+	size_t gap_len;
+	/* set if the buffer is shared with clones, see strbuf_clone */
+	struct strbuf_share *share;
+	/* in ring mode, if wrap, the string is [start, wrap) then [0, end) */
+	size_t wrap;
 	uint8_t flags;
 };
 typedef struct strbuf strbuf_s;
 
+/* fails to compile if STRBUF_STRUCT_SIZE_MAX is too small, leaving room
+   for eembed_align to round up */
+typedef char strbuf_struct_size_max_fits[((sizeof(strbuf_s) + 16)
+					  <= STRBUF_STRUCT_SIZE_MAX) ? 1 : -1];
+
 enum strbuf_flag {
 	strbuf_flag_struct_needs_free = 0,
 	strbuf_flag_buf_needs_free = 1,
+	strbuf_flag_utf8_valid = 2,
+	strbuf_flag_hash_valid = 3,
+	strbuf_flag_interned = 4,
+	strbuf_flag_shared = 5,
+	strbuf_flag_ring = 6,
+	strbuf_flag_grow_realloc = 7,
 };
 
 static void strbuf_flag_set(strbuf_s *sb, enum strbuf_flag flag, bool val)
@@ -86,16 +110,415 @@ static void strbuf_set_struct_needs_free(strbuf_s *sb, bool val)
 	strbuf_flag_set(sb, strbuf_flag_struct_needs_free, val);
 }
 
+/* word-at-a-time helpers: ones has 0x01 in every byte of a size_t */
+#define Strbuf_ones (((size_t)-1) / 0xFF)
+#define Strbuf_highs (Strbuf_ones * 0x80)
+#define Strbuf_has_zero(w) (((w) - Strbuf_ones) & ~(w) & Strbuf_highs)
+#define Strbuf_has_byte(w, b) Strbuf_has_zero((w) ^ (Strbuf_ones * (b)))
+#define Strbuf_has_less(w, n) \
+	(((w) - (Strbuf_ones * (n))) & ~(w) & Strbuf_highs)
+
+/* copying and scanning: when hosted, libc's, which the compiler may
+   inline and the loader may pick vectorized versions of; otherwise, a
+   word at a time where the alignment allows */
+#if EEMBED_HOSTED
+#define strbuf_memcpy(dest, src, n) memcpy(dest, src, n)
+#define strbuf_memmove(dest, src, n) memmove(dest, src, n)
+#define strbuf_memset(dest, c, n) memset(dest, c, n)
+#define strbuf_memchr(s, c, n) memchr(s, c, n)
+#define strbuf_strnlen(s, n) strnlen(s, n)
+#else
+#if defined(__GNUC__)
+typedef size_t __attribute__((__may_alias__)) strbuf_word;
+/* the compiler loads it as the target allows, by bytes if need be */
+typedef size_t __attribute__((__may_alias__, __aligned__(1))) strbuf_uword;
+#define Strbuf_unaligned_ok(p) 1
+#else
+typedef size_t strbuf_word;
+typedef size_t strbuf_uword;
+#define Strbuf_unaligned_ok(p) (!Strbuf_misaligned(p))
+#endif
+
+#define Strbuf_word_mask (sizeof(size_t) - 1)
+#define Strbuf_misaligned(p) (((uintptr_t)(p)) & Strbuf_word_mask)
+
+/* safe for overlap if "dest" is before "src": each word is read before
+   any write reaches it */
+static void *strbuf_memcpy(void *dest, const void *src, size_t n)
+{
+	unsigned char *d = (unsigned char *)dest;
+	const unsigned char *s = (const unsigned char *)src;
+	for (; n && Strbuf_misaligned(d); --n) {
+		*d++ = *s++;
+	}
+	if (Strbuf_unaligned_ok(s)) {
+		for (; n >= sizeof(size_t); n -= sizeof(size_t)) {
+			*(strbuf_word *)d = *(const strbuf_uword *)s;
+			d += sizeof(size_t);
+			s += sizeof(size_t);
+		}
+	}
+	for (; n; --n) {
+		*d++ = *s++;
+	}
+	return dest;
+}
+
+static void *strbuf_memmove(void *dest, const void *src, size_t n)
+{
+	uintptr_t d_addr = (uintptr_t)dest;
+	uintptr_t s_addr = (uintptr_t)src;
+	if (d_addr <= s_addr || d_addr >= (s_addr + n)) {
+		return strbuf_memcpy(dest, src, n);
+	}
+	unsigned char *d = ((unsigned char *)dest) + n;
+	const unsigned char *s = ((const unsigned char *)src) + n;
+	for (; n && Strbuf_misaligned(d); --n) {
+		*--d = *--s;
+	}
+	if (Strbuf_unaligned_ok(s)) {
+		for (; n >= sizeof(size_t); n -= sizeof(size_t)) {
+			d -= sizeof(size_t);
+			s -= sizeof(size_t);
+			*(strbuf_word *)d = *(const strbuf_uword *)s;
+		}
+	}
+	for (; n; --n) {
+		*--d = *--s;
+	}
+	return dest;
+}
+
+static void *strbuf_memset(void *dest, int c, size_t n)
+{
+	unsigned char *d = (unsigned char *)dest;
+	unsigned char b = (unsigned char)c;
+	for (; n && Strbuf_misaligned(d); --n) {
+		*d++ = b;
+	}
+	size_t w = Strbuf_ones * b;
+	for (; n >= sizeof(size_t); n -= sizeof(size_t)) {
+		*(strbuf_word *)d = w;
+		d += sizeof(size_t);
+	}
+	for (; n; --n) {
+		*d++ = b;
+	}
+	return dest;
+}
+
+/* all "n" bytes must be readable, as whole words of them are loaded even
+   past a match; for a maximum rather than a size, see strbuf_strnlen */
+static void *strbuf_memchr(const void *src, int c, size_t n)
+{
+	const unsigned char *s = (const unsigned char *)src;
+	unsigned char b = (unsigned char)c;
+	for (; n && Strbuf_misaligned(s); --n, ++s) {
+		if (*s == b) {
+			return (void *)s;
+		}
+	}
+	for (; n >= sizeof(size_t); n -= sizeof(size_t)) {
+		if (Strbuf_has_byte(*(const strbuf_word *)s, b)) {
+			break;
+		}
+		s += sizeof(size_t);
+	}
+	for (; n; --n, ++s) {
+		if (*s == b) {
+			return (void *)s;
+		}
+	}
+	return NULL;
+}
+
+/* by bytes: "n" is only a maximum, and nothing past the NULL, which may
+   end the object, is read */
+static size_t strbuf_strnlen(const char *str, size_t n)
+{
+	size_t len = 0;
+	while (len < n && str[len]) {
+		++len;
+	}
+	return len;
+}
+#endif
+
+static size_t strbuf_load_word(const char *s)
+{
+#if !EEMBED_HOSTED && defined(__GNUC__)
+	return *(const strbuf_uword *)s;
+#else
+	size_t word;
+	strbuf_memcpy(&word, s, sizeof(size_t));
+	return word;
+#endif
+}
+
+/* UTF-8 as in Unicode Table 3-7: no overlong forms, no surrogates,
+   nothing above U+10FFFF; runs of ASCII are skipped a word at a time */
+static bool strbuf_utf8_check(const char *str, size_t len)
+{
+	const unsigned char *s = (const unsigned char *)str;
+	size_t i = 0;
+	while (i < len) {
+		while ((i + sizeof(size_t)) <= len) {
+			size_t w = strbuf_load_word(str + i);
+			if (w & Strbuf_highs) {
+				break;
+			}
+			i += sizeof(size_t);
+		}
+		if (i == len) {
+			break;
+		}
+		unsigned char c = s[i];
+		if (c < 0x80) {
+			++i;
+			continue;
+		}
+		size_t need;
+		unsigned char lo = 0x80;
+		unsigned char hi = 0xBF;
+		if (c >= 0xC2 && c <= 0xDF) {
+			need = 1;
+		} else if (c >= 0xE0 && c <= 0xEF) {
+			need = 2;
+			if (c == 0xE0) {
+				lo = 0xA0;
+			} else if (c == 0xED) {
+				hi = 0x9F;
+			}
+		} else if (c >= 0xF0 && c <= 0xF4) {
+			need = 3;
+			if (c == 0xF0) {
+				lo = 0x90;
+			} else if (c == 0xF4) {
+				hi = 0x8F;
+			}
+		} else {
+			return false;
+		}
+		if ((len - i) <= need) {
+			return false;
+		}
+		if (s[i + 1] < lo || s[i + 1] > hi) {
+			return false;
+		}
+		for (size_t j = 2; j <= need; ++j) {
+			if ((s[i + j] & 0xC0) != 0x80) {
+				return false;
+			}
+		}
+		i += need + 1;
+	}
+	return true;
+}
+
+static bool strbuf_utf8_known(strbuf_s *sb)
+{
+	return strbuf_flag_get(sb, strbuf_flag_utf8_valid);
+}
+
+/* called by every change to the contents, including trims */
+static void strbuf_unhash(strbuf_s *sb)
+{
+	/* interned strings are shared and must not be modified */
+	eembed_assert(!strbuf_flag_get(sb, strbuf_flag_interned));
+	strbuf_flag_set(sb, strbuf_flag_hash_valid, false);
+}
+
+/* called whenever the contents change in a way not covered below */
+static void strbuf_changed(strbuf_s *sb)
+{
+	strbuf_unhash(sb);
+	strbuf_flag_set(sb, strbuf_flag_utf8_valid, false);
+}
+
+/* text joined to text which is known to be valid keeps it valid only if
+   the new text is also valid; this costs a check of the new text only */
+static void strbuf_added(strbuf_s *sb, const char *str, size_t len)
+{
+	strbuf_unhash(sb);
+	if (strbuf_utf8_known(sb) && !strbuf_utf8_check(str, len)) {
+		strbuf_flag_set(sb, strbuf_flag_utf8_valid, false);
+	}
+}
+
+/* halve the histogram once this many samples have been recorded */
+#define Strbuf_sizehint_decay 256
+
+static size_t strbuf_sizehint_bucket(size_t size)
+{
+	size_t bucket = 0;
+	while ((bucket + 1) < STRBUF_SIZEHINT_BUCKETS
+	       && (((size_t)1) << bucket) < size) {
+		++bucket;
+	}
+	return bucket;
+}
+
+static void strbuf_sizehint_record(strbuf_sizehint_s *hint, size_t str_len)
+{
+	if (hint->total >= Strbuf_sizehint_decay) {
+		hint->total = 0;
+		for (size_t i = 0; i < STRBUF_SIZEHINT_BUCKETS; ++i) {
+			hint->counts[i] /= 2;
+			hint->total += hint->counts[i];
+		}
+	}
+	size_t bucket = strbuf_sizehint_bucket(str_len + 1);
+	++(hint->counts[bucket]);
+	++(hint->total);
+}
+
+/* the smallest power of two which would have held 90% of recent strings */
+static size_t strbuf_sizehint_size(strbuf_sizehint_s *hint)
+{
+	size_t seen = 0;
+	size_t wanted = ((((size_t)hint->total) * 9) + 9) / 10;
+	size_t size = 0;
+	for (size_t i = 0; hint->total && i < STRBUF_SIZEHINT_BUCKETS; ++i) {
+		seen += hint->counts[i];
+		if (seen >= wanted) {
+			size = ((size_t)1) << i;
+			break;
+		}
+	}
+	if (hint->max_size && size > hint->max_size) {
+		size = hint->max_size;
+	}
+	return size;
+}
+
+/* a buffer shared by clones; the last one to let go of it frees it */
+struct strbuf_share {
+	size_t refs;
+	struct eembed_allocator *ea;
+	char *buf;
+};
+
+#if defined(__GNUC__) && EEMBED_HOSTED
+static void strbuf_refs_inc(size_t *refs)
+{
+	__atomic_add_fetch(refs, 1, __ATOMIC_RELAXED);
+}
+
+static size_t strbuf_refs_dec(size_t *refs)
+{
+	return __atomic_sub_fetch(refs, 1, __ATOMIC_ACQ_REL);
+}
+
+static size_t strbuf_refs_get(size_t *refs)
+{
+	return __atomic_load_n(refs, __ATOMIC_ACQUIRE);
+}
+#else
+static void strbuf_refs_inc(size_t *refs)
+{
+	++(*refs);
+}
+
+static size_t strbuf_refs_dec(size_t *refs)
+{
+	return --(*refs);
+}
+
+static size_t strbuf_refs_get(size_t *refs)
+{
+	return *refs;
+}
+#endif
+
+static bool strbuf_shared(strbuf_s *sb)
+{
+	return strbuf_flag_get(sb, strbuf_flag_shared);
+}
+
+static bool strbuf_interned(strbuf_s *sb)
+{
+	return strbuf_flag_get(sb, strbuf_flag_interned);
+}
+
+/* frees the buffer, or drops this strbuf's reference to a shared one */
+static void strbuf_buf_release(strbuf_s *sb)
+{
+	if (strbuf_shared(sb)) {
+		struct strbuf_share *share = sb->share;
+		if (strbuf_refs_dec(&share->refs) == 0) {
+			struct eembed_allocator *ea = share->ea;
+			ea->free(ea, share->buf);
+			ea->free(ea, share);
+		}
+		sb->share = NULL;
+		strbuf_flag_set(sb, strbuf_flag_shared, false);
+	} else if (strbuf_buf_needs_free(sb)) {
+		struct eembed_allocator *ea = sb->ea;
+		ea->free(ea, sb->buf);
+	}
+	sb->buf = NULL;
+	strbuf_set_buf_needs_free(sb, false);
+}
+
+/* after strbuf_take, the buffer is this until the next write */
+static char strbuf_taken_buf[1];
+
+/* called before writing to the buffer: a shared buffer is copied, unless
+   no other clone still refers to it, in which case it is simply taken */
+/* interned strings are shared by the table and are never written */
+static bool strbuf_own(strbuf_s *sb)
+{
+	if (strbuf_interned(sb)) {
+		return false;
+	}
+	if (sb->buf == strbuf_taken_buf) {
+		struct eembed_allocator *ea = sb->ea;
+		size_t size = EEMBED_WORD_LEN * 4;
+		char *buf = (char *)ea->malloc(ea, size);
+		if (!buf) {
+			return false;
+		}
+		strbuf_memset(buf, 0x00, size);
+		sb->buf = buf;
+		sb->buf_size = size;
+		strbuf_set_buf_needs_free(sb, true);
+		return true;
+	}
+	if (!strbuf_shared(sb)) {
+		return true;
+	}
+	struct strbuf_share *share = sb->share;
+	if (strbuf_refs_get(&share->refs) == 1) {
+		struct eembed_allocator *ea = share->ea;
+		ea->free(ea, share);
+		sb->share = NULL;
+		strbuf_flag_set(sb, strbuf_flag_shared, false);
+		strbuf_set_buf_needs_free(sb, true);
+		return true;
+	}
+	struct eembed_allocator *ea = sb->ea;
+	char *buf = (char *)ea->malloc(ea, sb->buf_size);
+	if (!buf) {
+		return false;
+	}
+	strbuf_memcpy(buf, sb->buf, sb->buf_size);
+	strbuf_buf_release(sb);
+	sb->buf = buf;
+	strbuf_set_buf_needs_free(sb, true);
+	return true;
+}
+
 void strbuf_destroy(strbuf_s *sb)
 {
 	if (!sb) {
 		return;
 	}
-	if (strbuf_buf_needs_free(sb)) {
-		struct eembed_allocator *ea = sb->ea;
-		ea->free(ea, sb->buf);
-		sb->buf = NULL;
+	/* interned strings are released, not destroyed */
+	eembed_assert(!strbuf_flag_get(sb, strbuf_flag_interned));
+	if (sb->hint) {
+		strbuf_sizehint_record(sb->hint, strbuf_len(sb));
 	}
+	strbuf_buf_release(sb);
 	if (strbuf_struct_needs_free(sb)) {
 		struct eembed_allocator *ea = sb->ea;
 		ea->free(ea, sb);
@@ -107,9 +530,10 @@ size_t strbuf_struct_size(void)
 	return eembed_align(sizeof(strbuf_s));
 }
 
-strbuf_s *strbuf_new_custom(struct eembed_allocator *ea,
-			    unsigned char *mem_buf, size_t buf_size,
-			    const char *str, size_t str_len)
+static strbuf_s *strbuf_new_sized(struct eembed_allocator *ea,
+				  unsigned char *mem_buf, size_t buf_size,
+				  const char *str, size_t str_len,
+				  size_t min_initial_size)
 {
 	if (ea == NULL) {
 		ea = eembed_global_allocator;
@@ -119,7 +543,7 @@ strbuf_s *strbuf_new_custom(struct eembed_allocator *ea,
 	size_t strbuf_size = strbuf_struct_size();
 	if (mem_buf && (buf_size > strbuf_size)) {
 		sb = (strbuf_s *)(mem_buf + buf_size - strbuf_size);
-		eembed_memset(sb, 0x00, strbuf_size);
+		strbuf_memset(sb, 0x00, strbuf_size);
 		strbuf_set_struct_needs_free(sb, false);
 
 		size_t needed = (strbuf_size + str_len + 1);
@@ -137,7 +561,7 @@ strbuf_s *strbuf_new_custom(struct eembed_allocator *ea,
 		if (!sb) {
 			return NULL;
 		}
-		eembed_memset(sb, 0x00, size);
+		strbuf_memset(sb, 0x00, size);
 		strbuf_set_struct_needs_free(sb, true);
 	}
 
@@ -145,11 +569,10 @@ strbuf_s *strbuf_new_custom(struct eembed_allocator *ea,
 		if (!str || !str_len) {
 			buf_size = 0;
 		} else {
-			buf_size = eembed_strnlen(str, str_len);
+			buf_size = strbuf_strnlen(str, str_len);
 		}
 		buf_size += 1;
 
-		size_t min_initial_size = EEMBED_WORD_LEN * 4;
 		if (buf_size < min_initial_size) {
 			buf_size = min_initial_size;
 		}
@@ -175,6 +598,15 @@ strbuf_s *strbuf_new_custom(struct eembed_allocator *ea,
 	return sb;
 }
 
+strbuf_s *strbuf_new_custom(struct eembed_allocator *ea,
+			    unsigned char *mem_buf, size_t buf_size,
+			    const char *str, size_t str_len)
+{
+	size_t min_initial_size = EEMBED_WORD_LEN * 4;
+	return strbuf_new_sized(ea, mem_buf, buf_size, str, str_len,
+				min_initial_size);
+}
+
 strbuf_s *strbuf_new(const char *str, size_t str_len)
 {
 	struct eembed_allocator *ea = NULL;
@@ -192,9 +624,248 @@ strbuf_s *strbuf_no_grow(unsigned char *initial_buf, size_t initial_buf_size,
 				 str_len);
 }
 
+strbuf_s *strbuf_ring(unsigned char *mem_buf, size_t buf_size)
+{
+	strbuf_s *sb = strbuf_no_grow(mem_buf, buf_size, NULL, 0);
+	if (sb) {
+		strbuf_flag_set(sb, strbuf_flag_ring, true);
+	}
+	return sb;
+}
+
+strbuf_s *strbuf_new_hinted(strbuf_sizehint_s *hint, const char *str,
+			    size_t str_len)
+{
+	struct eembed_allocator *ea = NULL;
+	unsigned char *initial_buf = NULL;
+	size_t initial_buf_size = 0;
+	size_t min_initial_size = EEMBED_WORD_LEN * 4;
+	if (hint) {
+		size_t hinted = strbuf_sizehint_size(hint);
+		if (hinted > min_initial_size) {
+			min_initial_size = hinted;
+		}
+	}
+	strbuf_s *sb = strbuf_new_sized(ea, initial_buf, initial_buf_size,
+					str, str_len, min_initial_size);
+	if (sb) {
+		sb->hint = hint;
+	}
+	return sb;
+}
+
+static bool strbuf_ring_mode(strbuf_s *sb)
+{
+	return strbuf_flag_get(sb, strbuf_flag_ring);
+}
+
+static void strbuf_reverse(char *s, size_t len)
+{
+	for (size_t i = 0, j = len; i + 1 < j; ++i, --j) {
+		char c = s[i];
+		s[i] = s[j - 1];
+		s[j - 1] = c;
+	}
+}
+
+/* rotates a wrapped ring in place so that the string starts at buf[0] */
+static void strbuf_ring_unwrap(strbuf_s *sb)
+{
+	if (!sb->wrap) {
+		return;
+	}
+	size_t len_a = sb->wrap - sb->start;
+	size_t len_b = sb->end;
+	strbuf_reverse(sb->buf, sb->wrap);
+	strbuf_reverse(sb->buf, len_a);
+	strbuf_reverse(sb->buf + sb->wrap - len_b, len_b);
+	strbuf_memmove(sb->buf + len_a, sb->buf + sb->wrap - len_b, len_b);
+	sb->start = 0;
+	sb->end = len_a + len_b;
+	sb->wrap = 0;
+	strbuf_memset(sb->buf + sb->end, 0x00, sb->buf_size - sb->end);
+}
+
+/* moves whichever side of the gap is shorter; the freed bytes are zeroed,
+   keeping the bytes after the end zero */
+static void strbuf_gap_close(strbuf_s *sb)
+{
+	strbuf_ring_unwrap(sb);
+	if (!sb->gap_len) {
+		return;
+	}
+	size_t head = sb->gap - sb->start;
+	size_t after = sb->gap + sb->gap_len;
+	size_t tail = sb->end - after;
+	if (head < tail) {
+		char *from = sb->buf + sb->start;
+		strbuf_memmove(from + sb->gap_len, from, head);
+		strbuf_memset(from, 0x00, sb->gap_len);
+		sb->start += sb->gap_len;
+	} else {
+		strbuf_memmove(sb->buf + sb->gap, sb->buf + after, tail);
+		sb->end -= sb->gap_len;
+		strbuf_memset(sb->buf + sb->end, 0x00, sb->gap_len);
+	}
+	sb->gap_len = 0;
+}
+
+/* makes "need" contiguous bytes free at the end, evicting the oldest
+   bytes as needed; the string after is [start, wrap) then [0, end), or
+   [start, end) if it does not wrap */
+static bool strbuf_ring_reserve(strbuf_s *sb, size_t need)
+{
+	if (need > sb->buf_size) {
+		return false;
+	}
+	/* a gap is only opened in a ring which is not wrapped, so closing it
+	   never rotates the ring */
+	if (sb->gap_len) {
+		strbuf_gap_close(sb);
+	}
+	size_t len = strbuf_len(sb);
+	for (;;) {
+		if (sb->start == sb->end && !sb->wrap) {
+			sb->start = 0;
+			sb->end = 0;
+		}
+		if (!sb->wrap) {
+			if ((sb->end + need) <= sb->buf_size) {
+				break;
+			}
+			if (need >= sb->end) {
+				sb->start = 0;
+				sb->end = 0;
+				continue;
+			}
+			if (sb->start < need) {
+				sb->start = need;
+			}
+			/* the trailing NULL of this part stays at buf[wrap] */
+			sb->wrap = sb->end;
+			sb->end = 0;
+			break;
+		}
+		if ((sb->end + need) <= sb->start) {
+			break;
+		}
+		sb->start = sb->end + need;
+		if (sb->start >= sb->wrap) {
+			sb->start = 0;
+			sb->wrap = 0;
+		}
+	}
+	if (strbuf_len(sb) != len) {
+		/* evicting may have split a UTF-8 sequence */
+		strbuf_changed(sb);
+	}
+	return true;
+}
+
+/* unlike a reservation, a copy may be split across the end of the buffer,
+   so at least the last buf_size - 2 bytes are always kept; the last byte
+   of the buffer is never used for the string, and stays zero */
+static void strbuf_ring_write(strbuf_s *sb, const char *str, size_t len)
+{
+	size_t limit = sb->buf_size - 1;
+	bool evicted = false;
+	if (sb->gap_len) {
+		strbuf_gap_close(sb);
+	}
+	if (len >= limit) {
+		/* all that was there is evicted */
+		str += len - limit;
+		len = limit;
+		evicted = true;
+		sb->start = 0;
+		sb->end = 0;
+		sb->wrap = 0;
+	}
+	const char *added = str;
+	size_t added_len = len;
+	while (len) {
+		if (!sb->wrap) {
+			if (sb->start == sb->end) {
+				sb->start = 0;
+				sb->end = 0;
+			}
+			size_t room = limit - sb->end;
+			if (!room) {
+				/* the NULL for this part is buf[wrap] */
+				sb->wrap = sb->end;
+				sb->end = 0;
+				continue;
+			}
+			size_t n = (len < room) ? len : room;
+			strbuf_memcpy(sb->buf + sb->end, str, n);
+			sb->end += n;
+			str += n;
+			len -= n;
+			continue;
+		}
+		/* keep a byte free between the new end and the start */
+		if ((sb->end + len) >= sb->start) {
+			evicted = true;
+			sb->start = sb->end + len + 1;
+			if (sb->start >= sb->wrap) {
+				sb->start = 0;
+				sb->wrap = 0;
+				continue;
+			}
+		}
+		strbuf_memcpy(sb->buf + sb->end, str, len);
+		sb->end += len;
+		len = 0;
+	}
+	sb->buf[sb->end] = '\0';
+	if (evicted) {
+		/* evicting may have split a UTF-8 sequence */
+		strbuf_changed(sb);
+	} else {
+		strbuf_added(sb, added, added_len);
+	}
+}
+
+/* the clone shares the buffer until either one is next modified; a
+   buffer which this strbuf does not own is copied instead */
+strbuf_s *strbuf_clone(strbuf_s *sb)
+{
+	eembed_assert(sb);
+	strbuf_gap_close(sb);
+	if (!strbuf_shared(sb) && !strbuf_buf_needs_free(sb)) {
+		return strbuf_new(strbuf_str(sb), strbuf_len(sb));
+	}
+	struct eembed_allocator *ea = sb->ea;
+	if (!strbuf_shared(sb)) {
+		size_t size = sizeof(struct strbuf_share);
+		struct strbuf_share *share =
+		    (struct strbuf_share *)ea->malloc(ea, size);
+		if (!share) {
+			return NULL;
+		}
+		share->refs = 1;
+		share->ea = ea;
+		share->buf = sb->buf;
+		sb->share = share;
+		strbuf_flag_set(sb, strbuf_flag_shared, true);
+		strbuf_set_buf_needs_free(sb, false);
+	}
+	strbuf_s *clone = (strbuf_s *)ea->malloc(ea, sizeof(strbuf_s));
+	if (!clone) {
+		return NULL;
+	}
+	strbuf_memcpy(clone, sb, sizeof(strbuf_s));
+	clone->hint = NULL;
+	strbuf_set_struct_needs_free(clone, true);
+	strbuf_refs_inc(&sb->share->refs);
+	return clone;
+}
+
+/* the gap is closed lazily, when the contiguous string is needed */
 const char *strbuf_str(strbuf_s *sb)
 {
 	eembed_assert(sb);
+	strbuf_gap_close(sb);
 	const char *str = sb->buf + sb->start;
 	return str;
 }
@@ -202,10 +873,41 @@ const char *strbuf_str(strbuf_s *sb)
 size_t strbuf_len(strbuf_s *sb)
 {
 	eembed_assert(sb);
-	size_t str_len = sb->end - sb->start;
+	if (sb->wrap) {
+		return (sb->wrap - sb->start) + sb->end;
+	}
+	size_t str_len = sb->end - sb->start - sb->gap_len;
 	return str_len;
 }
 
+void strbuf_spans(strbuf_s *sb, const char **first, size_t *first_len,
+		  const char **second, size_t *second_len)
+{
+	eembed_assert(sb);
+	eembed_assert(first && first_len && second && second_len);
+	*first = sb->buf + sb->start;
+	if (sb->gap_len) {
+		*first_len = sb->gap - sb->start;
+		*second = sb->buf + sb->gap + sb->gap_len;
+		*second_len = sb->end - (sb->gap + sb->gap_len);
+	} else if (sb->wrap) {
+		*first_len = sb->wrap - sb->start;
+		*second = sb->buf;
+		*second_len = sb->end;
+	} else {
+		*first_len = sb->end - sb->start;
+		*second = sb->buf + sb->end;
+		*second_len = 0;
+	}
+}
+
+const char *strbuf_linearize(strbuf_s *sb)
+{
+	eembed_assert(sb);
+	strbuf_gap_close(sb);
+	return strbuf_str(sb);
+}
+
 size_t strbuf_avail(strbuf_s *sb)
 {
 	eembed_assert(sb);
@@ -228,39 +930,75 @@ char strbuf_char(strbuf_s *sb, size_t idx)
 	if (idx >= len) {
 		return '\0';
 	}
-	const char *str = strbuf_str(sb);
-	char c = str[idx];
+	size_t at = sb->start + idx;
+	if (sb->gap_len && at >= sb->gap) {
+		at += sb->gap_len;
+	} else if (sb->wrap && at >= sb->wrap) {
+		at -= sb->wrap;
+	}
+	char c = sb->buf[at];
 	return c;
 }
 
 const char *strbuf_rehome(strbuf_s *sb)
 {
 	eembed_assert(sb);
+	if (!strbuf_own(sb)) {
+		return NULL;
+	}
+	strbuf_gap_close(sb);
 	if (sb->start) {
 		size_t len = sb->end - sb->start;
 		const char *str = sb->buf + sb->start;
-		void *p = eembed_memmove(sb->buf, str, len);
+		void *p = strbuf_memmove(sb->buf, str, len);
 		eembed_assert(p);
 		(void)p;
 		sb->start = 0;
 		sb->end = len;
-		size_t remaining = sb->buf_size - sb->end;
-		char *extra = sb->buf + sb->end;
-		eembed_memset(extra, 0x00, remaining);
+		sb->buf[sb->end] = '\0';
 	}
 	return strbuf_str(sb);
 }
 
-const char *strbuf_grow(strbuf_s *sb, size_t new_buf_size)
+void strbuf_grow_by_realloc(strbuf_s *sb, int on)
 {
 	eembed_assert(sb);
-	if (new_buf_size <= sb->buf_size) {
-		return strbuf_rehome(sb);
-	}
-
-	new_buf_size = eembed_align(new_buf_size);
+	strbuf_flag_set(sb, strbuf_flag_grow_realloc, on ? true : false);
+}
 
+/* realloc may extend the buffer in place or, as with
+   strbuf_mmap_allocator, remap it without copying */
+static const char *strbuf_grow_realloc(strbuf_s *sb, size_t new_buf_size)
+{
+	if (!strbuf_rehome(sb)) {
+		return NULL;
+	}
 	struct eembed_allocator *ea = sb->ea;
+	char *new_buf = (char *)ea->realloc(ea, sb->buf, new_buf_size);
+	if (!new_buf) {
+		return NULL;
+	}
+	sb->buf = new_buf;
+	sb->buf_size = new_buf_size;
+	return strbuf_str(sb);
+}
+
+const char *strbuf_grow(strbuf_s *sb, size_t new_buf_size)
+{
+	eembed_assert(sb);
+	strbuf_gap_close(sb);
+	if (new_buf_size <= sb->buf_size) {
+		return strbuf_rehome(sb);
+	}
+
+	new_buf_size = eembed_align(new_buf_size);
+
+	struct eembed_allocator *ea = sb->ea;
+	if (strbuf_flag_get(sb, strbuf_flag_grow_realloc) && ea->realloc
+	    && strbuf_buf_needs_free(sb) && !strbuf_shared(sb)) {
+		return strbuf_grow_realloc(sb, new_buf_size);
+	}
+
 	char *new_buf = (char *)ea->malloc(ea, new_buf_size);
 	if (!new_buf) {
 		return NULL;
@@ -268,18 +1006,13 @@ const char *strbuf_grow(strbuf_s *sb, size_t new_buf_size)
 	eembed_assert(sb->end >= sb->start);
 	size_t str_len = (sb->end - sb->start);
 	if (str_len) {
-		void *p = eembed_memcpy(new_buf, sb->buf + sb->start, str_len);
+		void *p = strbuf_memcpy(new_buf, sb->buf + sb->start, str_len);
 		eembed_assert(p);
 		(void)p;
 	}
-	size_t remaining = new_buf_size - str_len;
-	eembed_memset(new_buf + str_len, 0x00, remaining);
+	new_buf[str_len] = '\0';
 
-	if (strbuf_buf_needs_free(sb)) {
-		ea->free(ea, sb->buf);
-		sb->buf = NULL;
-		sb->buf_size = 0;
-	}
+	strbuf_buf_release(sb);
 	sb->buf = new_buf;
 	sb->buf_size = new_buf_size;
 	strbuf_set_buf_needs_free(sb, true);
@@ -288,16 +1021,115 @@ const char *strbuf_grow(strbuf_s *sb, size_t new_buf_size)
 	return strbuf_str(sb);
 }
 
+/* makes room for "needed" bytes after the end. When the consumed prefix
+   leaves room enough, the string is moved back to the front instead of
+   growing: that copies the live bytes once, as growing would have, but
+   allocates nothing, so it never costs more than the growth it saves, and
+   a reader which keeps up with consume leaves the buffer the size of its
+   largest backlog. Otherwise the buffer grows, at least doubling if
+   "geometric", else to just fit */
+static bool strbuf_room(strbuf_s *sb, size_t needed, bool geometric)
+{
+	if ((sb->buf_size - sb->end) >= needed) {
+		return true;
+	}
+	size_t new_size = strbuf_len(sb) + needed;
+	if (new_size <= sb->buf_size) {
+		return strbuf_rehome(sb) != NULL;
+	}
+	if (geometric && new_size < (2 * sb->buf_size)) {
+		new_size = 2 * sb->buf_size;
+	}
+	return strbuf_grow(sb, new_size) != NULL;
+}
+
+/* returns a pointer to at least "len" writable bytes after the end of the
+   string (plus room for the trailing NULL), growing geometrically */
+static char *strbuf_tail(strbuf_s *sb, size_t len)
+{
+	if (strbuf_ring_mode(sb)) {
+		if (!strbuf_ring_reserve(sb, len + 1)) {
+			return NULL;
+		}
+		return sb->buf + sb->end;
+	}
+	if (!strbuf_own(sb)) {
+		return NULL;
+	}
+	strbuf_gap_close(sb);
+	if (!strbuf_room(sb, len + 1, true)) {
+		return NULL;
+	}
+	return sb->buf + sb->end;
+}
+
+/* where the NULL may be, at the furthest, after writing to the tail; in
+   ring mode the byte before the start stays free */
+static size_t strbuf_tail_limit(strbuf_s *sb)
+{
+	if (strbuf_ring_mode(sb) && sb->wrap) {
+		return sb->start - 1;
+	}
+	return sb->buf_size - 1;
+}
+
+/* only the new end needs a NULL; what may follow it is not the string */
+static void strbuf_tail_commit(strbuf_s *sb, size_t len)
+{
+	strbuf_added(sb, sb->buf + sb->end, len);
+	sb->end += len;
+	sb->buf[sb->end] = '\0';
+}
+
+/* what the append functions return; in ring mode this is the oldest
+   contiguous part, so that appending need not unwrap the ring */
+static const char *strbuf_appended(strbuf_s *sb)
+{
+	if (strbuf_ring_mode(sb)) {
+		return sb->buf + sb->start;
+	}
+	return strbuf_str(sb);
+}
+
+char *strbuf_reserve_tail(strbuf_s *sb, size_t min, size_t *avail)
+{
+	eembed_assert(sb);
+	/* room is also needed for the NULL after "min" */
+	if (min == SIZE_MAX) {
+		return NULL;
+	}
+	char *tail = strbuf_tail(sb, min);
+	if (tail && avail) {
+		*avail = strbuf_tail_limit(sb) - sb->end;
+	}
+	return tail;
+}
+
+const char *strbuf_commit(strbuf_s *sb, size_t n)
+{
+	eembed_assert(sb);
+	eembed_assert(n <= (strbuf_tail_limit(sb) - sb->end));
+	strbuf_tail_commit(sb, n);
+	return strbuf_appended(sb);
+}
+
 const char *strbuf_set(strbuf_s *sb, const char *str, size_t str_len)
 {
 	eembed_assert(sb);
+	if (!strbuf_own(sb)) {
+		return NULL;
+	}
+	strbuf_changed(sb);
+	strbuf_gap_close(sb);
 	if (!str || !str_len) {
 		sb->start = 0;
 		sb->end = 0;
-		eembed_memset(sb->buf, 0x00, sb->buf_size);
+		if (sb->buf_size) {
+			sb->buf[0] = '\0';
+		}
 		return sb->buf;
 	}
-	str_len = eembed_strnlen(str, str_len);
+	str_len = strbuf_strnlen(str, str_len);
 	if (str_len >= sb->buf_size) {
 		const char *str = strbuf_grow(sb, str_len + 1);
 		if (!str) {
@@ -305,11 +1137,9 @@ const char *strbuf_set(strbuf_s *sb, const char *str, size_t str_len)
 		}
 	}
 	sb->start = 0;
-	eembed_memmove(sb->buf, str, str_len);
+	strbuf_memmove(sb->buf, str, str_len);
 	sb->buf[str_len] = '\0';
-	sb->end = eembed_strnlen(sb->buf, sb->buf_size);
-	size_t remaining = sb->buf_size - sb->end;
-	eembed_memset(sb->buf + sb->end, 0x00, remaining);
+	sb->end = str_len;
 	return strbuf_str(sb);
 }
 
@@ -321,21 +1151,21 @@ const char *strbuf_append(strbuf_s *sb, const char *str, size_t str_max)
 		str = "(null)";
 		str_len = 6;
 	} else {
-		str_len = eembed_strnlen(str, str_max);
+		str_len = strbuf_strnlen(str, str_max);
 	}
-	size_t needed = str_len + 1;
-	size_t remaining = sb->buf_size - sb->end;
-	if (remaining < needed) {
-		size_t len = strbuf_len(sb) + needed;
-		const char *str = strbuf_grow(sb, len);
-		if (!str) {
-			return NULL;
-		}
+	if (strbuf_ring_mode(sb)) {
+		strbuf_ring_write(sb, str, str_len);
+		return strbuf_appended(sb);
+	}
+	if (!strbuf_own(sb)) {
+		return NULL;
+	}
+	strbuf_gap_close(sb);
+	if (!strbuf_room(sb, str_len + 1, false)) {
+		return NULL;
 	}
-	eembed_strncpy(sb->buf + sb->end, str, str_len);
-	sb->end += str_len;
-	remaining = sb->buf_size - sb->end;
-	eembed_memset(sb->buf + sb->end, 0x00, remaining);
+	strbuf_memcpy(sb->buf + sb->end, str, str_len);
+	strbuf_tail_commit(sb, str_len);
 	return strbuf_str(sb);
 }
 
@@ -371,8 +1201,8 @@ const char *strbuf_append_uint(strbuf_s *sb, uint64_t u)
 
 static size_t _strbuf_append_f_min_size(size_t max)
 {
-	if (max < eembed_strnlen("(null)", 6)) {
-		max = eembed_strnlen("(null)", 6);
+	if (max < strbuf_strnlen("(null)", 6)) {
+		max = strbuf_strnlen("(null)", 6);
 	}
 	if (max < SIZE_MAX) {
 		++max;		/* room for trailing null */
@@ -419,7 +1249,11 @@ const char *strbuf_append_f(strbuf_s *sb, size_t max, const char *format, ...)
 const char *strbuf_prepend(strbuf_s *sb, const char *str, size_t str_len)
 {
 	eembed_assert(sb);
-	size_t add_len = eembed_strnlen(str, str_len);
+	if (!strbuf_own(sb)) {
+		return NULL;
+	}
+	strbuf_gap_close(sb);
+	size_t add_len = str ? strbuf_strnlen(str, str_len) : 0;
 	size_t old_len = strbuf_len(sb);
 	size_t unused = strbuf_avail(sb);
 	const void *p;
@@ -429,14 +1263,16 @@ const char *strbuf_prepend(strbuf_s *sb, const char *str, size_t str_len)
 			return NULL;
 		}
 	}
-	p = eembed_memmove(sb->buf + add_len, sb->buf + sb->start, old_len);
+	p = strbuf_memmove(sb->buf + add_len, sb->buf + sb->start, old_len);
 	eembed_assert(p);
 	sb->start = add_len;
 	sb->end = add_len + old_len;
-	size_t remaining = sb->buf_size - sb->end;
-	eembed_memset(sb->buf + sb->end, 0x00, remaining);
-	p = eembed_memmove(sb->buf, str, add_len);
-	eembed_assert(p);
+	sb->buf[sb->end] = '\0';
+	if (add_len) {
+		p = strbuf_memmove(sb->buf, str, add_len);
+		eembed_assert(p);
+		strbuf_added(sb, str, add_len);
+	}
 	sb->start = 0;
 	return strbuf_str(sb);
 }
@@ -525,6 +1361,11 @@ static int strbuf_isspace(char c)
 const char *strbuf_trim_l(strbuf_s *sb)
 {
 	eembed_assert(sb);
+	if (!strbuf_own(sb)) {
+		return NULL;
+	}
+	strbuf_unhash(sb);
+	strbuf_gap_close(sb);
 	while ((sb->start < sb->end) && strbuf_isspace(sb->buf[sb->start])) {
 		sb->buf[sb->start] = '\0';
 		++(sb->start);
@@ -542,6 +1383,11 @@ const char *strbuf_trim_l(strbuf_s *sb)
 const char *strbuf_trim_r(strbuf_s *sb)
 {
 	eembed_assert(sb);
+	if (!strbuf_own(sb)) {
+		return NULL;
+	}
+	strbuf_unhash(sb);
+	strbuf_gap_close(sb);
 	while ((sb->start < sb->end) && strbuf_isspace(sb->buf[sb->end - 1])) {
 		sb->buf[sb->end - 1] = '\0';
 		--(sb->end);
@@ -559,16 +1405,274 @@ const char *strbuf_trim_r(strbuf_s *sb)
 const char *strbuf_trim(strbuf_s *sb)
 {
 	eembed_assert(sb);
-	strbuf_trim_l(sb);
-	strbuf_trim_r(sb);
+	if (!strbuf_trim_l(sb) || !strbuf_trim_r(sb)) {
+		return NULL;
+	}
 	return strbuf_str(sb);
 }
 
-char *strbuf_expose(strbuf_s *sb, size_t *size)
+/* flips the case bit of each byte in [from, to] in a word: bytes are
+   range checked on their low seven bits, bytes above 0x7F are masked out */
+static size_t strbuf_case_word(size_t w, unsigned char from, unsigned char to)
+{
+	size_t low7 = w & ~Strbuf_highs;
+	size_t ge_from = low7 + (Strbuf_ones * (0x80 - from));
+	size_t gt_to = low7 + (Strbuf_ones * (0x7F - to));
+	size_t in_range = ge_from & ~gt_to & ~w & Strbuf_highs;
+	return w ^ (in_range >> 2);
+}
+
+static unsigned char strbuf_case_byte(unsigned char c, unsigned char from,
+				      unsigned char to)
+{
+	return (c >= from && c <= to) ? (unsigned char)(c ^ 0x20) : c;
+}
+
+/* ASCII only; UTF-8 multi-byte sequences are left as they are and stay
+   valid, so the utf8 flag is kept */
+static const char *strbuf_case_map(strbuf_s *sb, unsigned char from,
+				   unsigned char to)
+{
+	eembed_assert(sb);
+	if (!strbuf_own(sb)) {
+		return NULL;
+	}
+	strbuf_unhash(sb);
+	strbuf_gap_close(sb);
+	char *s = sb->buf + sb->start;
+	size_t len = strbuf_len(sb);
+	size_t i = 0;
+	for (; (i + sizeof(size_t)) <= len; i += sizeof(size_t)) {
+		size_t w = strbuf_load_word(s + i);
+		w = strbuf_case_word(w, from, to);
+		strbuf_memcpy(s + i, &w, sizeof(size_t));
+	}
+	for (; i < len; ++i) {
+		s[i] = (char)strbuf_case_byte((unsigned char)s[i], from, to);
+	}
+	return strbuf_str(sb);
+}
+
+const char *strbuf_to_lower(strbuf_s *sb)
+{
+	return strbuf_case_map(sb, 'A', 'Z');
+}
+
+const char *strbuf_to_upper(strbuf_s *sb)
+{
+	return strbuf_case_map(sb, 'a', 'z');
+}
+
+int strbuf_casecmp(strbuf_s *sb, const char *str, size_t len)
+{
+	eembed_assert(sb);
+	eembed_assert(str || !len);
+	const char *s = strbuf_str(sb);
+	size_t s_len = strbuf_len(sb);
+	size_t min = s_len < len ? s_len : len;
+	size_t i = 0;
+	for (; (i + sizeof(size_t)) <= min; i += sizeof(size_t)) {
+		size_t a = strbuf_load_word(s + i);
+		size_t b = strbuf_load_word(str + i);
+		a = strbuf_case_word(a, 'A', 'Z');
+		b = strbuf_case_word(b, 'A', 'Z');
+		if (a != b) {
+			break;
+		}
+	}
+	for (; i < min; ++i) {
+		unsigned char a = (unsigned char)s[i];
+		unsigned char b = (unsigned char)str[i];
+		a = strbuf_case_byte(a, 'A', 'Z');
+		b = strbuf_case_byte(b, 'A', 'Z');
+		if (a != b) {
+			return a < b ? -1 : 1;
+		}
+	}
+	if (s_len == len) {
+		return 0;
+	}
+	return s_len < len ? -1 : 1;
+}
+
+int strbuf_caseeq(strbuf_s *sb, const char *str, size_t len)
+{
+	eembed_assert(sb);
+	if (strbuf_len(sb) != len) {
+		return 0;
+	}
+	return strbuf_casecmp(sb, str, len) == 0 ? 1 : 0;
+}
+
+/* puts the gap at "pos", moving only the bytes between it and the old gap;
+   with no gap, an empty one is simply placed there */
+static void strbuf_gap_move(strbuf_s *sb, size_t pos)
+{
+	strbuf_ring_unwrap(sb);
+	size_t at = sb->start + pos;
+	if (sb->gap_len && at < sb->gap) {
+		char *from = sb->buf + at;
+		strbuf_memmove(from + sb->gap_len, from, sb->gap - at);
+	} else if (sb->gap_len && at > sb->gap) {
+		char *to = sb->buf + sb->gap;
+		strbuf_memmove(to, to + sb->gap_len, at - sb->gap);
+	}
+	sb->gap = at;
+}
+
+/* ensures a gap of at least "len" at "pos"; when the gap must widen, it
+   takes all of the free space after the end, so that it rarely must */
+static bool strbuf_gap_reserve(strbuf_s *sb, size_t pos, size_t len)
+{
+	strbuf_gap_move(sb, pos);
+	if (sb->gap_len >= len) {
+		return true;
+	}
+	size_t free_tail = sb->buf_size - 1 - sb->end;
+	if (free_tail < (len - sb->gap_len)) {
+		strbuf_gap_close(sb);
+		size_t new_size = strbuf_len(sb) + len + 1;
+		if (new_size > sb->buf_size && new_size < (2 * sb->buf_size)) {
+			new_size = 2 * sb->buf_size;
+		}
+		if (!strbuf_grow(sb, new_size)) {
+			return false;
+		}
+		sb->gap = sb->start + pos;
+		free_tail = sb->buf_size - 1 - sb->end;
+	}
+	size_t after = sb->gap + sb->gap_len;
+	char *from = sb->buf + after;
+	strbuf_memmove(from + free_tail, from, sb->end - after);
+	sb->gap_len += free_tail;
+	sb->end += free_tail;
+	sb->buf[sb->end] = '\0';
+	return true;
+}
+
+strbuf_s *strbuf_insert(strbuf_s *sb, size_t pos, const char *str,
+			size_t len)
+{
+	eembed_assert(sb);
+	eembed_assert(str || !len);
+	size_t s_len = strbuf_len(sb);
+	if (pos > s_len) {
+		pos = s_len;
+	}
+	if (!len) {
+		return sb;
+	}
+	if (!strbuf_own(sb) || !strbuf_gap_reserve(sb, pos, len)) {
+		return NULL;
+	}
+	/* an insert may split a UTF-8 sequence */
+	strbuf_changed(sb);
+	strbuf_memcpy(sb->buf + sb->gap, str, len);
+	sb->gap += len;
+	sb->gap_len -= len;
+	return sb;
+}
+
+strbuf_s *strbuf_erase(strbuf_s *sb, size_t pos, size_t n)
+{
+	eembed_assert(sb);
+	size_t s_len = strbuf_len(sb);
+	if (pos > s_len) {
+		pos = s_len;
+	}
+	if (n > (s_len - pos)) {
+		n = s_len - pos;
+	}
+	if (!n) {
+		return sb;
+	}
+	if (!strbuf_own(sb)) {
+		return NULL;
+	}
+	strbuf_changed(sb);
+	strbuf_gap_move(sb, pos);
+	sb->gap_len += n;
+	return sb;
+}
+
+strbuf_s *strbuf_replace_range(strbuf_s *sb, size_t pos, size_t n,
+			       const char *str, size_t len)
+{
+	eembed_assert(sb);
+	eembed_assert(str || !len);
+	size_t s_len = strbuf_len(sb);
+	if (pos > s_len) {
+		pos = s_len;
+	}
+	if (n > (s_len - pos)) {
+		n = s_len - pos;
+	}
+	/* make room first, so that a failure leaves the string unchanged */
+	if ((n || len) && !strbuf_own(sb)) {
+		return NULL;
+	}
+	if (len > n && strbuf_avail(sb) < (len - n)) {
+		if (!strbuf_gap_reserve(sb, pos, len - n)) {
+			return NULL;
+		}
+	}
+	strbuf_erase(sb, pos, n);
+	return strbuf_insert(sb, pos, str, len);
+}
+
+strbuf_s *strbuf_consume(strbuf_s *sb, size_t n)
+{
+	eembed_assert(sb);
+	if (strbuf_interned(sb)) {
+		return NULL;
+	}
+	size_t len = strbuf_len(sb);
+	if (n > len) {
+		n = len;
+	}
+	if (!n) {
+		return sb;
+	}
+	/* nothing is written, so a shared buffer stays shared */
+	strbuf_changed(sb);
+	if (sb->wrap) {
+		size_t first = sb->wrap - sb->start;
+		if (n < first) {
+			sb->start += n;
+			return sb;
+		}
+		n -= first;
+		sb->start = 0;
+		sb->wrap = 0;
+	}
+	if (sb->gap_len && (sb->start + n) > sb->gap) {
+		sb->start += sb->gap_len;
+		sb->gap_len = 0;
+	}
+	/* the consumed bytes are left as they are, until the next rehome */
+	sb->start += n;
+	return sb;
+}
+
+const char *strbuf_compact_if(strbuf_s *sb, size_t percent)
 {
 	eembed_assert(sb);
+	if (sb->wrap || (sb->start * 100) <= (sb->buf_size * percent)) {
+		return strbuf_str(sb);
+	}
+	return strbuf_rehome(sb);
+}
 
-	strbuf_rehome(sb);
+char *strbuf_expose(strbuf_s *sb, size_t *size)
+{
+	eembed_assert(sb);
+	if (!strbuf_rehome(sb)) {
+		return NULL;
+	}
+	strbuf_changed(sb);
+	/* appends no longer clear what follows the end, yet the caller may
+	   write a shorter string there, and strbuf_return finds its NULL */
+	strbuf_memset(sb->buf + sb->end, 0x00, sb->buf_size - sb->end);
 
 	if (size) {
 		*size = sb->buf_size;
@@ -577,10 +1681,3414 @@ char *strbuf_expose(strbuf_s *sb, size_t *size)
 	return sb->buf;
 }
 
+char *strbuf_buffer(strbuf_s *sb, size_t *size)
+{
+	eembed_assert(sb);
+	eembed_assert(size);
+	*size = sb->buf_size;
+	return sb->buf;
+}
+
 const char *strbuf_return(strbuf_s *sb)
 {
 	eembed_assert(sb);
+	strbuf_changed(sb);
 	eembed_assert(sb->start == 0);
-	sb->end = eembed_strnlen(sb->buf, sb->buf_size);
+	sb->end = strbuf_strnlen(sb->buf, sb->buf_size);
 	return strbuf_str(sb);
 }
+
+char *strbuf_take(strbuf_s *sb, size_t *len)
+{
+	eembed_assert(sb);
+	if (strbuf_interned(sb)) {
+		return NULL;
+	}
+	size_t str_len = strbuf_len(sb);
+	if (!strbuf_shared(sb) && !strbuf_buf_needs_free(sb)) {
+		/* not ours to give away, so a copy */
+		struct eembed_allocator *ea = sb->ea;
+		char *copy = (char *)ea->malloc(ea, str_len + 1);
+		if (!copy) {
+			return NULL;
+		}
+		strbuf_memcpy(copy, strbuf_str(sb), str_len);
+		copy[str_len] = '\0';
+		strbuf_set(sb, NULL, 0);
+		if (len) {
+			*len = str_len;
+		}
+		return copy;
+	}
+	if (!strbuf_rehome(sb)) {
+		return NULL;
+	}
+	strbuf_changed(sb);
+	char *buf = sb->buf;
+	sb->buf = strbuf_taken_buf;
+	sb->buf_size = sizeof(strbuf_taken_buf);
+	sb->start = 0;
+	sb->end = 0;
+	strbuf_set_buf_needs_free(sb, false);
+	if (len) {
+		*len = str_len;
+	}
+	return buf;
+}
+
+strbuf_s *strbuf_adopt(strbuf_s *sb, char *buf, size_t len, size_t cap,
+		       struct eembed_allocator *ea)
+{
+	eembed_assert(sb);
+	if (ea == NULL) {
+		ea = eembed_global_allocator;
+	}
+	if (!buf || len >= cap || strbuf_interned(sb)) {
+		return NULL;
+	}
+	/* the struct is freed with the strbuf's allocator */
+	if (ea != sb->ea && strbuf_struct_needs_free(sb)) {
+		return NULL;
+	}
+	strbuf_changed(sb);
+	strbuf_buf_release(sb);
+	sb->ea = ea;
+	sb->buf = buf;
+	sb->buf_size = cap;
+	strbuf_set_buf_needs_free(sb, true);
+	/* a heap buffer which may grow: no longer a ring */
+	strbuf_flag_set(sb, strbuf_flag_ring, false);
+	sb->start = 0;
+	sb->end = strbuf_strnlen(buf, len);
+	sb->gap_len = 0;
+	sb->wrap = 0;
+	strbuf_memset(buf + sb->end, 0x00, cap - sb->end);
+	return sb;
+}
+
+/* writes the digits of "u" ending just before "end", returns the start */
+static char *strbuf_u64_to_dec(char *end, uint64_t u)
+{
+	static const char digit_pairs[] =
+	    "00010203040506070809" "10111213141516171819"
+	    "20212223242526272829" "30313233343536373839"
+	    "40414243444546474849" "50515253545556575859"
+	    "60616263646566676869" "70717273747576777879"
+	    "80818283848586878889" "90919293949596979899";
+	char *p = end;
+	while (u >= 100) {
+		size_t i = (size_t)(u % 100) * 2;
+		u /= 100;
+		*--p = digit_pairs[i + 1];
+		*--p = digit_pairs[i];
+	}
+	if (u >= 10) {
+		size_t i = (size_t)u * 2;
+		*--p = digit_pairs[i + 1];
+		*--p = digit_pairs[i];
+	} else {
+		*--p = (char)('0' + u);
+	}
+	return p;
+}
+
+enum strbuf_json_state {
+	strbuf_json_state_value = 0,
+	strbuf_json_state_key = 1,
+	strbuf_json_state_after_key = 2,
+};
+
+void strbuf_json_init(strbuf_json_s *json, strbuf_s *sb)
+{
+	eembed_assert(json);
+	eembed_assert(sb);
+	json->sb = sb;
+	json->has_members = 0;
+	json->is_object = 0;
+	json->depth = 0;
+	json->state = strbuf_json_state_value;
+}
+
+static uint64_t strbuf_json_bit(strbuf_json_s *json)
+{
+	return ((uint64_t)1) << (json->depth - 1);
+}
+
+/* writes the separator needed before a value or key, if any */
+static bool strbuf_json_separate(strbuf_json_s *json, bool is_key)
+{
+	if (is_key) {
+		if (json->state != strbuf_json_state_key) {
+			return false;
+		}
+	} else if (json->state == strbuf_json_state_key) {
+		return false;
+	}
+
+	if (json->state == strbuf_json_state_after_key) {
+		char *tail = strbuf_tail(json->sb, 1);
+		if (!tail) {
+			return false;
+		}
+		tail[0] = ':';
+		strbuf_tail_commit(json->sb, 1);
+		return true;
+	}
+
+	if (json->depth) {
+		uint64_t bit = strbuf_json_bit(json);
+		if (json->has_members & bit) {
+			char *tail = strbuf_tail(json->sb, 1);
+			if (!tail) {
+				return false;
+			}
+			tail[0] = ',';
+			strbuf_tail_commit(json->sb, 1);
+		}
+		json->has_members |= bit;
+	}
+	return true;
+}
+
+/* after a value in an object, the next thing must be a key */
+static const char *strbuf_json_done(strbuf_json_s *json)
+{
+	bool in_object = false;
+	if (json->depth) {
+		in_object = (json->is_object & strbuf_json_bit(json)) ? 1 : 0;
+	}
+	if (in_object) {
+		json->state = strbuf_json_state_key;
+	} else {
+		json->state = strbuf_json_state_value;
+	}
+	return strbuf_appended(json->sb);
+}
+
+static const char *strbuf_json_raw(strbuf_json_s *json, const char *str,
+				   size_t len)
+{
+	if (!strbuf_json_separate(json, false)) {
+		return NULL;
+	}
+	char *tail = strbuf_tail(json->sb, len);
+	if (!tail) {
+		return NULL;
+	}
+	strbuf_memcpy(tail, str, len);
+	strbuf_tail_commit(json->sb, len);
+	return strbuf_json_done(json);
+}
+
+static const char *strbuf_json_begin(strbuf_json_s *json, char open,
+				     bool is_object)
+{
+	eembed_assert(json);
+	if (json->depth >= STRBUF_JSON_MAX_DEPTH) {
+		return NULL;
+	}
+	if (!strbuf_json_separate(json, false)) {
+		return NULL;
+	}
+	char *tail = strbuf_tail(json->sb, 1);
+	if (!tail) {
+		return NULL;
+	}
+	tail[0] = open;
+	strbuf_tail_commit(json->sb, 1);
+
+	++(json->depth);
+	uint64_t bit = strbuf_json_bit(json);
+	json->has_members &= ~bit;
+	if (is_object) {
+		json->is_object |= bit;
+		json->state = strbuf_json_state_key;
+	} else {
+		json->is_object &= ~bit;
+		json->state = strbuf_json_state_value;
+	}
+	return strbuf_appended(json->sb);
+}
+
+static const char *strbuf_json_end(strbuf_json_s *json, char close,
+				   bool is_object)
+{
+	eembed_assert(json);
+	if (!json->depth) {
+		return NULL;
+	}
+	bool in_object = (json->is_object & strbuf_json_bit(json)) ? 1 : 0;
+	if (in_object != is_object) {
+		return NULL;
+	}
+	if (json->state == strbuf_json_state_after_key) {
+		return NULL;
+	}
+	char *tail = strbuf_tail(json->sb, 1);
+	if (!tail) {
+		return NULL;
+	}
+	tail[0] = close;
+	strbuf_tail_commit(json->sb, 1);
+	--(json->depth);
+	return strbuf_json_done(json);
+}
+
+const char *strbuf_json_object_begin(strbuf_json_s *json)
+{
+	return strbuf_json_begin(json, '{', true);
+}
+
+const char *strbuf_json_object_end(strbuf_json_s *json)
+{
+	return strbuf_json_end(json, '}', true);
+}
+
+const char *strbuf_json_array_begin(strbuf_json_s *json)
+{
+	return strbuf_json_begin(json, '[', false);
+}
+
+const char *strbuf_json_array_end(strbuf_json_s *json)
+{
+	return strbuf_json_end(json, ']', false);
+}
+
+/* copies runs of bytes which need no escaping a word at a time,
+   stops at a NULL byte or after "len" bytes; words are only loaded from
+   within the string, as "len" may be larger */
+static bool strbuf_json_escaped(strbuf_s *sb, const char *str, size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+	len = strbuf_strnlen(str, len);
+	size_t i = 0;
+	while (i < len) {
+		size_t run = i;
+		while ((run + sizeof(size_t)) <= len) {
+			size_t w = strbuf_load_word(str + run);
+			if (Strbuf_has_less(w, 0x20) || Strbuf_has_byte(w, '"')
+			    || Strbuf_has_byte(w, '\\')) {
+				break;
+			}
+			run += sizeof(size_t);
+		}
+		while (run < len) {
+			unsigned char c = (unsigned char)str[run];
+			if (c < 0x20 || c == '"' || c == '\\') {
+				break;
+			}
+			++run;
+		}
+		if (run > i) {
+			char *tail = strbuf_tail(sb, run - i);
+			if (!tail) {
+				return false;
+			}
+			strbuf_memcpy(tail, str + i, run - i);
+			strbuf_tail_commit(sb, run - i);
+			i = run;
+		}
+		if (i == len) {
+			return true;
+		}
+
+		unsigned char c = (unsigned char)str[i++];
+		char *tail = strbuf_tail(sb, 6);
+		if (!tail) {
+			return false;
+		}
+		size_t esc_len = 2;
+		tail[0] = '\\';
+		switch (c) {
+		case '"':
+		case '\\':
+			tail[1] = (char)c;
+			break;
+		case '\b':
+			tail[1] = 'b';
+			break;
+		case '\f':
+			tail[1] = 'f';
+			break;
+		case '\n':
+			tail[1] = 'n';
+			break;
+		case '\r':
+			tail[1] = 'r';
+			break;
+		case '\t':
+			tail[1] = 't';
+			break;
+		default:
+			tail[1] = 'u';
+			tail[2] = '0';
+			tail[3] = '0';
+			tail[4] = hex[c >> 4];
+			tail[5] = hex[c & 0x0F];
+			esc_len = 6;
+			break;
+		}
+		strbuf_tail_commit(sb, esc_len);
+	}
+	return true;
+}
+
+static bool strbuf_json_quoted(strbuf_s *sb, const char *str, size_t len)
+{
+	char *tail = strbuf_tail(sb, 1);
+	if (!tail) {
+		return false;
+	}
+	tail[0] = '"';
+	strbuf_tail_commit(sb, 1);
+	if (str && !strbuf_json_escaped(sb, str, len)) {
+		return false;
+	}
+	tail = strbuf_tail(sb, 1);
+	if (!tail) {
+		return false;
+	}
+	tail[0] = '"';
+	strbuf_tail_commit(sb, 1);
+	return true;
+}
+
+const char *strbuf_json_key(strbuf_json_s *json, const char *key, size_t len)
+{
+	eembed_assert(json);
+	if (!strbuf_json_separate(json, true)) {
+		return NULL;
+	}
+	if (!strbuf_json_quoted(json->sb, key, len)) {
+		return NULL;
+	}
+	json->state = strbuf_json_state_after_key;
+	return strbuf_appended(json->sb);
+}
+
+const char *strbuf_json_string(strbuf_json_s *json, const char *str,
+			       size_t len)
+{
+	eembed_assert(json);
+	if (!str) {
+		return strbuf_json_null(json);
+	}
+	if (!strbuf_json_separate(json, false)) {
+		return NULL;
+	}
+	if (!strbuf_json_quoted(json->sb, str, len)) {
+		return NULL;
+	}
+	return strbuf_json_done(json);
+}
+
+const char *strbuf_json_int(strbuf_json_s *json, int64_t i)
+{
+	eembed_assert(json);
+	char buf[24];
+	char *end = buf + sizeof(buf);
+	uint64_t u = (i < 0) ? (((uint64_t)0) - (uint64_t)i) : (uint64_t)i;
+	char *p = strbuf_u64_to_dec(end, u);
+	if (i < 0) {
+		*--p = '-';
+	}
+	return strbuf_json_raw(json, p, (size_t)(end - p));
+}
+
+const char *strbuf_json_uint(strbuf_json_s *json, uint64_t u)
+{
+	eembed_assert(json);
+	char buf[24];
+	char *end = buf + sizeof(buf);
+	char *p = strbuf_u64_to_dec(end, u);
+	return strbuf_json_raw(json, p, (size_t)(end - p));
+}
+
+static int strbuf_snprintf(char *str, size_t size, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	int printed = strbuf_vsnprintf(str, size, format, args);
+	va_end(args);
+	return printed;
+}
+
+const char *strbuf_json_double(strbuf_json_s *json, double d)
+{
+	eembed_assert(json);
+	/* JSON has no representation for NaN or the infinities */
+	if ((d != d) || ((d - d) != 0.0)) {
+		return strbuf_json_null(json);
+	}
+
+	const size_t buf_size = 40;
+	char buf[40];
+	char *end = buf + buf_size;
+
+	/* fast path: if d == m / 10^k for an exact integer m and an exact
+	   power of ten, then "m" with k decimal places parses back to d,
+	   as the division is correctly rounded; the smallest k is shortest */
+	/* the sign bit, so that -0.0 is written as "-0" */
+	uint64_t bits;
+	strbuf_memcpy(&bits, &d, sizeof(bits));
+	bool neg = (bits >> 63) ? true : false;
+	double pow10 = 1.0;
+	double a = neg ? -d : d;
+	for (size_t k = 0; k <= 15 && (a * pow10) < 9007199254740992.0; ++k) {
+		double scaled = a * pow10;
+		uint64_t m = (uint64_t)scaled;
+		if ((double)m == scaled && ((double)m / pow10) == a) {
+			char *p = strbuf_u64_to_dec(end, m);
+			size_t digits = (size_t)(end - p);
+			if (k) {
+				while (digits <= k) {
+					*--p = '0';
+					++digits;
+				}
+				strbuf_memmove(p - 1, p, digits - k);
+				--p;
+				p[digits - k] = '.';
+			}
+			if (neg) {
+				*--p = '-';
+			}
+			return strbuf_json_raw(json, p, (size_t)(end - p));
+		}
+		pow10 *= 10.0;
+	}
+
+	/* prefer the short form, if it survives the round trip */
+	int printed = strbuf_snprintf(buf, buf_size, "%.15g", d);
+#if EEMBED_HOSTED
+	if (printed > 0 && strtod(buf, NULL) != d) {
+		printed = strbuf_snprintf(buf, buf_size, "%.17g", d);
+	}
+#endif
+	if (printed < 0) {
+		eembed_float_to_str(buf, buf_size, d);
+	}
+	return strbuf_json_raw(json, buf, strbuf_strnlen(buf, buf_size));
+}
+
+const char *strbuf_json_bool(strbuf_json_s *json, int b)
+{
+	eembed_assert(json);
+	if (b) {
+		return strbuf_json_raw(json, "true", 4);
+	}
+	return strbuf_json_raw(json, "false", 5);
+}
+
+const char *strbuf_json_null(strbuf_json_s *json)
+{
+	eembed_assert(json);
+	return strbuf_json_raw(json, "null", 4);
+}
+
+/* bits in strbuf_escape_classes, one per mode, plus the terminator */
+#define Strbuf_esc_html 0x01
+#define Strbuf_esc_url 0x02
+#define Strbuf_esc_csv 0x04
+#define Strbuf_esc_shell 0x08
+#define Strbuf_esc_nul 0x80
+
+/* html: & < > " '
+   url: everything but the RFC 3986 unreserved A-Z a-z 0-9 - . _ ~
+   csv: , " CR LF force quoting
+   shell: everything but A-Z a-z 0-9 and @ % + = : , . / - _ force quoting */
+static const uint8_t strbuf_escape_classes[256] = {
+	0x80, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0x00 */
+	0x0a, 0x0a, 0x0e, 0x0a, 0x0a, 0x0e, 0x0a, 0x0a,	/* 0x08 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0x10 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0x18 */
+	0x0a, 0x0a, 0x0f, 0x0a, 0x0a, 0x02, 0x0b, 0x0b,	/*  !"#$%&' */
+	0x0a, 0x0a, 0x0a, 0x02, 0x06, 0x00, 0x00, 0x02,	/* ()*+,-./ */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* 01234567 */
+	0x00, 0x00, 0x02, 0x0a, 0x0b, 0x02, 0x0b, 0x0a,	/* 89:;<=>? */
+	0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* @ABCDEFG */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* HIJKLMNO */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* PQRSTUVW */
+	0x00, 0x00, 0x00, 0x0a, 0x0a, 0x0a, 0x0a, 0x00,	/* XYZ[\]^_ */
+	0x0a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* `abcdefg */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* hijklmno */
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,	/* pqrstuvw */
+	0x00, 0x00, 0x00, 0x0a, 0x0a, 0x0a, 0x08, 0x0a,	/* xyz{|}~ DEL */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0x80 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0x88 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0x90 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0x98 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0xa0 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0xa8 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0xb0 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0xb8 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0xc0 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0xc8 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0xd0 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0xd8 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0xe0 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0xe8 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0xf0 */
+	0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a,	/* 0xf8 */
+};
+
+static uint8_t strbuf_escape_bit(enum strbuf_escape mode)
+{
+	switch (mode) {
+	case strbuf_escape_html:
+		return Strbuf_esc_html;
+	case strbuf_escape_url:
+		return Strbuf_esc_url;
+	case strbuf_escape_csv:
+		return Strbuf_esc_csv;
+	case strbuf_escape_shell:
+		return Strbuf_esc_shell;
+	}
+	return 0;
+}
+
+/* for words of bytes below 0x80: the high bit of each byte in [lo, hi] */
+#define Strbuf_in_range(w, lo, hi) \
+	(((w) + (Strbuf_ones * (0x80 - (lo)))) \
+	 & ~((w) + (Strbuf_ones * (0x7F - (hi)))) & Strbuf_highs)
+
+/* every byte is one of A-Z a-z 0-9, which no mode escapes */
+static bool strbuf_word_alnum(size_t w)
+{
+	if (w & Strbuf_highs) {
+		return false;
+	}
+	size_t folded = w | (Strbuf_ones * 0x20);
+	size_t alnum = Strbuf_in_range(w, '0', '9')
+	    | Strbuf_in_range(folded, 'a', 'z');
+	return alnum == Strbuf_highs;
+}
+
+/* true if none of the bytes of the word need a closer look */
+static bool strbuf_escape_word_clean(enum strbuf_escape mode, size_t w)
+{
+	switch (mode) {
+	case strbuf_escape_html:
+		return !(Strbuf_has_zero(w) | Strbuf_has_byte(w, '&')
+			 | Strbuf_has_byte(w, '<') | Strbuf_has_byte(w, '>')
+			 | Strbuf_has_byte(w, '"') | Strbuf_has_byte(w, '\''));
+	case strbuf_escape_csv:
+		return !(Strbuf_has_zero(w) | Strbuf_has_byte(w, ',')
+			 | Strbuf_has_byte(w, '"') | Strbuf_has_byte(w, '\r')
+			 | Strbuf_has_byte(w, '\n'));
+	case strbuf_escape_url:
+	case strbuf_escape_shell:
+		return strbuf_word_alnum(w);
+	}
+	return false;
+}
+
+/* the escaped form of a byte which is special in the given mode;
+   csv and shell only escape the quote character, the rest are quoted */
+static size_t strbuf_escape_byte(enum strbuf_escape mode, unsigned char c,
+				 char *out)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	const char *s = NULL;
+	switch (mode) {
+	case strbuf_escape_html:
+		switch (c) {
+		case '&':
+			s = "&amp;";
+			break;
+		case '<':
+			s = "&lt;";
+			break;
+		case '>':
+			s = "&gt;";
+			break;
+		case '"':
+			s = "&quot;";
+			break;
+		default:
+			s = "&#39;";
+			break;
+		}
+		break;
+	case strbuf_escape_url:
+		out[0] = '%';
+		out[1] = hex[c >> 4];
+		out[2] = hex[c & 0x0F];
+		return 3;
+	case strbuf_escape_csv:
+		s = (c == '"') ? "\"\"" : NULL;
+		break;
+	case strbuf_escape_shell:
+		s = (c == '\'') ? "'\\''" : NULL;
+		break;
+	}
+	if (!s) {
+		out[0] = (char)c;
+		return 1;
+	}
+	size_t len = eembed_strlen(s);
+	strbuf_memcpy(out, s, len);
+	return len;
+}
+
+const char *strbuf_append_escaped(strbuf_s *sb, const char *str, size_t len,
+				  enum strbuf_escape mode)
+{
+	eembed_assert(sb);
+	if (!str) {
+		str = "(null)";
+		len = 6;
+	}
+	uint8_t bit = strbuf_escape_bit(mode);
+	uint8_t stop = bit | Strbuf_esc_nul;
+	/* "len" is a maximum; words are only loaded from within the string */
+	len = strbuf_strnlen(str, len);
+
+	/* first pass: the exact size of the output */
+	size_t str_len = 0;
+	size_t out_len = 0;
+	size_t specials = 0;
+	while (str_len < len) {
+		if ((str_len + sizeof(size_t)) <= len) {
+			size_t w = strbuf_load_word(str + str_len);
+			if (strbuf_escape_word_clean(mode, w)) {
+				str_len += sizeof(size_t);
+				out_len += sizeof(size_t);
+				continue;
+			}
+		}
+		unsigned char c = (unsigned char)str[str_len];
+		uint8_t class_bits = strbuf_escape_classes[c];
+		if (class_bits & stop) {
+			if (class_bits & Strbuf_esc_nul) {
+				break;
+			}
+			char tmp[8];
+			out_len += strbuf_escape_byte(mode, c, tmp);
+			++specials;
+		} else {
+			++out_len;
+		}
+		++str_len;
+	}
+
+	bool quote = false;
+	if (mode == strbuf_escape_csv || mode == strbuf_escape_shell) {
+		quote = (specials > 0);
+		if (mode == strbuf_escape_shell && !str_len) {
+			quote = true;
+		}
+	}
+	if (quote) {
+		out_len += 2;
+	}
+
+	char *tail = strbuf_tail(sb, out_len);
+	if (!tail) {
+		return NULL;
+	}
+
+	/* clean data is copied as-is */
+	if (out_len == str_len) {
+		strbuf_memcpy(tail, str, str_len);
+		strbuf_tail_commit(sb, str_len);
+		return strbuf_appended(sb);
+	}
+
+	char quote_char = (mode == strbuf_escape_csv) ? '"' : '\'';
+	char *out = tail;
+	if (quote) {
+		*out++ = quote_char;
+	}
+	size_t i = 0;
+	while (i < str_len) {
+		size_t run = i;
+		while (run < str_len) {
+			unsigned char c = (unsigned char)str[run];
+			if (strbuf_escape_classes[c] & bit) {
+				break;
+			}
+			++run;
+		}
+		strbuf_memcpy(out, str + i, run - i);
+		out += (run - i);
+		if (run == str_len) {
+			break;
+		}
+		out += strbuf_escape_byte(mode, (unsigned char)str[run], out);
+		i = run + 1;
+	}
+	if (quote) {
+		*out++ = quote_char;
+	}
+	eembed_assert((size_t)(out - tail) == out_len);
+	strbuf_tail_commit(sb, out_len);
+	return strbuf_appended(sb);
+}
+
+static int strbuf_hex_val(char c)
+{
+	unsigned digit = (unsigned)((unsigned char)c - '0');
+	unsigned alpha = (unsigned)(((unsigned char)c | 0x20) - 'a');
+	if (digit < 10) {
+		return (int)digit;
+	}
+	return (alpha < 6) ? (int)(alpha + 10) : -1;
+}
+
+/* returns the length of the entity at "s" or 0 if not recognized */
+static size_t strbuf_html_entity(const char *s, size_t len, char *out)
+{
+	static const char *names[] = { "&amp;", "&lt;", "&gt;", "&quot;",
+		"&apos;", "&#39;"
+	};
+	static const char chars[] = { '&', '<', '>', '"', '\'', '\'' };
+	for (size_t i = 0; i < (sizeof(chars) / sizeof(chars[0])); ++i) {
+		size_t nlen = eembed_strlen(names[i]);
+		if (nlen <= len && eembed_memcmp(s, names[i], nlen) == 0) {
+			*out = chars[i];
+			return nlen;
+		}
+	}
+	/* numeric character references, limited to a single byte */
+	if (len > 3 && s[1] == '#') {
+		size_t i = 2;
+		unsigned base = 10;
+		if (s[i] == 'x' || s[i] == 'X') {
+			base = 16;
+			++i;
+		}
+		unsigned val = 0;
+		size_t digits = 0;
+		while (i < len && digits < 4) {
+			int d = strbuf_hex_val(s[i]);
+			if (d < 0 || (unsigned)d >= base) {
+				break;
+			}
+			val = (val * base) + (unsigned)d;
+			++digits;
+			++i;
+		}
+		if (digits && i < len && s[i] == ';' && val && val < 0x80) {
+			*out = (char)val;
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+const char *strbuf_unescape(strbuf_s *sb, enum strbuf_escape mode)
+{
+	eembed_assert(sb);
+	if (!strbuf_own(sb)) {
+		return NULL;
+	}
+	strbuf_changed(sb);
+	strbuf_gap_close(sb);
+	char *s = sb->buf + sb->start;
+	size_t len = strbuf_len(sb);
+	size_t old_len = len;
+	size_t r = 0;
+	size_t w = 0;
+
+	switch (mode) {
+	case strbuf_escape_html:
+		while (r < len) {
+			size_t elen = 0;
+			if (s[r] == '&') {
+				size_t left = len - r;
+				elen = strbuf_html_entity(s + r, left, s + w);
+			}
+			if (elen) {
+				r += elen;
+			} else {
+				s[w] = s[r++];
+			}
+			++w;
+		}
+		break;
+	case strbuf_escape_url:
+		while (r < len) {
+			int hi = -1;
+			int lo = -1;
+			if (s[r] == '%' && (r + 2) < len) {
+				hi = strbuf_hex_val(s[r + 1]);
+				lo = strbuf_hex_val(s[r + 2]);
+			}
+			/* as "&#0;" for html, "%00" is left as it is: a NUL
+			   would cut the string short */
+			if (hi >= 0 && lo >= 0 && (hi | lo)) {
+				s[w++] = (char)((hi << 4) | lo);
+				r += 3;
+			} else {
+				s[w++] = s[r++];
+			}
+		}
+		break;
+	case strbuf_escape_csv:
+		if (len >= 2 && s[0] == '"' && s[len - 1] == '"') {
+			r = 1;
+			--len;
+			while (r < len) {
+				char next = ((r + 1) < len) ? s[r + 1] : '\0';
+				if (s[r] == '"' && next == '"') {
+					++r;
+				}
+				s[w++] = s[r++];
+			}
+		} else {
+			w = len;
+		}
+		break;
+	case strbuf_escape_shell:{
+			bool in_quote = false;
+			while (r < len) {
+				char c = s[r++];
+				if (c == '\'') {
+					in_quote = !in_quote;
+				} else if (!in_quote && c == '\\' && r < len) {
+					s[w++] = s[r++];
+				} else {
+					s[w++] = c;
+				}
+			}
+		}
+		break;
+	}
+
+	strbuf_memset(s + w, 0x00, old_len - w);
+	sb->end = sb->start + w;
+	return strbuf_str(sb);
+}
+
+static const char strbuf_base64_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const char strbuf_base64url_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+static size_t strbuf_base64_encode(char *out, const unsigned char *in,
+				   size_t len, const char *chars, bool pad)
+{
+	char *o = out;
+	size_t i = 0;
+	/* four groups of three bytes per round */
+	for (; (i + 12) <= len; i += 12) {
+		for (size_t j = 0; j < 12; j += 3) {
+			uint32_t v = ((uint32_t)in[i + j] << 16)
+			    | ((uint32_t)in[i + j + 1] << 8)
+			    | (uint32_t)in[i + j + 2];
+			o[0] = chars[v >> 18];
+			o[1] = chars[(v >> 12) & 0x3F];
+			o[2] = chars[(v >> 6) & 0x3F];
+			o[3] = chars[v & 0x3F];
+			o += 4;
+		}
+	}
+	for (; (i + 3) <= len; i += 3) {
+		uint32_t v = ((uint32_t)in[i] << 16)
+		    | ((uint32_t)in[i + 1] << 8) | (uint32_t)in[i + 2];
+		o[0] = chars[v >> 18];
+		o[1] = chars[(v >> 12) & 0x3F];
+		o[2] = chars[(v >> 6) & 0x3F];
+		o[3] = chars[v & 0x3F];
+		o += 4;
+	}
+	if (i < len) {
+		uint32_t v = ((uint32_t)in[i] << 16);
+		if ((i + 1) < len) {
+			v |= ((uint32_t)in[i + 1] << 8);
+		}
+		*o++ = chars[v >> 18];
+		*o++ = chars[(v >> 12) & 0x3F];
+		if ((i + 1) < len) {
+			*o++ = chars[(v >> 6) & 0x3F];
+		} else if (pad) {
+			*o++ = '=';
+		}
+		if (pad) {
+			*o++ = '=';
+		}
+	}
+	return (size_t)(o - out);
+}
+
+static size_t strbuf_base64_encoded_len(size_t len, bool pad)
+{
+	size_t out_len = (len / 3) * 4;
+	size_t rem = len % 3;
+	if (rem) {
+		out_len += pad ? 4 : (rem + 1);
+	}
+	return out_len;
+}
+
+static const char *strbuf_append_base64_chars(strbuf_s *sb, const void *data,
+					      size_t len, const char *chars,
+					      bool pad)
+{
+	eembed_assert(sb);
+	eembed_assert(data || !len);
+	size_t out_len = strbuf_base64_encoded_len(len, pad);
+	char *tail = strbuf_tail(sb, out_len);
+	if (!tail) {
+		return NULL;
+	}
+	size_t written = strbuf_base64_encode(tail, (const unsigned char *)data,
+					      len, chars, pad);
+	eembed_assert(written == out_len);
+	strbuf_tail_commit(sb, written);
+	return strbuf_appended(sb);
+}
+
+const char *strbuf_append_base64(strbuf_s *sb, const void *data, size_t len)
+{
+	return strbuf_append_base64_chars(sb, data, len, strbuf_base64_chars,
+					  true);
+}
+
+const char *strbuf_append_base64url(strbuf_s *sb, const void *data,
+				    size_t len)
+{
+	return strbuf_append_base64_chars(sb, data, len,
+					  strbuf_base64url_chars, false);
+}
+
+/* the 6 bit value of each character of both alphabets; characters only
+   in the standard alphabet have 0x80 set, only in the url alphabet 0x40,
+   characters in neither have both bits set */
+#define Strbuf_base64_std_only 0x80
+#define Strbuf_base64_url_only 0x40
+static const uint8_t strbuf_base64_values[256] = {
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xbe, 0xc0, 0x7e, 0xc0, 0xbf,
+	0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b,
+	0x3c, 0x3d, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+	0x17, 0x18, 0x19, 0xc0, 0xc0, 0xc0, 0xc0, 0x7f,
+	0xc0, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20,
+	0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30,
+	0x31, 0x32, 0x33, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+	0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0,
+};
+
+/* drops the padding from "len"; if any, it must complete the last
+   quantum of four, and no quantum may end after a single character */
+static bool strbuf_base64_unpad(const char *in, size_t *len)
+{
+	size_t pad = 0;
+	while (pad < 2 && *len && in[*len - 1] == '=') {
+		--(*len);
+		++pad;
+	}
+	if (pad && ((*len + pad) % 4) != 0) {
+		return false;
+	}
+	return (*len % 4) != 1;
+}
+
+/* the checks of strbuf_base64_decode, without decoding */
+static bool strbuf_base64_valid(const char *in, size_t len,
+				uint8_t invalid_bit)
+{
+	if (!strbuf_base64_unpad(in, &len)) {
+		return false;
+	}
+	uint8_t invalid = 0;
+	for (size_t i = 0; i < len; ++i) {
+		invalid |= strbuf_base64_values[(unsigned char)in[i]];
+	}
+	return !(invalid & invalid_bit);
+}
+
+/* returns the number of bytes written, or SIZE_MAX if "in" is not valid */
+static size_t strbuf_base64_decode(unsigned char *out, const char *in,
+				   size_t len, uint8_t invalid_bit)
+{
+	const uint8_t *table = strbuf_base64_values;
+
+	if (!strbuf_base64_unpad(in, &len)) {
+		return SIZE_MAX;
+	}
+
+	const unsigned char *s = (const unsigned char *)in;
+	unsigned char *o = out;
+	uint8_t invalid = 0;
+	size_t i = 0;
+	for (; (i + 4) <= len; i += 4) {
+		uint8_t a = table[s[i]];
+		uint8_t b = table[s[i + 1]];
+		uint8_t c = table[s[i + 2]];
+		uint8_t d = table[s[i + 3]];
+		/* accumulate the flag bits, check once at the end */
+		invalid |= (uint8_t)(a | b | c | d);
+		uint32_t v = ((uint32_t)(a & 0x3F) << 18)
+		    | ((uint32_t)(b & 0x3F) << 12)
+		    | ((uint32_t)(c & 0x3F) << 6) | (uint32_t)(d & 0x3F);
+		o[0] = (unsigned char)(v >> 16);
+		o[1] = (unsigned char)(v >> 8);
+		o[2] = (unsigned char)v;
+		o += 3;
+	}
+	if (i < len) {
+		uint8_t a = table[s[i]];
+		uint8_t b = table[s[i + 1]];
+		uint8_t c = ((i + 2) < len) ? table[s[i + 2]] : 0;
+		invalid |= (uint8_t)(a | b | c);
+		uint32_t v = ((uint32_t)(a & 0x3F) << 18)
+		    | ((uint32_t)(b & 0x3F) << 12)
+		    | ((uint32_t)(c & 0x3F) << 6);
+		*o++ = (unsigned char)(v >> 16);
+		if ((i + 2) < len) {
+			*o++ = (unsigned char)(v >> 8);
+		}
+	}
+	if (invalid & invalid_bit) {
+		return SIZE_MAX;
+	}
+	return (size_t)(o - out);
+}
+
+/* on error, the tail is zeroed again and the contents are unchanged; a
+   ring checks first, as reserving the tail may push out its oldest bytes */
+static const char *strbuf_append_base64_decoded_bit(strbuf_s *sb,
+						    const char *src,
+						    size_t len,
+						    uint8_t invalid_bit)
+{
+	eembed_assert(sb);
+	eembed_assert(src || !len);
+	if (strbuf_ring_mode(sb)
+	    && !strbuf_base64_valid(src, len, invalid_bit)) {
+		return NULL;
+	}
+	size_t max_len = ((len + 3) / 4) * 3;
+	char *tail = strbuf_tail(sb, max_len);
+	if (!tail) {
+		return NULL;
+	}
+	size_t written = strbuf_base64_decode((unsigned char *)tail, src, len,
+					      invalid_bit);
+	if (written == SIZE_MAX) {
+		strbuf_memset(tail, 0x00, max_len);
+		return NULL;
+	}
+	strbuf_memset(tail + written, 0x00, max_len - written);
+	strbuf_tail_commit(sb, written);
+	return strbuf_appended(sb);
+}
+
+const char *strbuf_append_base64_decoded(strbuf_s *sb, const char *src,
+					 size_t len)
+{
+	return strbuf_append_base64_decoded_bit(sb, src, len,
+						Strbuf_base64_url_only);
+}
+
+const char *strbuf_append_base64url_decoded(strbuf_s *sb, const char *src,
+					    size_t len)
+{
+	return strbuf_append_base64_decoded_bit(sb, src, len,
+						Strbuf_base64_std_only);
+}
+
+const char *strbuf_append_hex(strbuf_s *sb, const void *data, size_t len)
+{
+	eembed_assert(sb);
+	eembed_assert(data || !len);
+	static const char hex[] = "0123456789abcdef";
+	char *tail = strbuf_tail(sb, 2 * len);
+	if (!tail) {
+		return NULL;
+	}
+	const unsigned char *in = (const unsigned char *)data;
+	for (size_t i = 0; i < len; ++i) {
+		tail[2 * i] = hex[in[i] >> 4];
+		tail[(2 * i) + 1] = hex[in[i] & 0x0F];
+	}
+	strbuf_tail_commit(sb, 2 * len);
+	return strbuf_appended(sb);
+}
+
+const char *strbuf_append_hex_decoded(strbuf_s *sb, const char *src,
+				      size_t len)
+{
+	eembed_assert(sb);
+	eembed_assert(src || !len);
+	if (len % 2) {
+		return NULL;
+	}
+	/* as for base64, a ring checks before it may push anything out */
+	if (strbuf_ring_mode(sb)) {
+		for (size_t i = 0; i < len; ++i) {
+			if (strbuf_hex_val(src[i]) < 0) {
+				return NULL;
+			}
+		}
+	}
+	char *tail = strbuf_tail(sb, len / 2);
+	if (!tail) {
+		return NULL;
+	}
+	int invalid = 0;
+	for (size_t i = 0; i < len; i += 2) {
+		int hi = strbuf_hex_val(src[i]);
+		int lo = strbuf_hex_val(src[i + 1]);
+		invalid |= (hi | lo);
+		/* in unsigned, as either may be -1 until checked at the end */
+		unsigned byte = ((unsigned)hi & 0x0F) << 4;
+		byte |= ((unsigned)lo & 0x0F);
+		tail[i / 2] = (char)byte;
+	}
+	if (invalid < 0) {
+		strbuf_memset(tail, 0x00, len / 2);
+		return NULL;
+	}
+	strbuf_tail_commit(sb, len / 2);
+	return strbuf_appended(sb);
+}
+
+int strbuf_utf8_valid(strbuf_s *sb)
+{
+	eembed_assert(sb);
+	if (strbuf_utf8_known(sb)) {
+		return 1;
+	}
+	/* checked when interned, and shared: not to be written */
+	if (strbuf_interned(sb)) {
+		return 0;
+	}
+	bool valid = strbuf_utf8_check(strbuf_str(sb), strbuf_len(sb));
+	strbuf_flag_set(sb, strbuf_flag_utf8_valid, valid);
+	return valid ? 1 : 0;
+}
+
+/* continuation bytes, 10xxxxxx, in each byte of the word */
+static size_t strbuf_utf8_continuations(size_t w)
+{
+	size_t cont = (w & ~(w << 1)) & Strbuf_highs;
+	/* sum the bytes (each now 0 or 1) into the most significant byte */
+	return ((cont >> 7) * Strbuf_ones) >> ((sizeof(size_t) - 1) * 8);
+}
+
+size_t strbuf_utf8_len(strbuf_s *sb)
+{
+	eembed_assert(sb);
+	const char *s = strbuf_str(sb);
+	size_t len = strbuf_len(sb);
+	size_t count = 0;
+	size_t i = 0;
+	for (; (i + sizeof(size_t)) <= len; i += sizeof(size_t)) {
+		size_t w = strbuf_load_word(s + i);
+		count += sizeof(size_t) - strbuf_utf8_continuations(w);
+	}
+	for (; i < len; ++i) {
+		if ((((unsigned char)s[i]) & 0xC0) != 0x80) {
+			++count;
+		}
+	}
+	return count;
+}
+
+size_t strbuf_utf8_offset(strbuf_s *sb, size_t cp_index)
+{
+	eembed_assert(sb);
+	const char *s = strbuf_str(sb);
+	size_t len = strbuf_len(sb);
+	size_t count = 0;
+	size_t i = 0;
+	/* skip whole words while the wanted code point is beyond them */
+	while ((i + sizeof(size_t)) < len) {
+		size_t w = strbuf_load_word(s + i);
+		size_t starts = sizeof(size_t) - strbuf_utf8_continuations(w);
+		if ((count + starts) > cp_index) {
+			break;
+		}
+		count += starts;
+		i += sizeof(size_t);
+	}
+	for (; i < len; ++i) {
+		if ((((unsigned char)s[i]) & 0xC0) != 0x80) {
+			if (count == cp_index) {
+				return i;
+			}
+			++count;
+		}
+	}
+	return len;
+}
+
+/* a wyhash-style hash: 64x64->128 multiply, folded */
+static uint64_t strbuf_mix(uint64_t a, uint64_t b)
+{
+	/* portable 64x64 multiply, no 128 bit type needed */
+	uint64_t a_lo = a & 0xFFFFFFFF;
+	uint64_t a_hi = a >> 32;
+	uint64_t b_lo = b & 0xFFFFFFFF;
+	uint64_t b_hi = b >> 32;
+	uint64_t lo_lo = a_lo * b_lo;
+	uint64_t hi_lo = a_hi * b_lo;
+	uint64_t lo_hi = a_lo * b_hi;
+	uint64_t hi_hi = a_hi * b_hi;
+	uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+	uint64_t lo = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+	uint64_t hi = hi_hi + (hi_lo >> 32) + (cross >> 32);
+	return lo ^ hi;
+}
+
+static uint64_t strbuf_read64(const unsigned char *p)
+{
+	uint64_t v;
+	strbuf_memcpy(&v, p, 8);
+	return v;
+}
+
+static uint64_t strbuf_read32(const unsigned char *p)
+{
+	uint32_t v;
+	strbuf_memcpy(&v, p, 4);
+	return v;
+}
+
+static uint64_t strbuf_hash_bytes(const char *str, size_t len)
+{
+	const uint64_t s0 = 0xa0761d6478bd642fULL;
+	const uint64_t s1 = 0xe7037ed1a0b428dbULL;
+	const uint64_t s2 = 0x8ebc6af09c88c6e3ULL;
+	const uint64_t s3 = 0x589965cc75374cc3ULL;
+	const unsigned char *p = (const unsigned char *)str;
+	uint64_t seed = strbuf_mix(s0, s1);
+	uint64_t a = 0;
+	uint64_t b = 0;
+	if (len <= 16) {
+		if (len >= 4) {
+			size_t mid = (len >> 3) << 2;
+			a = (strbuf_read32(p) << 32) | strbuf_read32(p + mid);
+			b = (strbuf_read32(p + len - 4) << 32)
+			    | strbuf_read32(p + len - 4 - mid);
+		} else if (len > 0) {
+			a = ((uint64_t)p[0]) << 16;
+			a |= ((uint64_t)p[len >> 1]) << 8;
+			a |= p[len - 1];
+		}
+	} else {
+		size_t i = len;
+		if (i > 48) {
+			uint64_t see1 = seed;
+			uint64_t see2 = seed;
+			do {
+				seed = strbuf_mix(strbuf_read64(p) ^ s1,
+						  strbuf_read64(p + 8) ^ seed);
+				see1 = strbuf_mix(strbuf_read64(p + 16) ^ s2,
+						  strbuf_read64(p + 24) ^ see1);
+				see2 = strbuf_mix(strbuf_read64(p + 32) ^ s3,
+						  strbuf_read64(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16) {
+			seed = strbuf_mix(strbuf_read64(p) ^ s1,
+					  strbuf_read64(p + 8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+		a = strbuf_read64(p + i - 16);
+		b = strbuf_read64(p + i - 8);
+	}
+	return strbuf_mix(s1 ^ len, strbuf_mix(a ^ s1, b ^ seed));
+}
+
+uint64_t strbuf_hash(strbuf_s *sb)
+{
+	eembed_assert(sb);
+	if (!strbuf_flag_get(sb, strbuf_flag_hash_valid)) {
+		sb->hash = strbuf_hash_bytes(strbuf_str(sb), strbuf_len(sb));
+		strbuf_flag_set(sb, strbuf_flag_hash_valid, true);
+	}
+	return sb->hash;
+}
+
+int strbuf_eq(strbuf_s *a, strbuf_s *b)
+{
+	eembed_assert(a);
+	eembed_assert(b);
+	if (a == b) {
+		return 1;
+	}
+	size_t len = strbuf_len(a);
+	if (len != strbuf_len(b)) {
+		return 0;
+	}
+	if (strbuf_flag_get(a, strbuf_flag_hash_valid)
+	    && strbuf_flag_get(b, strbuf_flag_hash_valid)
+	    && a->hash != b->hash) {
+		return 0;
+	}
+	return eembed_memcmp(strbuf_str(a), strbuf_str(b), len) == 0 ? 1 : 0;
+}
+
+int strbuf_cmp(strbuf_s *sb, const char *str, size_t len)
+{
+	eembed_assert(sb);
+	eembed_assert(str || !len);
+	size_t s_len = strbuf_len(sb);
+	size_t min = s_len < len ? s_len : len;
+	int cmp = min ? eembed_memcmp(strbuf_str(sb), str, min) : 0;
+	if (cmp || s_len == len) {
+		return cmp;
+	}
+	return s_len < len ? -1 : 1;
+}
+
+int strbuf_starts_with(strbuf_s *sb, const char *prefix, size_t len)
+{
+	eembed_assert(sb);
+	eembed_assert(prefix || !len);
+	if (len > strbuf_len(sb)) {
+		return 0;
+	}
+	return (!len || !eembed_memcmp(strbuf_str(sb), prefix, len)) ? 1 : 0;
+}
+
+int strbuf_ends_with(strbuf_s *sb, const char *suffix, size_t len)
+{
+	eembed_assert(sb);
+	eembed_assert(suffix || !len);
+	if (len > strbuf_len(sb)) {
+		return 0;
+	}
+	const char *tail = strbuf_str(sb) + strbuf_len(sb) - len;
+	return (!len || !eembed_memcmp(tail, suffix, len)) ? 1 : 0;
+}
+
+size_t strbuf_common_prefix_len(strbuf_s *sb, const char *str, size_t len)
+{
+	eembed_assert(sb);
+	eembed_assert(str || !len);
+	const char *s = strbuf_str(sb);
+	size_t s_len = strbuf_len(sb);
+	size_t min = s_len < len ? s_len : len;
+	size_t i = 0;
+	/* find the first differing word, then the byte within it */
+	for (; (i + sizeof(size_t)) <= min; i += sizeof(size_t)) {
+		if (strbuf_load_word(s + i) != strbuf_load_word(str + i)) {
+			break;
+		}
+	}
+	while (i < min && s[i] == str[i]) {
+		++i;
+	}
+	return i;
+}
+
+/* an interned string: the struct, the count and the bytes are a single
+   allocation; the table owns it, callers hold references */
+struct strbuf_interned {
+	strbuf_s sb;
+	size_t refs;
+};
+
+struct strbuf_intern_slot {
+	uint64_t hash;
+	struct strbuf_interned *entry;
+};
+
+/* open addressing with linear probing; the stored hash avoids touching
+   the entry on most mismatches and lets the shard grow without rehashing */
+struct strbuf_intern_shard {
+	unsigned char lock;
+	size_t used;
+	size_t capacity;
+	struct strbuf_intern_slot *slots;
+};
+
+struct strbuf_intern {
+	struct eembed_allocator *ea;
+	size_t num_shards;
+	struct strbuf_intern_shard *shards;
+};
+
+#if defined(__GNUC__) && EEMBED_HOSTED
+static void strbuf_intern_lock(struct strbuf_intern_shard *shard)
+{
+	while (__atomic_test_and_set(&shard->lock, __ATOMIC_ACQUIRE)) {
+		while (__atomic_load_n(&shard->lock, __ATOMIC_RELAXED)) ;
+	}
+}
+
+static void strbuf_intern_unlock(struct strbuf_intern_shard *shard)
+{
+	__atomic_clear(&shard->lock, __ATOMIC_RELEASE);
+}
+#else
+/* freestanding builds are assumed to be single threaded */
+static void strbuf_intern_lock(struct strbuf_intern_shard *shard)
+{
+	(void)shard;
+}
+
+static void strbuf_intern_unlock(struct strbuf_intern_shard *shard)
+{
+	(void)shard;
+}
+#endif
+
+strbuf_intern_s *strbuf_intern_new(struct eembed_allocator *ea,
+				   size_t num_shards)
+{
+	if (!ea) {
+		ea = eembed_global_allocator;
+	}
+	size_t n = 1;
+	while (n < num_shards) {
+		n <<= 1;
+	}
+	size_t size = sizeof(strbuf_intern_s)
+	    + (n * sizeof(struct strbuf_intern_shard));
+	strbuf_intern_s *table = (strbuf_intern_s *)ea->malloc(ea, size);
+	if (!table) {
+		return NULL;
+	}
+	strbuf_memset(table, 0x00, size);
+	table->ea = ea;
+	table->num_shards = n;
+	table->shards = (struct strbuf_intern_shard *)(table + 1);
+	return table;
+}
+
+void strbuf_intern_destroy(strbuf_intern_s *table)
+{
+	if (!table) {
+		return;
+	}
+	struct eembed_allocator *ea = table->ea;
+	for (size_t i = 0; i < table->num_shards; ++i) {
+		struct strbuf_intern_shard *shard = table->shards + i;
+		for (size_t j = 0; j < shard->capacity; ++j) {
+			if (shard->slots[j].entry) {
+				ea->free(ea, shard->slots[j].entry);
+			}
+		}
+		if (shard->slots) {
+			ea->free(ea, shard->slots);
+		}
+	}
+	ea->free(ea, table);
+}
+
+static struct strbuf_intern_shard *strbuf_intern_shard(strbuf_intern_s *table,
+						       uint64_t hash)
+{
+	/* the low bits pick the slot, so use high bits to pick the shard */
+	size_t idx = ((size_t)(hash >> 40)) & (table->num_shards - 1);
+	return table->shards + idx;
+}
+
+/* returns the slot holding the string, or the empty slot where it goes */
+static struct strbuf_intern_slot *strbuf_intern_find(struct strbuf_intern_shard
+						     *shard, uint64_t hash,
+						     const char *str,
+						     size_t len)
+{
+	size_t mask = shard->capacity - 1;
+	size_t i = ((size_t)hash) & mask;
+	for (;; i = (i + 1) & mask) {
+		struct strbuf_intern_slot *slot = shard->slots + i;
+		if (!slot->entry) {
+			return slot;
+		}
+		strbuf_s *sb = &slot->entry->sb;
+		if (slot->hash == hash && strbuf_len(sb) == len
+		    && eembed_memcmp(sb->buf, str, len) == 0) {
+			return slot;
+		}
+	}
+}
+
+/* keep the load below 3/4 */
+static bool strbuf_intern_grow(struct eembed_allocator *ea,
+			       struct strbuf_intern_shard *shard)
+{
+	if (((shard->used + 1) * 4) <= (shard->capacity * 3)) {
+		return true;
+	}
+	size_t capacity = shard->capacity ? (2 * shard->capacity) : 16;
+	size_t size = capacity * sizeof(struct strbuf_intern_slot);
+	struct strbuf_intern_slot *slots =
+	    (struct strbuf_intern_slot *)ea->malloc(ea, size);
+	if (!slots) {
+		return false;
+	}
+	strbuf_memset(slots, 0x00, size);
+	size_t mask = capacity - 1;
+	for (size_t j = 0; j < shard->capacity; ++j) {
+		struct strbuf_intern_slot *old = shard->slots + j;
+		if (old->entry) {
+			size_t i = ((size_t)old->hash) & mask;
+			while (slots[i].entry) {
+				i = (i + 1) & mask;
+			}
+			slots[i] = *old;
+		}
+	}
+	if (shard->slots) {
+		ea->free(ea, shard->slots);
+	}
+	shard->slots = slots;
+	shard->capacity = capacity;
+	return true;
+}
+
+static struct strbuf_interned *strbuf_interned_new(struct eembed_allocator
+						   *ea, const char *str,
+						   size_t len, uint64_t hash)
+{
+	size_t size = sizeof(struct strbuf_interned) + len + 1;
+	struct strbuf_interned *entry =
+	    (struct strbuf_interned *)ea->malloc(ea, size);
+	if (!entry) {
+		return NULL;
+	}
+	strbuf_memset(entry, 0x00, sizeof(struct strbuf_interned));
+	strbuf_s *sb = &entry->sb;
+	sb->buf = (char *)(entry + 1);
+	if (len) {
+		strbuf_memcpy(sb->buf, str, len);
+	}
+	sb->buf[len] = '\0';
+	sb->buf_size = len + 1;
+	sb->start = 0;
+	sb->end = len;
+	sb->ea = ea;
+	sb->hash = hash;
+	strbuf_flag_set(sb, strbuf_flag_hash_valid, true);
+	/* as with the hash, so that readers in other threads never write */
+	strbuf_flag_set(sb, strbuf_flag_utf8_valid,
+			strbuf_utf8_check(sb->buf, len));
+	strbuf_flag_set(sb, strbuf_flag_interned, true);
+	entry->refs = 1;
+	return entry;
+}
+
+strbuf_s *strbuf_intern(strbuf_intern_s *table, const char *str, size_t len)
+{
+	eembed_assert(table);
+	eembed_assert(str || !len);
+	uint64_t hash = strbuf_hash_bytes(str, len);
+	struct strbuf_intern_shard *shard = strbuf_intern_shard(table, hash);
+	strbuf_s *result = NULL;
+
+	strbuf_intern_lock(shard);
+	struct strbuf_intern_slot *slot = NULL;
+	if (shard->capacity) {
+		slot = strbuf_intern_find(shard, hash, str, len);
+	}
+	if (slot && slot->entry) {
+		++(slot->entry->refs);
+		result = &slot->entry->sb;
+	} else if (strbuf_intern_grow(table->ea, shard)) {
+		slot = strbuf_intern_find(shard, hash, str, len);
+		slot->entry = strbuf_interned_new(table->ea, str, len, hash);
+		if (slot->entry) {
+			slot->hash = hash;
+			++(shard->used);
+			result = &slot->entry->sb;
+		}
+	}
+	strbuf_intern_unlock(shard);
+
+	return result;
+}
+
+/* backward-shift deletion, so no tombstones are needed */
+static void strbuf_intern_remove(struct strbuf_intern_shard *shard,
+				 struct strbuf_interned *entry)
+{
+	size_t mask = shard->capacity - 1;
+	size_t i = ((size_t)entry->sb.hash) & mask;
+	while (shard->slots[i].entry != entry) {
+		i = (i + 1) & mask;
+	}
+	size_t j = i;
+	for (;;) {
+		j = (j + 1) & mask;
+		struct strbuf_intern_slot *slot = shard->slots + j;
+		if (!slot->entry) {
+			break;
+		}
+		/* move back unless its home slot is cyclically in (i, j] */
+		size_t home = ((size_t)slot->hash) & mask;
+		bool stays = (i < j) ? (home > i && home <= j)
+		    : (home > i || home <= j);
+		if (!stays) {
+			shard->slots[i] = *slot;
+			i = j;
+		}
+	}
+	shard->slots[i].entry = NULL;
+	shard->slots[i].hash = 0;
+	--(shard->used);
+}
+
+void strbuf_intern_release(strbuf_intern_s *table, strbuf_s *sb)
+{
+	eembed_assert(table);
+	if (!sb) {
+		return;
+	}
+	eembed_assert(strbuf_flag_get(sb, strbuf_flag_interned));
+	struct strbuf_interned *entry = (struct strbuf_interned *)sb;
+	struct strbuf_intern_shard *shard;
+	shard = strbuf_intern_shard(table, sb->hash);
+
+	strbuf_intern_lock(shard);
+	eembed_assert(entry->refs);
+	--(entry->refs);
+	if (!entry->refs) {
+		strbuf_intern_remove(shard, entry);
+	} else {
+		entry = NULL;
+	}
+	strbuf_intern_unlock(shard);
+
+	if (entry) {
+		table->ea->free(table->ea, entry);
+	}
+}
+
+size_t strbuf_intern_count(strbuf_intern_s *table)
+{
+	eembed_assert(table);
+	size_t count = 0;
+	for (size_t i = 0; i < table->num_shards; ++i) {
+		struct strbuf_intern_shard *shard = table->shards + i;
+		strbuf_intern_lock(shard);
+		count += shard->used;
+		strbuf_intern_unlock(shard);
+	}
+	return count;
+}
+
+/* precompiled formats: a program of literal runs and typed conversions */
+enum strbuf_fmt_conv {
+	strbuf_fmt_literal = 0,
+	strbuf_fmt_int = 1,
+	strbuf_fmt_uint = 2,
+	strbuf_fmt_hex = 3,
+	strbuf_fmt_hex_upper = 4,
+	strbuf_fmt_str = 5,
+	strbuf_fmt_char = 6,
+	strbuf_fmt_double = 7,
+};
+
+enum strbuf_fmt_len {
+	strbuf_fmt_len_none = 0,
+	strbuf_fmt_len_hh = 1,
+	strbuf_fmt_len_h = 2,
+	strbuf_fmt_len_l = 3,
+	strbuf_fmt_len_ll = 4,
+	strbuf_fmt_len_z = 5,
+	strbuf_fmt_len_j = 6,
+	strbuf_fmt_len_L = 7,
+};
+
+#define Strbuf_fmt_left 0x01
+#define Strbuf_fmt_zero 0x02
+#define Strbuf_fmt_plus 0x04
+#define Strbuf_fmt_space 0x08
+#define Strbuf_fmt_alt 0x10
+
+/* arbitrary, but keeps the worst case size from overflowing */
+#define Strbuf_fmt_max_width 4096
+
+struct strbuf_fmt_op {
+	/* literal bytes, or for doubles the NUL terminated printf spec */
+	size_t text_off;
+	size_t text_len;
+	int width;
+	int precision;
+	uint8_t conv;
+	uint8_t len;
+	uint8_t flags;
+	char spec;
+};
+
+struct strbuf_fmt {
+	struct eembed_allocator *ea;
+	size_t num_ops;
+	size_t literal_len;
+	struct strbuf_fmt_op *ops;
+	char *text;
+};
+
+static bool strbuf_fmt_number(const char **f, int *out)
+{
+	int n = 0;
+	while (**f >= '0' && **f <= '9') {
+		n = (n * 10) + (**f - '0');
+		if (n > Strbuf_fmt_max_width) {
+			return false;
+		}
+		++(*f);
+	}
+	*out = n;
+	return true;
+}
+
+static bool strbuf_fmt_conversion(const char **f, struct strbuf_fmt_op *op)
+{
+	for (;; ++(*f)) {
+		char c = **f;
+		if (c == '-') {
+			op->flags |= Strbuf_fmt_left;
+		} else if (c == '0') {
+			op->flags |= Strbuf_fmt_zero;
+		} else if (c == '+') {
+			op->flags |= Strbuf_fmt_plus;
+		} else if (c == ' ') {
+			op->flags |= Strbuf_fmt_space;
+		} else if (c == '#') {
+			op->flags |= Strbuf_fmt_alt;
+		} else {
+			break;
+		}
+	}
+	op->width = -1;
+	if (**f >= '0' && **f <= '9') {
+		if (!strbuf_fmt_number(f, &op->width)) {
+			return false;
+		}
+	}
+	op->precision = -1;
+	if (**f == '.') {
+		++(*f);
+		if (!strbuf_fmt_number(f, &op->precision)) {
+			return false;
+		}
+	}
+	switch (**f) {
+	case 'h':
+		++(*f);
+		op->len = strbuf_fmt_len_h;
+		if (**f == 'h') {
+			++(*f);
+			op->len = strbuf_fmt_len_hh;
+		}
+		break;
+	case 'l':
+		++(*f);
+		op->len = strbuf_fmt_len_l;
+		if (**f == 'l') {
+			++(*f);
+			op->len = strbuf_fmt_len_ll;
+		}
+		break;
+	case 'z':
+		++(*f);
+		op->len = strbuf_fmt_len_z;
+		break;
+	case 'j':
+		++(*f);
+		op->len = strbuf_fmt_len_j;
+		break;
+	case 'L':
+		++(*f);
+		op->len = strbuf_fmt_len_L;
+		break;
+	default:
+		op->len = strbuf_fmt_len_none;
+		break;
+	}
+	op->spec = **f;
+	switch (**f) {
+	case 'd':
+	case 'i':
+		op->conv = strbuf_fmt_int;
+		break;
+	case 'u':
+		op->conv = strbuf_fmt_uint;
+		break;
+	case 'x':
+		op->conv = strbuf_fmt_hex;
+		break;
+	case 'X':
+		op->conv = strbuf_fmt_hex_upper;
+		break;
+	case 's':
+		op->conv = strbuf_fmt_str;
+		break;
+	case 'c':
+		op->conv = strbuf_fmt_char;
+		break;
+	case 'f':
+	case 'F':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+		op->conv = strbuf_fmt_double;
+		break;
+	default:
+		return false;
+	}
+	++(*f);
+	if (op->conv == strbuf_fmt_double) {
+		return op->len == strbuf_fmt_len_none
+		    || op->len == strbuf_fmt_len_L;
+	}
+	if (op->conv == strbuf_fmt_str || op->conv == strbuf_fmt_char) {
+		return op->len == strbuf_fmt_len_none;
+	}
+	return op->len != strbuf_fmt_len_L;
+}
+
+/* with a NULL prog, only counts the ops and text bytes needed */
+static bool strbuf_fmt_parse(const char *f, strbuf_fmt_s *prog,
+			     size_t *num_ops, size_t *text_len)
+{
+	size_t ops = 0;
+	size_t text = 0;
+	bool in_literal = false;
+	while (*f) {
+		if (*f != '%' || f[1] == '%') {
+			if (!in_literal) {
+				if (prog) {
+					struct strbuf_fmt_op *op;
+					op = prog->ops + ops;
+					strbuf_memset(op, 0x00, sizeof(*op));
+					op->conv = strbuf_fmt_literal;
+					op->text_off = text;
+				}
+				++ops;
+				in_literal = true;
+			}
+			if (prog) {
+				prog->text[text] = *f;
+				++(prog->ops[ops - 1].text_len);
+				++(prog->literal_len);
+			}
+			++text;
+			f += (*f == '%') ? 2 : 1;
+			continue;
+		}
+		in_literal = false;
+		const char *spec = f++;
+		struct strbuf_fmt_op op;
+		strbuf_memset(&op, 0x00, sizeof(op));
+		if (!strbuf_fmt_conversion(&f, &op)) {
+			return false;
+		}
+		if (op.conv == strbuf_fmt_double) {
+			op.text_off = text;
+			op.text_len = (size_t)(f - spec);
+			if (prog) {
+				strbuf_memcpy(prog->text + text, spec,
+					      op.text_len);
+				prog->text[text + op.text_len] = '\0';
+			}
+			text += op.text_len + 1;
+		}
+		if (prog) {
+			prog->ops[ops] = op;
+		}
+		++ops;
+	}
+	*num_ops = ops;
+	*text_len = text;
+	return true;
+}
+
+strbuf_fmt_s *strbuf_fmt_compile(const char *format)
+{
+	eembed_assert(format);
+	size_t num_ops = 0;
+	size_t text_len = 0;
+	if (!strbuf_fmt_parse(format, NULL, &num_ops, &text_len)) {
+		return NULL;
+	}
+	struct eembed_allocator *ea = eembed_global_allocator;
+	size_t ops_size = num_ops * sizeof(struct strbuf_fmt_op);
+	size_t size = sizeof(strbuf_fmt_s) + ops_size + text_len;
+	strbuf_fmt_s *prog = (strbuf_fmt_s *)ea->malloc(ea, size);
+	if (!prog) {
+		return NULL;
+	}
+	strbuf_memset(prog, 0x00, size);
+	prog->ea = ea;
+	prog->ops = (struct strbuf_fmt_op *)(prog + 1);
+	prog->text = ((char *)prog->ops) + ops_size;
+	strbuf_fmt_parse(format, prog, &num_ops, &text_len);
+	prog->num_ops = num_ops;
+	return prog;
+}
+
+void strbuf_fmt_destroy(strbuf_fmt_s *prog)
+{
+	if (prog) {
+		prog->ea->free(prog->ea, prog);
+	}
+}
+
+struct strbuf_fmt_arg {
+	uint64_t u;
+	bool neg;
+	const char *s;
+	size_t s_len;
+	long double d;
+};
+
+static void strbuf_fmt_signed(const struct strbuf_fmt_op *op, va_list *ap,
+			      struct strbuf_fmt_arg *arg)
+{
+	int64_t i;
+	switch (op->len) {
+	case strbuf_fmt_len_hh:
+		i = (signed char)va_arg(*ap, int);
+		break;
+	case strbuf_fmt_len_h:
+		i = (short)va_arg(*ap, int);
+		break;
+	case strbuf_fmt_len_l:
+		i = va_arg(*ap, long);
+		break;
+	case strbuf_fmt_len_ll:
+		i = va_arg(*ap, long long);
+		break;
+	case strbuf_fmt_len_z:
+		i = va_arg(*ap, ptrdiff_t);
+		break;
+	case strbuf_fmt_len_j:
+		i = va_arg(*ap, intmax_t);
+		break;
+	default:
+		i = va_arg(*ap, int);
+		break;
+	}
+	arg->neg = (i < 0);
+	arg->u = arg->neg ? (((uint64_t)0) - (uint64_t)i) : (uint64_t)i;
+}
+
+static void strbuf_fmt_unsigned(const struct strbuf_fmt_op *op, va_list *ap,
+				struct strbuf_fmt_arg *arg)
+{
+	switch (op->len) {
+	case strbuf_fmt_len_hh:
+		arg->u = (unsigned char)va_arg(*ap, unsigned);
+		break;
+	case strbuf_fmt_len_h:
+		arg->u = (unsigned short)va_arg(*ap, unsigned);
+		break;
+	case strbuf_fmt_len_l:
+		arg->u = va_arg(*ap, unsigned long);
+		break;
+	case strbuf_fmt_len_ll:
+		arg->u = va_arg(*ap, unsigned long long);
+		break;
+	case strbuf_fmt_len_z:
+		arg->u = va_arg(*ap, size_t);
+		break;
+	case strbuf_fmt_len_j:
+		arg->u = va_arg(*ap, uintmax_t);
+		break;
+	default:
+		arg->u = va_arg(*ap, unsigned);
+		break;
+	}
+	arg->neg = false;
+}
+
+/* fetches the argument, returns an upper bound of the bytes it needs */
+static size_t strbuf_fmt_arg(const struct strbuf_fmt_op *op, va_list *ap,
+			     struct strbuf_fmt_arg *arg)
+{
+	size_t bound = 0;
+	switch (op->conv) {
+	case strbuf_fmt_int:
+	case strbuf_fmt_uint:
+	case strbuf_fmt_hex:
+	case strbuf_fmt_hex_upper:
+		if (op->conv == strbuf_fmt_int) {
+			strbuf_fmt_signed(op, ap, arg);
+		} else {
+			strbuf_fmt_unsigned(op, ap, arg);
+		}
+		/* 20 digits, and a sign or a "0x" */
+		bound = 22;
+		if (op->precision > 20) {
+			bound = 2 + (size_t)op->precision;
+		}
+		break;
+	case strbuf_fmt_str:
+		arg->s = va_arg(*ap, const char *);
+		if (!arg->s) {
+			arg->s = "(null)";
+		}
+		if (op->precision >= 0) {
+			size_t max = (size_t)op->precision;
+			arg->s_len = strbuf_strnlen(arg->s, max);
+		} else {
+			arg->s_len = eembed_strlen(arg->s);
+		}
+		bound = arg->s_len;
+		break;
+	case strbuf_fmt_char:
+		arg->u = (unsigned char)va_arg(*ap, int);
+		bound = 1;
+		break;
+	case strbuf_fmt_double:
+		if (op->len == strbuf_fmt_len_L) {
+			arg->d = va_arg(*ap, long double);
+		} else {
+			arg->d = va_arg(*ap, double);
+		}
+		bound = 32 + (size_t)(op->precision < 0 ? 6 : op->precision);
+		if (op->spec == 'f' || op->spec == 'F') {
+			long double a = arg->d < 0 ? -arg->d : arg->d;
+			if (!(a < 1e17)) {
+				/* the integer digits of the largest value */
+				bound += LDBL_MAX_10_EXP;
+			}
+		}
+		break;
+	default:
+		break;
+	}
+	if (op->width > 0 && bound < (size_t)op->width) {
+		bound = (size_t)op->width;
+	}
+	return bound;
+}
+
+/* places "body" of "len" bytes in "width", returns the bytes written;
+   the pieces are mostly a few bytes, so short copies are done inline */
+static size_t strbuf_fmt_pad(char *out, const struct strbuf_fmt_op *op,
+			     const char *prefix, size_t prefix_len,
+			     size_t zeros, const char *body, size_t len)
+{
+	size_t used = prefix_len + zeros + len;
+	size_t pad = 0;
+	if (op->width > 0 && (size_t)op->width > used) {
+		pad = (size_t)op->width - used;
+	}
+	char *p = out;
+	if (pad && !(op->flags & Strbuf_fmt_left)) {
+		bool zero_pad = (op->flags & Strbuf_fmt_zero)
+		    && op->precision < 0 && op->conv != strbuf_fmt_str
+		    && op->conv != strbuf_fmt_char;
+		if (zero_pad) {
+			zeros += pad;
+		} else {
+			for (size_t i = 0; i < pad; ++i) {
+				*p++ = ' ';
+			}
+		}
+		pad = 0;
+	}
+	for (size_t i = 0; i < prefix_len; ++i) {
+		*p++ = prefix[i];
+	}
+	for (size_t i = 0; i < zeros; ++i) {
+		*p++ = '0';
+	}
+	if (len > 16) {
+		strbuf_memcpy(p, body, len);
+		p += len;
+	} else {
+		for (size_t i = 0; i < len; ++i) {
+			*p++ = body[i];
+		}
+	}
+	for (size_t i = 0; i < pad; ++i) {
+		*p++ = ' ';
+	}
+	return (size_t)(p - out);
+}
+
+static size_t strbuf_fmt_integer(char *out, const struct strbuf_fmt_op *op,
+				 const struct strbuf_fmt_arg *arg)
+{
+	char digits[24];
+	char *end = digits + sizeof(digits);
+	char *p = end;
+	if (op->conv == strbuf_fmt_hex || op->conv == strbuf_fmt_hex_upper) {
+		const char *hex = (op->conv == strbuf_fmt_hex)
+		    ? "0123456789abcdef" : "0123456789ABCDEF";
+		uint64_t u = arg->u;
+		do {
+			*--p = hex[u & 0x0F];
+			u >>= 4;
+		} while (u);
+	} else {
+		p = strbuf_u64_to_dec(end, arg->u);
+	}
+	size_t len = (size_t)(end - p);
+	if (op->precision == 0 && arg->u == 0) {
+		len = 0;
+	}
+	size_t zeros = 0;
+	if (op->precision > 0 && (size_t)op->precision > len) {
+		zeros = (size_t)op->precision - len;
+	}
+	char prefix[2];
+	size_t prefix_len = 0;
+	if (arg->neg) {
+		prefix[prefix_len++] = '-';
+	} else if (op->conv == strbuf_fmt_int) {
+		if (op->flags & Strbuf_fmt_plus) {
+			prefix[prefix_len++] = '+';
+		} else if (op->flags & Strbuf_fmt_space) {
+			prefix[prefix_len++] = ' ';
+		}
+	} else if ((op->flags & Strbuf_fmt_alt) && arg->u
+		   && op->conv != strbuf_fmt_uint) {
+		prefix[prefix_len++] = '0';
+		prefix[prefix_len++] = op->spec;
+	}
+	return strbuf_fmt_pad(out, op, prefix, prefix_len, zeros, p, len);
+}
+
+/* "%.Nf" for modest values without printf: when the scaled value is not
+   near a rounding tie, rounding it in double precision gives the same
+   digits as the exact binary value; returns 0 when unsure */
+static size_t strbuf_fmt_fixed(char *out, const struct strbuf_fmt_op *op,
+			       double d)
+{
+	static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+		1e7, 1e8, 1e9
+	};
+	static const uint32_t ipow10[] = { 1, 10, 100, 1000, 10000, 100000,
+		1000000, 10000000, 100000000, 1000000000
+	};
+	size_t prec = op->precision < 0 ? 6 : (size_t)op->precision;
+	if (prec > 9 || (op->flags & Strbuf_fmt_alt)) {
+		return 0;
+	}
+	uint64_t bits;
+	strbuf_memcpy(&bits, &d, sizeof(bits));
+	bool neg = (bits >> 63) ? true : false;
+	double scaled = (neg ? -d : d) * pow10[prec];
+	/* also false for NaN */
+	if (!(scaled < 1099511627776.0)) {
+		return 0;
+	}
+	uint64_t m = (uint64_t)scaled;
+	double frac = scaled - (double)m;
+	if (frac > 0.4995 && frac < 0.5005) {
+		return 0;
+	}
+	if (frac > 0.5) {
+		++m;
+	}
+
+	char digits[32];
+	char *end = digits + sizeof(digits);
+	char *p = end;
+	if (prec) {
+		p = strbuf_u64_to_dec(end, m % ipow10[prec]);
+		while ((size_t)(end - p) < prec) {
+			*--p = '0';
+		}
+		*--p = '.';
+	}
+	p = strbuf_u64_to_dec(p, m / ipow10[prec]);
+
+	char sign = neg ? '-' : (op->flags & Strbuf_fmt_plus) ? '+'
+	    : (op->flags & Strbuf_fmt_space) ? ' ' : '\0';
+	size_t sign_len = sign ? 1 : 0;
+	struct strbuf_fmt_op fixed = *op;
+	fixed.precision = -1;
+	return strbuf_fmt_pad(out, &fixed, &sign, sign_len, 0, p,
+			      (size_t)(end - p));
+}
+
+static size_t strbuf_fmt_double_to(char *out, size_t size,
+				   const strbuf_fmt_s *prog,
+				   const struct strbuf_fmt_op *op,
+				   const struct strbuf_fmt_arg *arg)
+{
+	const char *spec = prog->text + op->text_off;
+	int printed;
+	bool is_f = (op->spec == 'f' || op->spec == 'F');
+	if (is_f && op->len != strbuf_fmt_len_L) {
+		size_t len = strbuf_fmt_fixed(out, op, (double)arg->d);
+		if (len) {
+			return len;
+		}
+	}
+	if (op->len == strbuf_fmt_len_L) {
+		printed = strbuf_snprintf(out, size, spec, arg->d);
+	} else {
+		printed = strbuf_snprintf(out, size, spec, (double)arg->d);
+	}
+	if (printed >= 0) {
+		return (size_t)printed;
+	}
+	/* no vsnprintf: the value without width or precision */
+	char buf[3 + LDBL_MANT_DIG + (-LDBL_MIN_EXP)];
+	eembed_float_to_str(buf, sizeof(buf), arg->d);
+	size_t len = strbuf_strnlen(buf, sizeof(buf));
+	if (len > size - 1) {
+		len = size - 1;
+	}
+	strbuf_memcpy(out, buf, len);
+	return len;
+}
+
+const char *strbuf_append_fmt(strbuf_s *sb, const strbuf_fmt_s *prog, ...)
+{
+	eembed_assert(sb);
+	eembed_assert(prog);
+
+	/* first pass: the worst case size, so that we reserve once */
+	va_list ap;
+	va_start(ap, prog);
+	va_list sizing;
+	va_copy(sizing, ap);
+	size_t total = prog->literal_len;
+	for (size_t i = 0; i < prog->num_ops; ++i) {
+		const struct strbuf_fmt_op *op = prog->ops + i;
+		if (op->conv != strbuf_fmt_literal) {
+			struct strbuf_fmt_arg arg;
+			total += strbuf_fmt_arg(op, &sizing, &arg);
+		}
+	}
+	va_end(sizing);
+
+	char *out = strbuf_tail(sb, total);
+	if (!out) {
+		va_end(ap);
+		return NULL;
+	}
+
+	/* second pass: write straight into the buffer */
+	size_t pos = 0;
+	for (size_t i = 0; i < prog->num_ops; ++i) {
+		const struct strbuf_fmt_op *op = prog->ops + i;
+		struct strbuf_fmt_arg arg;
+		char c;
+		if (op->conv != strbuf_fmt_literal) {
+			strbuf_fmt_arg(op, &ap, &arg);
+		}
+		switch (op->conv) {
+		case strbuf_fmt_literal:
+			strbuf_memcpy(out + pos, prog->text + op->text_off,
+				      op->text_len);
+			pos += op->text_len;
+			break;
+		case strbuf_fmt_str:
+			pos += strbuf_fmt_pad(out + pos, op, "", 0, 0,
+					      arg.s, arg.s_len);
+			break;
+		case strbuf_fmt_char:
+			c = (char)arg.u;
+			pos += strbuf_fmt_pad(out + pos, op, "", 0, 0, &c, 1);
+			break;
+		case strbuf_fmt_double:
+			pos += strbuf_fmt_double_to(out + pos, total + 1 - pos,
+						    prog, op, &arg);
+			break;
+		default:
+			pos += strbuf_fmt_integer(out + pos, op, &arg);
+			break;
+		}
+	}
+	va_end(ap);
+
+	eembed_assert(pos <= total);
+	strbuf_tail_commit(sb, pos);
+	return strbuf_appended(sb);
+}
+
+/* number parsing: the range is clamped to the string, no NUL is needed */
+static const char *strbuf_parse_range(strbuf_s *sb, size_t offset,
+				      size_t *len)
+{
+	size_t s_len = strbuf_len(sb);
+	if (offset > s_len) {
+		offset = s_len;
+	}
+	if (*len > (s_len - offset)) {
+		*len = s_len - offset;
+	}
+	return strbuf_str(sb) + offset;
+}
+
+/* eight ASCII digits, first digit in the lowest byte, into their value */
+static uint64_t strbuf_parse_eight(const char *s, bool *all_digits)
+{
+	const unsigned char *u = (const unsigned char *)s;
+	uint64_t v = 0;
+	for (size_t i = 0; i < 8; ++i) {
+		v |= ((uint64_t)u[i]) << (8 * i);
+	}
+	const uint64_t highs = 0xF0F0F0F0F0F0F0F0ULL;
+	const uint64_t zeros = 0x3030303030303030ULL;
+	*all_digits = ((v & highs) == zeros)
+	    && (((v + 0x0606060606060606ULL) & highs) == zeros);
+	if (!*all_digits) {
+		return 0;
+	}
+	v -= zeros;
+	v = (v * 10) + (v >> 8);
+	v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+	     + (((v >> 16) & 0x000000FF000000FFULL)
+		* (1 + (10000ULL << 32)))) >> 32;
+	return v;
+}
+
+/* digits into *u, returns the count of digits, or 0 with *overflow set */
+static size_t strbuf_parse_digits(const char *s, size_t len, uint64_t *u,
+				  bool *overflow)
+{
+	size_t i = 0;
+	while (i < len && s[i] == '0') {
+		++i;
+	}
+	uint64_t v = 0;
+	size_t significant = 0;
+	bool all_digits = true;
+	/* two blocks of eight cannot overflow */
+	while ((i + 8) <= len && significant <= 8) {
+		uint64_t eight = strbuf_parse_eight(s + i, &all_digits);
+		if (!all_digits) {
+			break;
+		}
+		v = (v * 100000000) + eight;
+		significant += 8;
+		i += 8;
+	}
+	for (; i < len && s[i] >= '0' && s[i] <= '9'; ++i) {
+		uint64_t d = (uint64_t)(s[i] - '0');
+		if (v > ((UINT64_MAX - d) / 10)) {
+			*overflow = true;
+			return 0;
+		}
+		v = (v * 10) + d;
+	}
+	*u = v;
+	return i;
+}
+
+size_t strbuf_parse_uint64(strbuf_s *sb, size_t offset, size_t len,
+			   uint64_t *out)
+{
+	eembed_assert(sb);
+	eembed_assert(out);
+	const char *s = strbuf_parse_range(sb, offset, &len);
+	size_t pos = (len && s[0] == '+') ? 1 : 0;
+	uint64_t u = 0;
+	bool overflow = false;
+	size_t digits = strbuf_parse_digits(s + pos, len - pos, &u, &overflow);
+	if (!digits) {
+		return 0;
+	}
+	*out = u;
+	return pos + digits;
+}
+
+size_t strbuf_parse_int64(strbuf_s *sb, size_t offset, size_t len,
+			  int64_t *out)
+{
+	eembed_assert(sb);
+	eembed_assert(out);
+	const char *s = strbuf_parse_range(sb, offset, &len);
+	bool neg = (len && s[0] == '-');
+	size_t pos = (len && (neg || s[0] == '+')) ? 1 : 0;
+	uint64_t u = 0;
+	bool overflow = false;
+	size_t digits = strbuf_parse_digits(s + pos, len - pos, &u, &overflow);
+	if (!digits) {
+		return 0;
+	}
+	const uint64_t min_magnitude = ((uint64_t)INT64_MAX) + 1;
+	if (u > (neg ? min_magnitude : (uint64_t)INT64_MAX)) {
+		return 0;
+	}
+	if (neg) {
+		*out = (u == min_magnitude) ? INT64_MIN : -((int64_t)u);
+	} else {
+		*out = (int64_t)u;
+	}
+	return pos + digits;
+}
+
+static size_t strbuf_parse_word(const char *s, size_t len, const char *word)
+{
+	size_t i = 0;
+	for (; word[i]; ++i) {
+		if (i >= len || (s[i] | 0x20) != word[i]) {
+			return 0;
+		}
+	}
+	return i;
+}
+
+/* the exact, slow path: strtod on a NUL terminated copy, with the '.'
+   replaced by the decimal point of the current locale */
+static double strbuf_parse_double_slow(strbuf_s *sb, const char *s,
+				       size_t len, double approx)
+{
+#if EEMBED_HOSTED
+	const char *point = localeconv()->decimal_point;
+	size_t point_len = eembed_strlen(point);
+	size_t size = len + point_len + 1;
+	char stack_buf[80];
+	char *buf = stack_buf;
+	struct eembed_allocator *ea = sb->ea;
+	if (size > sizeof(stack_buf)) {
+		buf = (char *)ea->malloc(ea, size);
+		if (!buf) {
+			return approx;
+		}
+	}
+	size_t j = 0;
+	for (size_t i = 0; i < len; ++i) {
+		if (s[i] == '.') {
+			strbuf_memcpy(buf + j, point, point_len);
+			j += point_len;
+		} else {
+			buf[j++] = s[i];
+		}
+	}
+	buf[j] = '\0';
+	double d = strtod(buf, NULL);
+	if (buf != stack_buf) {
+		ea->free(ea, buf);
+	}
+	return d;
+#else
+	/* without strtod, the result may be off in the last place */
+	(void)sb;
+	(void)s;
+	(void)len;
+	return approx;
+#endif
+}
+
+size_t strbuf_parse_double(strbuf_s *sb, size_t offset, size_t len,
+			   double *out)
+{
+	eembed_assert(sb);
+	eembed_assert(out);
+	static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+		1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16,
+		1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	const char *s = strbuf_parse_range(sb, offset, &len);
+	bool neg = (len && s[0] == '-');
+	size_t pos = (len && (neg || s[0] == '+')) ? 1 : 0;
+
+	size_t word = strbuf_parse_word(s + pos, len - pos, "infinity");
+	if (!word) {
+		word = strbuf_parse_word(s + pos, len - pos, "inf");
+	}
+	double zero = 0.0;
+	if (word) {
+		*out = (neg ? -1.0 : 1.0) / zero;
+		return pos + word;
+	}
+	word = strbuf_parse_word(s + pos, len - pos, "nan");
+	if (word) {
+		*out = neg ? -(zero / zero) : (zero / zero);
+		return pos + word;
+	}
+
+	/* up to 19 significant digits are kept, the rest only scale */
+	uint64_t mantissa = 0;
+	size_t kept = 0;
+	int64_t exp10 = 0;
+	size_t digits = 0;
+	bool truncated = false;
+	for (int part = 0; part < 2; ++part) {
+		for (; pos < len && s[pos] >= '0' && s[pos] <= '9'; ++pos) {
+			++digits;
+			if (kept < 19) {
+				mantissa = (mantissa * 10) + (s[pos] - '0');
+				kept += mantissa ? 1 : 0;
+				exp10 -= part;
+			} else {
+				truncated |= (s[pos] != '0');
+				exp10 += 1 - part;
+			}
+		}
+		if (part == 0 && pos < len && s[pos] == '.') {
+			++pos;
+		} else {
+			break;
+		}
+	}
+	if (!digits) {
+		return 0;
+	}
+	size_t end = pos;
+	if (pos < len && (s[pos] == 'e' || s[pos] == 'E')) {
+		size_t epos = pos + 1;
+		bool eneg = (epos < len && s[epos] == '-');
+		if (epos < len && (eneg || s[epos] == '+')) {
+			++epos;
+		}
+		int64_t e = 0;
+		size_t edigits = 0;
+		for (; epos < len && s[epos] >= '0' && s[epos] <= '9'; ++epos) {
+			if (e < 100000) {
+				e = (e * 10) + (s[epos] - '0');
+			}
+			++edigits;
+		}
+		if (edigits) {
+			exp10 += eneg ? -e : e;
+			end = epos;
+		}
+	}
+
+	/* Clinger's fast path: both exact, so one correctly rounded op */
+	double d = (double)mantissa;
+	bool exact = !truncated && mantissa <= 9007199254740992ULL;
+	if (exact && exp10 >= 0 && exp10 <= 22) {
+		d *= pow10[exp10];
+	} else if (exact && exp10 < 0 && exp10 >= -22) {
+		d /= pow10[-exp10];
+	} else if (mantissa == 0) {
+		d = 0.0;
+	} else {
+		long double approx = (long double)mantissa;
+		for (int64_t e = exp10; e > 0 && approx < LDBL_MAX; --e) {
+			approx *= 10;
+		}
+		for (int64_t e = exp10; e < 0 && approx > 0; ++e) {
+			approx /= 10;
+		}
+		d = (double)(neg ? -approx : approx);
+		*out = strbuf_parse_double_slow(sb, s, end, d);
+		return end;
+	}
+	*out = neg ? -d : d;
+	return end;
+}
+
+/* glob patterns: split at each '*' in to segments of fixed length, which
+   are matched in order, each as far left as it will go; as only a '*' can
+   match a varying length, a segment is never tried again once placed */
+enum strbuf_glob_op {
+	strbuf_glob_byte = 0,
+	strbuf_glob_any = 1,
+	/* and from here, the index of a class plus this */
+	strbuf_glob_class = 2
+};
+
+struct strbuf_glob_seg {
+	size_t atom;
+	size_t len;
+	bool literal;
+};
+
+struct strbuf_glob {
+	struct eembed_allocator *ea;
+	size_t num_segs;
+	size_t min_len;
+	bool star_first;
+	bool star_last;
+	/* the bytes which any subject must contain, one bit each */
+	uint8_t required[32];
+	struct strbuf_glob_seg *segs;
+	uint16_t *ops;
+	char *text;
+	uint8_t (*classes)[32];
+};
+
+static void strbuf_glob_bit_set(uint8_t *bits, unsigned char c)
+{
+	bits[c >> 3] |= (uint8_t)(1U << (c & 7));
+}
+
+static bool strbuf_glob_bit_get(const uint8_t *bits, unsigned char c)
+{
+	return (bits[c >> 3] >> (c & 7)) & 1;
+}
+
+/* "p" is just after the '['; returns just after the ']', or NULL */
+static const char *strbuf_glob_class_parse(const char *p, uint8_t *bits)
+{
+	uint8_t set[32];
+	strbuf_memset(set, 0x00, sizeof(set));
+	bool negate = (*p == '!' || *p == '^');
+	if (negate) {
+		++p;
+	}
+	bool first = true;
+	while (*p && (first || *p != ']')) {
+		first = false;
+		unsigned char lo = (unsigned char)*p++;
+		if (lo == '\\') {
+			if (!*p) {
+				return NULL;
+			}
+			lo = (unsigned char)*p++;
+		}
+		unsigned char hi = lo;
+		if (p[0] == '-' && p[1] && p[1] != ']') {
+			p += 1;
+			hi = (unsigned char)*p++;
+			if (hi == '\\') {
+				if (!*p) {
+					return NULL;
+				}
+				hi = (unsigned char)*p++;
+			}
+		}
+		for (unsigned c = lo; c <= hi; ++c) {
+			strbuf_glob_bit_set(set, (unsigned char)c);
+		}
+	}
+	if (*p != ']') {
+		return NULL;
+	}
+	if (bits) {
+		for (size_t i = 0; i < 32; ++i) {
+			bits[i] = negate ? (uint8_t)~set[i] : set[i];
+		}
+	}
+	return p + 1;
+}
+
+/* run once with "g" NULL to count, and again to fill */
+static bool strbuf_glob_parse(const char *p, strbuf_glob_s *g,
+			      size_t *num_atoms, size_t *num_segs,
+			      size_t *num_classes)
+{
+	size_t atoms = 0;
+	size_t segs = 0;
+	size_t classes = 0;
+	bool in_seg = false;
+	bool star_last = false;
+	if (g) {
+		g->star_first = (*p == '*');
+	}
+	while (*p) {
+		if (*p == '*') {
+			in_seg = false;
+			star_last = true;
+			++p;
+			continue;
+		}
+		star_last = false;
+		if (!in_seg) {
+			if (g) {
+				g->segs[segs].atom = atoms;
+				g->segs[segs].literal = true;
+			}
+			++segs;
+			in_seg = true;
+		}
+		uint16_t op = strbuf_glob_byte;
+		char c = *p;
+		if (*p == '?') {
+			op = strbuf_glob_any;
+			++p;
+		} else if (*p == '[') {
+			uint8_t *bits = g ? g->classes[classes] : NULL;
+			p = strbuf_glob_class_parse(p + 1, bits);
+			if (!p || classes >= (UINT16_MAX - strbuf_glob_class)) {
+				return false;
+			}
+			op = (uint16_t)(strbuf_glob_class + classes);
+			++classes;
+		} else {
+			if (*p == '\\') {
+				++p;
+				if (!*p) {
+					return false;
+				}
+			}
+			c = *p++;
+		}
+		if (g) {
+			struct strbuf_glob_seg *seg = g->segs + (segs - 1);
+			g->ops[atoms] = op;
+			g->text[atoms] = (op == strbuf_glob_byte) ? c : '\0';
+			if (op == strbuf_glob_byte) {
+				unsigned char u = (unsigned char)c;
+				strbuf_glob_bit_set(g->required, u);
+			} else {
+				seg->literal = false;
+			}
+			++seg->len;
+			++g->min_len;
+		}
+		++atoms;
+	}
+	if (!segs && !star_last) {
+		/* the empty pattern, which matches only the empty string */
+		if (g) {
+			g->segs[0].atom = 0;
+			g->segs[0].literal = true;
+		}
+		segs = 1;
+	}
+	if (g) {
+		g->star_last = star_last;
+		g->num_segs = segs;
+	}
+	*num_atoms = atoms;
+	*num_segs = segs;
+	*num_classes = classes;
+	return true;
+}
+
+strbuf_glob_s *strbuf_glob_compile(const char *pattern)
+{
+	eembed_assert(pattern);
+	size_t num_atoms = 0;
+	size_t num_segs = 0;
+	size_t num_classes = 0;
+	if (!strbuf_glob_parse(pattern, NULL, &num_atoms, &num_segs,
+			       &num_classes)) {
+		return NULL;
+	}
+	struct eembed_allocator *ea = eembed_global_allocator;
+	size_t classes_size = num_classes * 32;
+	size_t segs_size = num_segs * sizeof(struct strbuf_glob_seg);
+	size_t ops_size = num_atoms * sizeof(uint16_t);
+	size_t size = sizeof(strbuf_glob_s) + classes_size + segs_size
+	    + ops_size + num_atoms;
+	strbuf_glob_s *g = (strbuf_glob_s *)ea->malloc(ea, size);
+	if (!g) {
+		return NULL;
+	}
+	strbuf_memset(g, 0x00, size);
+	g->ea = ea;
+	/* largest alignment first */
+	unsigned char *mem = (unsigned char *)(g + 1);
+	g->segs = (struct strbuf_glob_seg *)mem;
+	mem += segs_size;
+	g->classes = (uint8_t (*)[32])mem;
+	mem += classes_size;
+	g->ops = (uint16_t *)mem;
+	mem += ops_size;
+	g->text = (char *)mem;
+	strbuf_glob_parse(pattern, g, &num_atoms, &num_segs, &num_classes);
+	return g;
+}
+
+void strbuf_glob_destroy(strbuf_glob_s *g)
+{
+	if (g) {
+		g->ea->free(g->ea, g);
+	}
+}
+
+static bool strbuf_glob_seg_at(const strbuf_glob_s *g,
+			       const struct strbuf_glob_seg *seg,
+			       const char *s)
+{
+	if (seg->literal) {
+		return eembed_memcmp(s, g->text + seg->atom, seg->len) == 0;
+	}
+	for (size_t i = 0; i < seg->len; ++i) {
+		uint16_t op = g->ops[seg->atom + i];
+		unsigned char c = (unsigned char)s[i];
+		if (op == strbuf_glob_byte) {
+			if (s[i] != g->text[seg->atom + i]) {
+				return false;
+			}
+		} else if (op != strbuf_glob_any) {
+			size_t k = op - strbuf_glob_class;
+			if (!strbuf_glob_bit_get(g->classes[k], c)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/* the leftmost place in [from, to) where the segment fits, or SIZE_MAX */
+static size_t strbuf_glob_seg_find(const strbuf_glob_s *g,
+				   const struct strbuf_glob_seg *seg,
+				   const char *s, size_t from, size_t to)
+{
+	if ((to - from) < seg->len) {
+		return SIZE_MAX;
+	}
+	size_t last = to - seg->len;
+	bool lead = seg->len && g->ops[seg->atom] == strbuf_glob_byte;
+	for (size_t pos = from; pos <= last; ++pos) {
+		if (lead) {
+			size_t n = 1 + last - pos;
+			unsigned char c = (unsigned char)g->text[seg->atom];
+			const char *p;
+			p = (const char *)strbuf_memchr(s + pos, c, n);
+			if (!p) {
+				return SIZE_MAX;
+			}
+			pos = (size_t)(p - s);
+		}
+		if (strbuf_glob_seg_at(g, seg, s + pos)) {
+			return pos;
+		}
+	}
+	return SIZE_MAX;
+}
+
+int strbuf_glob_match_str(const strbuf_glob_s *g, const char *s, size_t len)
+{
+	eembed_assert(g);
+	eembed_assert(s || !len);
+	if (len < g->min_len) {
+		return 0;
+	}
+	const struct strbuf_glob_seg *segs = g->segs;
+	size_t first = 0;
+	size_t last = g->num_segs;
+	size_t pos = 0;
+	size_t end = len;
+	/* the anchored ends first, as they need no searching */
+	if (!g->star_first) {
+		if (!g->star_last && last == 1) {
+			return len == segs[0].len
+			    && strbuf_glob_seg_at(g, segs, s);
+		}
+		if (!strbuf_glob_seg_at(g, segs, s)) {
+			return 0;
+		}
+		pos = segs[0].len;
+		first = 1;
+	}
+	if (!g->star_last && last > first) {
+		const struct strbuf_glob_seg *seg = segs + (last - 1);
+		if (!strbuf_glob_seg_at(g, seg, s + len - seg->len)) {
+			return 0;
+		}
+		end = len - seg->len;
+		--last;
+	}
+	for (size_t i = first; i < last; ++i) {
+		size_t at = strbuf_glob_seg_find(g, segs + i, s, pos, end);
+		if (at == SIZE_MAX) {
+			return 0;
+		}
+		pos = at + segs[i].len;
+	}
+	return 1;
+}
+
+int strbuf_glob_match(const strbuf_glob_s *g, strbuf_s *sb)
+{
+	eembed_assert(sb);
+	const char *s = strbuf_str(sb);
+	return strbuf_glob_match_str(g, s, strbuf_len(sb));
+}
+
+struct strbuf_glob_set {
+	struct eembed_allocator *ea;
+	size_t num;
+	strbuf_glob_s **globs;
+};
+
+strbuf_glob_set_s *strbuf_glob_set_compile(const char *const *patterns,
+					   size_t num)
+{
+	eembed_assert(patterns || !num);
+	struct eembed_allocator *ea = eembed_global_allocator;
+	size_t size = sizeof(strbuf_glob_set_s) + (num * sizeof(void *));
+	strbuf_glob_set_s *set = (strbuf_glob_set_s *)ea->malloc(ea, size);
+	if (!set) {
+		return NULL;
+	}
+	strbuf_memset(set, 0x00, size);
+	set->ea = ea;
+	set->globs = (strbuf_glob_s **)(set + 1);
+	for (size_t i = 0; i < num; ++i) {
+		set->globs[i] = strbuf_glob_compile(patterns[i]);
+		if (!set->globs[i]) {
+			strbuf_glob_set_destroy(set);
+			return NULL;
+		}
+		++set->num;
+	}
+	return set;
+}
+
+void strbuf_glob_set_destroy(strbuf_glob_set_s *set)
+{
+	if (!set) {
+		return;
+	}
+	for (size_t i = 0; i < set->num; ++i) {
+		strbuf_glob_destroy(set->globs[i]);
+	}
+	set->ea->free(set->ea, set);
+}
+
+static bool strbuf_glob_has_required(const strbuf_glob_s *g,
+				     const uint8_t *present)
+{
+	for (size_t i = 0; i < 32; ++i) {
+		if (g->required[i] & ~present[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t strbuf_glob_set_match(const strbuf_glob_set_s *set, strbuf_s *sb,
+			     size_t *matches, size_t max)
+{
+	eembed_assert(set);
+	eembed_assert(sb);
+	eembed_assert(matches || !max);
+	const char *s = strbuf_str(sb);
+	size_t len = strbuf_len(sb);
+
+	/* one pass notes which bytes occur, and a pattern which needs a
+	   byte which does not occur, or is longer, is not run at all */
+	uint8_t present[32];
+	strbuf_memset(present, 0x00, sizeof(present));
+	for (size_t i = 0; i < len; ++i) {
+		strbuf_glob_bit_set(present, (unsigned char)s[i]);
+	}
+
+	size_t found = 0;
+	for (size_t i = 0; i < set->num; ++i) {
+		const strbuf_glob_s *g = set->globs[i];
+		if (len < g->min_len || !strbuf_glob_has_required(g, present)) {
+			continue;
+		}
+		if (strbuf_glob_match_str(g, s, len)) {
+			if (found < max) {
+				matches[found] = i;
+			}
+			++found;
+		}
+	}
+	return found;
+}
+
+/* redaction: an Aho-Corasick automaton, built out in to a full table of
+   transitions so that scanning takes one lookup per byte; bytes which are
+   in no pattern share a column, which keeps the table small */
+struct strbuf_redactor {
+	struct eembed_allocator *ea;
+	size_t num_classes;
+	unsigned flags;
+	uint16_t classes[256];
+	uint32_t *next;
+	/* the longest pattern ending at each state, or zero */
+	uint32_t *out;
+};
+
+static unsigned char strbuf_redact_fold(unsigned char c, unsigned flags)
+{
+	if ((flags & STRBUF_REDACT_ICASE) && c >= 'A' && c <= 'Z') {
+		return (unsigned char)(c + ('a' - 'A'));
+	}
+	return c;
+}
+
+/* fills "next" with the trie and "out" with the pattern lengths */
+static void strbuf_redactor_trie(strbuf_redactor_s *r,
+				   const char *const *patterns, size_t num)
+{
+	size_t nc = r->num_classes;
+	size_t states = 1;
+	for (size_t i = 0; i < num; ++i) {
+		size_t state = 0;
+		const unsigned char *p = (const unsigned char *)patterns[i];
+		size_t len = eembed_strlen(patterns[i]);
+		for (size_t j = 0; j < len; ++j) {
+			size_t at = (state * nc) + r->classes[p[j]];
+			uint32_t *to = r->next + at;
+			if (!*to) {
+				*to = (uint32_t)states++;
+			}
+			state = *to;
+		}
+		if (r->out[state] < len) {
+			r->out[state] = (uint32_t)len;
+		}
+	}
+}
+
+/* in breadth first order, each missing transition is that of the
+   longest proper suffix which is also in the trie */
+static void strbuf_redactor_links(strbuf_redactor_s *r, uint32_t *fail,
+				  uint32_t *queue)
+{
+	size_t nc = r->num_classes;
+	size_t head = 0;
+	size_t tail = 0;
+	for (size_t c = 0; c < nc; ++c) {
+		uint32_t t = r->next[c];
+		if (t) {
+			fail[t] = 0;
+			queue[tail++] = t;
+		}
+	}
+	while (head < tail) {
+		uint32_t s = queue[head++];
+		for (size_t c = 0; c < nc; ++c) {
+			uint32_t *to = r->next + (s * nc) + c;
+			uint32_t via = r->next[(fail[s] * nc) + c];
+			if (!*to) {
+				*to = via;
+				continue;
+			}
+			uint32_t t = *to;
+			fail[t] = via;
+			if (r->out[t] < r->out[via]) {
+				r->out[t] = r->out[via];
+			}
+			queue[tail++] = t;
+		}
+	}
+}
+
+strbuf_redactor_s *strbuf_redactor_new(const char *const *patterns,
+				       size_t num, unsigned flags)
+{
+	eembed_assert(patterns || !num);
+	struct eembed_allocator *ea = eembed_global_allocator;
+	size_t max_states = 1;
+	uint16_t classes[256];
+	strbuf_memset(classes, 0x00, sizeof(classes));
+	size_t nc = 1;
+	for (size_t i = 0; i < num; ++i) {
+		size_t len = eembed_strlen(patterns[i]);
+		if (!len || len > UINT32_MAX) {
+			return NULL;
+		}
+		max_states += len;
+		const unsigned char *p = (const unsigned char *)patterns[i];
+		for (size_t j = 0; j < len; ++j) {
+			unsigned char c = strbuf_redact_fold(p[j], flags);
+			if (!classes[c]) {
+				classes[c] = (uint16_t)nc++;
+			}
+		}
+	}
+	if (max_states > (UINT32_MAX / nc)
+	    || max_states > (SIZE_MAX / (nc * 2 * sizeof(uint32_t)))) {
+		return NULL;
+	}
+
+	size_t table_size = max_states * nc * sizeof(uint32_t);
+	size_t out_size = max_states * sizeof(uint32_t);
+	size_t size = sizeof(strbuf_redactor_s) + table_size + out_size;
+	strbuf_redactor_s *r = (strbuf_redactor_s *)ea->malloc(ea, size);
+	uint32_t *tmp = (uint32_t *)ea->malloc(ea, 2 * out_size);
+	if (!r || !tmp) {
+		if (r) {
+			ea->free(ea, r);
+		}
+		if (tmp) {
+			ea->free(ea, tmp);
+		}
+		return NULL;
+	}
+	strbuf_memset(r, 0x00, size);
+	r->ea = ea;
+	r->flags = flags;
+	r->num_classes = nc;
+	for (size_t c = 0; c < 256; ++c) {
+		r->classes[c] = classes[strbuf_redact_fold(c, flags)];
+	}
+	r->next = (uint32_t *)(r + 1);
+	r->out = r->next + (max_states * nc);
+
+	strbuf_redactor_trie(r, patterns, num);
+	strbuf_memset(tmp, 0x00, 2 * out_size);
+	strbuf_redactor_links(r, tmp, tmp + max_states);
+	ea->free(ea, tmp);
+	return r;
+}
+
+void strbuf_redactor_destroy(strbuf_redactor_s *r)
+{
+	if (r) {
+		r->ea->free(r->ea, r);
+	}
+}
+
+static bool strbuf_redact_token_end(unsigned char c)
+{
+	return strbuf_isspace(c) || c == '"' || c == '\'' || c == ','
+	    || c == ';' || c == '&';
+}
+
+const char *strbuf_redact(const strbuf_redactor_s *r, strbuf_s *sb,
+			  char mask)
+{
+	eembed_assert(r);
+	eembed_assert(sb);
+	if (!strbuf_own(sb)) {
+		return NULL;
+	}
+	strbuf_gap_close(sb);
+	char *s = sb->buf + sb->start;
+	size_t len = sb->end - sb->start;
+	size_t nc = r->num_classes;
+	const uint32_t *next = r->next;
+	/* the last run masked is [masked_from, masked_to) */
+	size_t masked_from = 0;
+	size_t masked_to = 0;
+	uint32_t state = 0;
+	for (size_t i = 0; i < len; ++i) {
+		unsigned char c = (unsigned char)s[i];
+		state = next[(state * nc) + r->classes[c]];
+		size_t m = r->out[state];
+		if (!m) {
+			continue;
+		}
+		size_t from = i + 1 - m;
+		size_t run_from = from;
+		if (masked_to && from >= masked_from && from <= masked_to) {
+			/* a longer match may begin before the run, not in it */
+			run_from = masked_from;
+			from = masked_to;
+		}
+		if (r->flags & STRBUF_REDACT_TOKEN) {
+			while ((i + 1) < len
+			       && !strbuf_redact_token_end((unsigned char)
+							   s[i + 1])) {
+				++i;
+			}
+			state = 0;
+		}
+		strbuf_memset(s + from, mask, 1 + i - from);
+		masked_from = run_from;
+		masked_to = i + 1;
+	}
+	if (masked_to) {
+		strbuf_changed(sb);
+	}
+	return strbuf_str(sb);
+}
+
+enum strbuf_expand_kind {
+	strbuf_expand_literal,
+	strbuf_expand_var,
+	strbuf_expand_default
+};
+
+/* for a variable, "off" and "len" are of the name */
+struct strbuf_expand_op {
+	size_t off;
+	size_t len;
+	size_t def_off;
+	size_t def_len;
+	enum strbuf_expand_kind kind;
+};
+
+struct strbuf_template {
+	struct eembed_allocator *ea;
+	size_t num_ops;
+	size_t literal_len;
+	struct strbuf_expand_op *ops;
+	char *text;
+};
+
+/* the op starting at "pos", returning where the next one starts; a '$'
+   which does not start "$$" or a closed "${" is literal */
+static size_t strbuf_expand_parse(const char *t, size_t len, size_t pos,
+				  struct strbuf_expand_op *op)
+{
+	op->kind = strbuf_expand_literal;
+	op->off = pos;
+	op->len = 1;
+	if (t[pos] != '$') {
+		const char *p = (const char *)strbuf_memchr(t + pos, '$',
+							    len - pos);
+		size_t end = p ? (size_t)(p - t) : len;
+		op->len = end - pos;
+		return end;
+	}
+	if ((pos + 1) < len && t[pos + 1] == '$') {
+		return pos + 2;
+	}
+	if ((pos + 2) > len || t[pos + 1] != '{') {
+		return pos + 1;
+	}
+	size_t name = pos + 2;
+	const char *close = (const char *)strbuf_memchr(t + name, '}',
+							len - name);
+	if (!close) {
+		return pos + 1;
+	}
+	size_t end = (size_t)(close - t);
+	op->kind = strbuf_expand_var;
+	op->off = name;
+	op->len = end - name;
+	for (size_t i = name; (i + 1) < end; ++i) {
+		if (t[i] == ':' && t[i + 1] == '-') {
+			op->kind = strbuf_expand_default;
+			op->len = i - name;
+			op->def_off = i + 2;
+			op->def_len = end - (i + 2);
+			break;
+		}
+	}
+	return end + 1;
+}
+
+/* counts in "added" what was appended, for strbuf_expand_undo */
+static bool strbuf_expand_put(strbuf_s *sb, const char *s, size_t len,
+			      size_t *added)
+{
+	if (!len) {
+		return true;
+	}
+	char *tail = strbuf_tail(sb, len);
+	if (!tail) {
+		return false;
+	}
+	strbuf_memcpy(tail, s, len);
+	strbuf_tail_commit(sb, len);
+	*added += len;
+	return true;
+}
+
+static bool strbuf_expand_op(strbuf_s *sb, const char *t,
+			     const struct strbuf_expand_op *op,
+			     strbuf_expand_lookup_fn lookup, void *ctx,
+			     size_t *added)
+{
+	if (op->kind == strbuf_expand_literal) {
+		return strbuf_expand_put(sb, t + op->off, op->len, added);
+	}
+	size_t value_len = 0;
+	const char *value = NULL;
+	if (lookup) {
+		value = lookup(ctx, t + op->off, op->len, &value_len);
+	}
+	if (!value) {
+		value_len = 0;
+	}
+	if (!value_len && op->kind == strbuf_expand_default) {
+		value = t + op->def_off;
+		value_len = op->def_len;
+	}
+	return strbuf_expand_put(sb, value, value_len, added);
+}
+
+/* a failed expansion takes back what it appended, so that the string is
+   as it was; in ring mode, what was pushed out of the ring stays lost */
+static const char *strbuf_expand_undo(strbuf_s *sb, size_t added)
+{
+	size_t len = strbuf_len(sb);
+	if (added > len) {
+		added = len;
+	}
+	strbuf_erase(sb, len - added, added);
+	return NULL;
+}
+
+const char *strbuf_expand(strbuf_s *sb, const char *tmpl, size_t tmpl_len,
+			  strbuf_expand_lookup_fn lookup, void *ctx)
+{
+	eembed_assert(sb);
+	eembed_assert(tmpl || !tmpl_len);
+	/* at least the template's size, so that most renders grow once; a
+	   ring does not grow, and reserving would only push out more */
+	if (!strbuf_ring_mode(sb) && !strbuf_tail(sb, tmpl_len)) {
+		return NULL;
+	}
+	size_t added = 0;
+	size_t pos = 0;
+	while (pos < tmpl_len) {
+		struct strbuf_expand_op op;
+		pos = strbuf_expand_parse(tmpl, tmpl_len, pos, &op);
+		if (!strbuf_expand_op(sb, tmpl, &op, lookup, ctx, &added)) {
+			return strbuf_expand_undo(sb, added);
+		}
+	}
+	return strbuf_appended(sb);
+}
+
+strbuf_template_s *strbuf_template_compile(const char *tmpl, size_t tmpl_len)
+{
+	eembed_assert(tmpl || !tmpl_len);
+	size_t num_ops = 0;
+	struct strbuf_expand_op op;
+	for (size_t pos = 0; pos < tmpl_len; ++num_ops) {
+		pos = strbuf_expand_parse(tmpl, tmpl_len, pos, &op);
+	}
+
+	struct eembed_allocator *ea = eembed_global_allocator;
+	size_t ops_size = num_ops * sizeof(struct strbuf_expand_op);
+	if (ops_size / sizeof(struct strbuf_expand_op) != num_ops) {
+		return NULL;
+	}
+	size_t size = sizeof(strbuf_template_s) + ops_size + tmpl_len + 1;
+	if (size < ops_size) {
+		return NULL;
+	}
+	strbuf_template_s *t = (strbuf_template_s *)ea->malloc(ea, size);
+	if (!t) {
+		return NULL;
+	}
+	strbuf_memset(t, 0x00, sizeof(strbuf_template_s));
+	t->ea = ea;
+	t->ops = (struct strbuf_expand_op *)(t + 1);
+	t->text = ((char *)t->ops) + ops_size;
+	if (tmpl_len) {
+		strbuf_memcpy(t->text, tmpl, tmpl_len);
+	}
+	t->text[tmpl_len] = '\0';
+
+	size_t pos = 0;
+	for (size_t i = 0; i < num_ops; ++i) {
+		pos = strbuf_expand_parse(t->text, tmpl_len, pos, t->ops + i);
+		if (t->ops[i].kind == strbuf_expand_literal) {
+			t->literal_len += t->ops[i].len;
+		}
+	}
+	t->num_ops = num_ops;
+	return t;
+}
+
+void strbuf_template_destroy(strbuf_template_s *t)
+{
+	if (t) {
+		t->ea->free(t->ea, t);
+	}
+}
+
+const char *strbuf_template_expand(strbuf_s *sb, const strbuf_template_s *t,
+				   strbuf_expand_lookup_fn lookup, void *ctx)
+{
+	eembed_assert(sb);
+	eembed_assert(t);
+	if (!strbuf_ring_mode(sb) && !strbuf_tail(sb, t->literal_len)) {
+		return NULL;
+	}
+	size_t added = 0;
+	for (size_t i = 0; i < t->num_ops; ++i) {
+		const struct strbuf_expand_op *op = t->ops + i;
+		if (!strbuf_expand_op(sb, t->text, op, lookup, ctx, &added)) {
+			return strbuf_expand_undo(sb, added);
+		}
+	}
+	return strbuf_appended(sb);
+}
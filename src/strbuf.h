@@ -5,10 +5,15 @@
 #ifndef STRBUF_H
 #define STRBUF_H 1
 
+#include <stdalign.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct strbuf;
 typedef struct strbuf strbuf_s;
 
@@ -18,13 +23,61 @@ strbuf_s *strbuf_new_custom(struct eembed_allocator *allocator,
 			    unsigned char *mem_buf, size_t buf_size,
 			    const char *str, size_t str_len);
 
+/* if "on", a buffer the strbuf owns is grown with the allocator's realloc
+   rather than with malloc, copy and free; for an allocator whose realloc
+   may avoid the copy, as strbuf_mmap_allocator's does. Clones inherit it */
+void strbuf_grow_by_realloc(strbuf_s *sb, int on);
+
 strbuf_s *strbuf_new(const char *str, size_t strlen);
 
 strbuf_s *strbuf_no_grow(unsigned char *initial_buf, size_t initial_buf_size,
 			 const char *str, size_t str_len);
 
+/* a compile-time upper bound of strbuf_struct_size() */
+#define STRBUF_STRUCT_SIZE_MAX 128
+
+/* the bytes a strbuf_no_grow buffer needs for a string of "n" chars,
+   rounded so that the struct at the end of the buffer is aligned */
+#define STRBUF_NO_GROW_SIZE(n) \
+	((((size_t)(n)) + 1 + STRBUF_STRUCT_SIZE_MAX + 15) & ~((size_t)15))
+
+/* in a function, declares "name", an empty strbuf_s * with room for "n"
+   chars in a buffer on the stack; it never grows or allocates */
+#define STRBUF_STATIC(name, n) \
+	alignas(max_align_t) unsigned char name##_mem[STRBUF_NO_GROW_SIZE(n)]; \
+	strbuf_s *name = strbuf_no_grow(name##_mem, sizeof(name##_mem), NULL, 0)
+
+/* the most chars an int or uint append may add */
+#define STRBUF_INT64_MAX_CHARS 20
+#define STRBUF_UINT64_MAX_CHARS 20
+
+/* keep one static strbuf_sizehint_s per call site; not thread-safe */
+#define STRBUF_SIZEHINT_BUCKETS (8 * sizeof(size_t))
+struct strbuf_sizehint {
+	size_t max_size;
+	uint16_t total;
+	uint16_t counts[STRBUF_SIZEHINT_BUCKETS];
+};
+typedef struct strbuf_sizehint strbuf_sizehint_s;
+
+#define STRBUF_SIZEHINT_INIT(max_size) { max_size, 0, { 0 } }
+
+strbuf_s *strbuf_new_hinted(strbuf_sizehint_s *hint, const char *str,
+			    size_t str_len);
+
+/* a fixed size buffer which keeps the most recent bytes appended: appends
+   never fail for lack of room, instead evicting the oldest bytes, and they
+   return the oldest contiguous part of the string rather than all of it;
+   strbuf_append keeps all but one byte of the room, while appends which
+   format in place may leave up to their own length unused; other changes
+   work on the unwrapped string and may fail when full */
+strbuf_s *strbuf_ring(unsigned char *mem_buf, size_t buf_size);
+
 void strbuf_destroy(strbuf_s *sb);
 
+/* an O(1) copy which shares the buffer until either side is modified */
+strbuf_s *strbuf_clone(strbuf_s *sb);
+
 const char *strbuf_str(strbuf_s *sb);
 
 const char *strbuf_set(strbuf_s *sb, const char *str, size_t str_len);
@@ -32,14 +85,147 @@ const char *strbuf_set(strbuf_s *sb, const char *str, size_t str_len);
 size_t strbuf_len(strbuf_s *sb);
 size_t strbuf_avail(strbuf_s *sb);
 
+/* the string as one or two parts, without moving anything; the second
+   part follows the first, and may be empty */
+void strbuf_spans(strbuf_s *sb, const char **first, size_t *first_len,
+		  const char **second, size_t *second_len);
+
+/* makes the string contiguous, as strbuf_str does whenever it must */
+const char *strbuf_linearize(strbuf_s *sb);
+
 char strbuf_char(strbuf_s *sb, size_t idx);
 
+int strbuf_utf8_valid(strbuf_s *sb);
+size_t strbuf_utf8_len(strbuf_s *sb);
+size_t strbuf_utf8_offset(strbuf_s *sb, size_t cp_index);
+
+/* a fast non-cryptographic hash of the contents, cached until changed */
+uint64_t strbuf_hash(strbuf_s *sb);
+int strbuf_eq(strbuf_s *a, strbuf_s *b);
+
+/* byte-wise, length aware; returns <0, 0, >0 like memcmp */
+int strbuf_cmp(strbuf_s *sb, const char *str, size_t len);
+int strbuf_starts_with(strbuf_s *sb, const char *prefix, size_t len);
+int strbuf_ends_with(strbuf_s *sb, const char *suffix, size_t len);
+size_t strbuf_common_prefix_len(strbuf_s *sb, const char *str, size_t len);
+
+/* a table of canonical, immutable, reference counted strings: equal bytes
+   intern to the same strbuf_s pointer, which must not be destroyed, only
+   released; functions which would modify it return NULL instead. The
+   table may be shared between threads */
+struct strbuf_intern;
+typedef struct strbuf_intern strbuf_intern_s;
+
+/* if allocator is NULL, the eembed_global_allocator is used */
+strbuf_intern_s *strbuf_intern_new(struct eembed_allocator *allocator,
+				   size_t num_shards);
+void strbuf_intern_destroy(strbuf_intern_s *table);
+
+strbuf_s *strbuf_intern(strbuf_intern_s *table, const char *str, size_t len);
+void strbuf_intern_release(strbuf_intern_s *table, strbuf_s *sb);
+size_t strbuf_intern_count(strbuf_intern_s *table);
+
 const char *strbuf_append(strbuf_s *sb, const char *str, size_t len);
 const char *strbuf_append_f(strbuf_s *sb, size_t max, const char *format, ...);
 const char *strbuf_append_float(strbuf_s *sb, long double f);
 const char *strbuf_append_int(strbuf_s *sb, int64_t i);
 const char *strbuf_append_uint(strbuf_s *sb, uint64_t u);
 
+/* for a producer which writes in to the strbuf directly: returns where to
+   write at least "min" bytes, setting "avail" to the bytes which may be
+   written there; or NULL, if out of memory, or if a strbuf_no_grow or
+   strbuf_ring buffer can not fit "min" bytes. "n" of them, as written, are
+   then made part of the string by strbuf_commit; any bytes written past
+   "n" are not. Nothing else may change the strbuf in between */
+char *strbuf_reserve_tail(strbuf_s *sb, size_t min, size_t *avail);
+const char *strbuf_commit(strbuf_s *sb, size_t n);
+
+/* parse a number starting at "offset", reading at most "len" bytes of
+   the string; no whitespace is skipped and the locale is not consulted;
+   returns the bytes consumed, or 0 if there is no number or it overflows */
+size_t strbuf_parse_int64(strbuf_s *sb, size_t offset, size_t len,
+			  int64_t *out);
+size_t strbuf_parse_uint64(strbuf_s *sb, size_t offset, size_t len,
+			   uint64_t *out);
+size_t strbuf_parse_double(strbuf_s *sb, size_t offset, size_t len,
+			   double *out);
+
+/* a format compiled once and run many times without re-parsing; supports
+   flags "-0+ #", width, precision, hh h l ll z j L, and d i u x X s c
+   f F e E g G; returns NULL for anything else, such as '*' or "%n" */
+struct strbuf_fmt;
+typedef struct strbuf_fmt strbuf_fmt_s;
+
+strbuf_fmt_s *strbuf_fmt_compile(const char *format);
+void strbuf_fmt_destroy(strbuf_fmt_s *prog);
+const char *strbuf_append_fmt(strbuf_s *sb, const strbuf_fmt_s *prog, ...);
+
+/* a glob pattern compiled once: '*' matches any run of bytes, including
+   '/', '?' any one byte, "[a-z]" one of a set, "[!a-z]" or "[^a-z]" one
+   not in it, and '\' makes the next byte literal; compiling returns NULL
+   for an unclosed '[' or a trailing '\'. Matching never backtracks and
+   does not allocate; on a gap or a wrapped ring, the string is first made
+   contiguous, as by strbuf_str */
+struct strbuf_glob;
+typedef struct strbuf_glob strbuf_glob_s;
+
+strbuf_glob_s *strbuf_glob_compile(const char *pattern);
+void strbuf_glob_destroy(strbuf_glob_s *glob);
+int strbuf_glob_match(const strbuf_glob_s *glob, strbuf_s *sb);
+int strbuf_glob_match_str(const strbuf_glob_s *glob, const char *str,
+			  size_t len);
+
+/* many patterns, checked against one string; patterns which need a byte
+   not in the string are skipped after a single pass over it. Returns how
+   many match, and stores up to "max" of their indexes, in order */
+struct strbuf_glob_set;
+typedef struct strbuf_glob_set strbuf_glob_set_s;
+
+strbuf_glob_set_s *strbuf_glob_set_compile(const char *const *patterns,
+					   size_t num);
+void strbuf_glob_set_destroy(strbuf_glob_set_s *set);
+size_t strbuf_glob_set_match(const strbuf_glob_set_s *set, strbuf_s *sb,
+			     size_t *matches, size_t max);
+
+/* masks every occurrence of any of the patterns with "mask", in a single
+   pass however many patterns there are; overlapping matches are all
+   masked. With STRBUF_REDACT_TOKEN, the rest of the token after a match
+   is masked too, up to whitespace or one of the bytes "',;& */
+struct strbuf_redactor;
+typedef struct strbuf_redactor strbuf_redactor_s;
+
+#define STRBUF_REDACT_ICASE 0x01
+#define STRBUF_REDACT_TOKEN 0x02
+
+/* returns NULL if out of memory or if a pattern is empty */
+strbuf_redactor_s *strbuf_redactor_new(const char *const *patterns,
+				       size_t num, unsigned flags);
+void strbuf_redactor_destroy(strbuf_redactor_s *redactor);
+const char *strbuf_redact(const strbuf_redactor_s *redactor, strbuf_s *sb,
+			  char mask);
+
+/* appends "tmpl" with each "${name}" replaced by what "lookup" returns for
+   the name, setting "value_len"; NULL, as for an unset name, gives "".
+   "${name:-default}" gives the default if the value is unset or empty,
+   and "$$" gives "$". The template is scanned once, and the literal runs
+   copied whole; it must not point into "sb" */
+typedef const char *(*strbuf_expand_lookup_fn)(void *ctx, const char *name,
+					       size_t name_len,
+					       size_t *value_len);
+
+const char *strbuf_expand(strbuf_s *sb, const char *tmpl, size_t tmpl_len,
+			  strbuf_expand_lookup_fn lookup, void *ctx);
+
+/* a template parsed once, with the offsets of its literals and variables,
+   for rendering many times; the template is copied */
+struct strbuf_template;
+typedef struct strbuf_template strbuf_template_s;
+
+strbuf_template_s *strbuf_template_compile(const char *tmpl, size_t tmpl_len);
+void strbuf_template_destroy(strbuf_template_s *tmpl);
+const char *strbuf_template_expand(strbuf_s *sb, const strbuf_template_s *tmpl,
+				   strbuf_expand_lookup_fn lookup, void *ctx);
+
 const char *strbuf_prepend(strbuf_s *sb, const char *str, size_t len);
 const char *strbuf_prepend_f(strbuf_s *sb, size_t max, const char *format, ...);
 const char *strbuf_prepend_float(strbuf_s *sb, long double f);
@@ -47,11 +233,105 @@ const char *strbuf_prepend_int(strbuf_s *sb, int64_t i);
 const char *strbuf_prepend_uint(strbuf_s *sb, uint64_t u);
 
 const char *strbuf_trim(strbuf_s *sb);
+
+/* edits at any position; consecutive edits near each other are cheap, as
+   the string is kept as two parts around a gap at the last edit, which is
+   closed when the contiguous string is next needed; "str" must not point
+   in to the strbuf itself; these return NULL if out of memory */
+strbuf_s *strbuf_insert(strbuf_s *sb, size_t pos, const char *str,
+			size_t len);
+strbuf_s *strbuf_erase(strbuf_s *sb, size_t pos, size_t n);
+strbuf_s *strbuf_replace_range(strbuf_s *sb, size_t pos, size_t n,
+			       const char *str, size_t len);
+
+/* drops "n" bytes from the front in O(1); the space is reclaimed when an
+   append which would otherwise grow the buffer fits once it is, or by
+   strbuf_compact_if, when the dropped bytes are more than "percent" of the
+   buffer */
+strbuf_s *strbuf_consume(strbuf_s *sb, size_t n);
+const char *strbuf_compact_if(strbuf_s *sb, size_t percent);
+
 const char *strbuf_trim_l(strbuf_s *sb);
 const char *strbuf_trim_r(strbuf_s *sb);
 
+/* ASCII case mapping in place; bytes above 0x7F are left untouched */
+const char *strbuf_to_lower(strbuf_s *sb);
+const char *strbuf_to_upper(strbuf_s *sb);
+
+/* ASCII case-insensitive compare, returns <0, 0, >0 like strcmp */
+int strbuf_casecmp(strbuf_s *sb, const char *str, size_t len);
+int strbuf_caseeq(strbuf_s *sb, const char *str, size_t len);
+
 size_t strbuf_struct_size(void);
 char *strbuf_expose(strbuf_s *sb, size_t *size);
 const char *strbuf_return(strbuf_s *sb);
 
+/* hands the NULL-terminated buffer to the caller, who frees it with the
+   strbuf's allocator; the strbuf is left empty and still usable */
+char *strbuf_take(strbuf_s *sb, size_t *len);
+
+/* the strbuf takes ownership of "buf", which came from "allocator" (NULL
+   for the eembed_global_allocator) and holds "cap" bytes, without a copy;
+   returns NULL if "len" is not less than "cap", or if the strbuf struct
+   itself was allocated from a different allocator. A ring stops being
+   one, as the adopted buffer may grow */
+strbuf_s *strbuf_adopt(strbuf_s *sb, char *buf, size_t len, size_t cap,
+		       struct eembed_allocator *allocator);
+
+enum strbuf_escape {
+	strbuf_escape_html = 0,
+	strbuf_escape_url = 1,
+	strbuf_escape_csv = 2,
+	strbuf_escape_shell = 3,
+};
+
+const char *strbuf_append_escaped(strbuf_s *sb, const char *str, size_t len,
+				  enum strbuf_escape mode);
+const char *strbuf_unescape(strbuf_s *sb, enum strbuf_escape mode);
+
+const char *strbuf_append_base64(strbuf_s *sb, const void *data, size_t len);
+const char *strbuf_append_base64url(strbuf_s *sb, const void *data,
+				    size_t len);
+const char *strbuf_append_hex(strbuf_s *sb, const void *data, size_t len);
+
+/* invalid input returns NULL and leaves the strbuf unchanged; a ring is
+   checked before any of its bytes are pushed out */
+const char *strbuf_append_base64_decoded(strbuf_s *sb, const char *src,
+					 size_t len);
+const char *strbuf_append_base64url_decoded(strbuf_s *sb, const char *src,
+					    size_t len);
+const char *strbuf_append_hex_decoded(strbuf_s *sb, const char *src,
+				      size_t len);
+
+/* a streaming JSON writer, appends to the strbuf as values are added */
+#define STRBUF_JSON_MAX_DEPTH 64
+struct strbuf_json {
+	strbuf_s *sb;
+	uint64_t has_members;
+	uint64_t is_object;
+	uint8_t depth;
+	uint8_t state;
+};
+typedef struct strbuf_json strbuf_json_s;
+
+void strbuf_json_init(strbuf_json_s *json, strbuf_s *sb);
+
+const char *strbuf_json_object_begin(strbuf_json_s *json);
+const char *strbuf_json_object_end(strbuf_json_s *json);
+const char *strbuf_json_array_begin(strbuf_json_s *json);
+const char *strbuf_json_array_end(strbuf_json_s *json);
+
+const char *strbuf_json_key(strbuf_json_s *json, const char *key, size_t len);
+const char *strbuf_json_string(strbuf_json_s *json, const char *str,
+			       size_t len);
+const char *strbuf_json_int(strbuf_json_s *json, int64_t i);
+const char *strbuf_json_uint(strbuf_json_s *json, uint64_t u);
+const char *strbuf_json_double(strbuf_json_s *json, double d);
+const char *strbuf_json_bool(strbuf_json_s *json, int b);
+const char *strbuf_json_null(strbuf_json_s *json);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* #ifndef STRBUF_H */
@@ -0,0 +1,327 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* strbuf.hpp : C++ wrapper for strbuf.h, requires C++17 */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#ifndef STRBUF_HPP
+#define STRBUF_HPP 1
+
+#include <charconv>
+#include <cstddef>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "strbuf.h"
+
+namespace libstrbuf {
+
+/* an upper bound on the chars operator<< may add for a T; sum these to
+   show at compile time that a static_strbuf is large enough */
+template <typename T>
+constexpr std::size_t max_chars() noexcept
+{
+	if constexpr (std::is_same_v<T, bool>) {
+		return 5;
+	} else if constexpr (std::is_same_v<T, char>) {
+		return 1;
+	} else if constexpr (std::is_integral_v<T>) {
+		/* sign, plus digits10 + 1 digits */
+		return 2 + std::numeric_limits<T>::digits10;
+	} else {
+		/* sign, max_digits10 digits, point, "e-", exponent */
+		return 1 + std::numeric_limits<T>::max_digits10 + 1 + 2 + 5;
+	}
+}
+
+template <typename... T>
+constexpr std::size_t max_chars_sum() noexcept
+{
+	return (0 + ... + max_chars<T>());
+}
+
+/* owns a strbuf_s; moves are cheap and copies must be asked for with
+   clone(); as with iostreams, a failed operator<< sets fail() rather than
+   throwing, and later ones do nothing until clear() */
+class strbuf {
+public:
+	strbuf() noexcept : sb_(::strbuf_new(nullptr, 0)), fail_(!sb_)
+	{
+	}
+
+	explicit strbuf(std::string_view s) noexcept
+	    : sb_(::strbuf_new(s.data(), s.size())), fail_(!sb_)
+	{
+	}
+
+	/* takes ownership of "sb", which is destroyed with this */
+	explicit strbuf(::strbuf_s *sb) noexcept : sb_(sb), fail_(!sb_)
+	{
+	}
+
+	~strbuf()
+	{
+		::strbuf_destroy(sb_);
+	}
+
+	strbuf(const strbuf &) = delete;
+	strbuf &operator=(const strbuf &) = delete;
+
+	strbuf(strbuf &&other) noexcept
+	    : sb_(std::exchange(other.sb_, nullptr)),
+	      fail_(std::exchange(other.fail_, true))
+	{
+	}
+
+	strbuf &operator=(strbuf &&other) noexcept
+	{
+		if (this != &other) {
+			::strbuf_destroy(sb_);
+			sb_ = std::exchange(other.sb_, nullptr);
+			fail_ = std::exchange(other.fail_, true);
+		}
+		return *this;
+	}
+
+	/* shares the buffer until either is modified, see strbuf_clone */
+	strbuf clone() const noexcept
+	{
+		return strbuf(sb_ ? ::strbuf_clone(sb_) : nullptr);
+	}
+
+	::strbuf_s *get() const noexcept
+	{
+		return sb_;
+	}
+
+	::strbuf_s *release() noexcept
+	{
+		fail_ = true;
+		return std::exchange(sb_, nullptr);
+	}
+
+	const char *c_str() const noexcept
+	{
+		return sb_ ? ::strbuf_str(sb_) : "";
+	}
+
+	std::size_t size() const noexcept
+	{
+		return sb_ ? ::strbuf_len(sb_) : 0;
+	}
+
+	bool empty() const noexcept
+	{
+		return size() == 0;
+	}
+
+	std::string_view view() const noexcept
+	{
+		if (!sb_) {
+			return std::string_view();
+		}
+		const char *s = ::strbuf_str(sb_);
+		return std::string_view(s, ::strbuf_len(sb_));
+	}
+
+	operator std::string_view() const noexcept
+	{
+		return view();
+	}
+
+	bool fail() const noexcept
+	{
+		return fail_;
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return !fail_;
+	}
+
+	void clear() noexcept
+	{
+		fail_ = !sb_;
+	}
+
+	/* these return false if out of memory, leaving the string as it was */
+	bool set(std::string_view s) noexcept
+	{
+		return sb_ && ::strbuf_set(sb_, s.data(), s.size());
+	}
+
+	bool append(std::string_view s) noexcept
+	{
+		return append(s.data(), s.size());
+	}
+
+	bool append(const char *s, std::size_t len) noexcept
+	{
+		if (!len) {
+			return sb_ != nullptr;
+		}
+		return sb_ && ::strbuf_append(sb_, s, len);
+	}
+
+	strbuf &operator<<(std::string_view s) noexcept
+	{
+		if (!fail_ && !append(s)) {
+			fail_ = true;
+		}
+		return *this;
+	}
+
+	strbuf &operator<<(const char *s) noexcept
+	{
+		return *this << std::string_view(s ? s : "(null)");
+	}
+
+	strbuf &operator<<(char c) noexcept
+	{
+		return *this << std::string_view(&c, 1);
+	}
+
+	strbuf &operator<<(bool b) noexcept
+	{
+		return *this << std::string_view(b ? "true" : "false");
+	}
+
+	/* numbers are written with std::to_chars straight in to the strbuf,
+	   without the locale; a float is written in the shortest form which
+	   reads back the same */
+	template <typename T,
+		  std::enable_if_t<std::is_arithmetic_v<T>
+				   && !std::is_same_v<T, bool>
+				   && !std::is_same_v<T, char>, int> = 0>
+	strbuf &operator<<(T val) noexcept
+	{
+		if (fail_ || !sb_) {
+			fail_ = true;
+			return *this;
+		}
+		/* first in to the space there is, and if that is not enough,
+		   again once room for the longest is reserved */
+		std::size_t min = 0;
+		for (int i = 0; i < 2; ++i) {
+			std::size_t avail = 0;
+			char *tail = ::strbuf_reserve_tail(sb_, min, &avail);
+			if (!tail) {
+				break;
+			}
+			std::to_chars_result r = std::to_chars(tail, tail + avail,
+							       val);
+			if (r.ec == std::errc()) {
+				::strbuf_commit(sb_, r.ptr - tail);
+				return *this;
+			}
+			::strbuf_commit(sb_, 0);
+			min = max_chars<T>();
+		}
+		fail_ = true;
+		return *this;
+	}
+
+private:
+	::strbuf_s *sb_;
+	bool fail_;
+};
+
+/* a strbuf with room for N chars inside the object, built on
+   strbuf_no_grow; it never allocates, so appends past N fail */
+template <std::size_t N>
+class static_strbuf {
+public:
+	static_strbuf() noexcept
+	    : sb_(::strbuf_no_grow(mem_, sizeof(mem_), nullptr, 0))
+	{
+	}
+
+	explicit static_strbuf(std::string_view s) noexcept : static_strbuf()
+	{
+		sb_ << s;
+	}
+
+	/* the strbuf_s points in to this object, so it cannot move */
+	static_strbuf(const static_strbuf &) = delete;
+	static_strbuf &operator=(const static_strbuf &) = delete;
+
+	static constexpr std::size_t capacity() noexcept
+	{
+		return N;
+	}
+
+	::strbuf_s *get() const noexcept
+	{
+		return sb_.get();
+	}
+
+	const char *c_str() const noexcept
+	{
+		return sb_.c_str();
+	}
+
+	std::size_t size() const noexcept
+	{
+		return sb_.size();
+	}
+
+	bool empty() const noexcept
+	{
+		return sb_.empty();
+	}
+
+	std::string_view view() const noexcept
+	{
+		return sb_.view();
+	}
+
+	operator std::string_view() const noexcept
+	{
+		return sb_.view();
+	}
+
+	bool fail() const noexcept
+	{
+		return sb_.fail();
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return !sb_.fail();
+	}
+
+	void clear() noexcept
+	{
+		sb_.clear();
+	}
+
+	bool set(std::string_view s) noexcept
+	{
+		return sb_.set(s);
+	}
+
+	bool append(std::string_view s) noexcept
+	{
+		return sb_.append(s);
+	}
+
+	bool append(const char *s, std::size_t len) noexcept
+	{
+		return sb_.append(s, len);
+	}
+
+	template <typename T>
+	static_strbuf &operator<<(const T &val) noexcept
+	{
+		sb_ << val;
+		return *this;
+	}
+
+private:
+	alignas(std::max_align_t) unsigned char mem_[STRBUF_NO_GROW_SIZE(N)];
+	strbuf sb_;
+};
+
+}				/* namespace libstrbuf */
+
+#endif /* #ifndef STRBUF_HPP */
@@ -0,0 +1,218 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* strbuf_mmap.c : an allocator for very large strbufs, hosted Linux only */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1		/* mremap */
+#endif
+
+#include "strbuf_mmap.h"
+
+#if EEMBED_HOSTED && defined(__linux__)
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* every block is preceded by its size and, if mapped, the mapped length;
+   two words keep the block aligned as malloc's would be */
+struct strbuf_mmap_header {
+	size_t size;
+	size_t map_len;
+};
+
+#define Strbuf_mmap_header_size (2 * sizeof(size_t))
+
+static struct strbuf_mmap_header *strbuf_mmap_header(void *ptr)
+{
+	return (struct strbuf_mmap_header *)(((unsigned char *)ptr)
+					     - Strbuf_mmap_header_size);
+}
+
+static size_t strbuf_mmap_map_len(size_t size)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t len = size + Strbuf_mmap_header_size;
+	if (len < size) {
+		return 0;
+	}
+	return (len + page - 1) & ~(page - 1);
+}
+
+static void strbuf_mmap_advise(struct strbuf_mmap_allocator *ma, void *map,
+			       size_t map_len)
+{
+#ifdef MADV_HUGEPAGE
+	if (ma->flags & STRBUF_MMAP_HUGE_PAGES) {
+		/* only a hint; if THP is disabled, the pages are small */
+		(void)madvise(map, map_len, MADV_HUGEPAGE);
+	}
+#else
+	(void)ma;
+	(void)map;
+	(void)map_len;
+#endif
+}
+
+static void *strbuf_mmap_block(struct strbuf_mmap_header *h, size_t size,
+			       size_t map_len)
+{
+	h->size = size;
+	h->map_len = map_len;
+	return ((unsigned char *)h) + Strbuf_mmap_header_size;
+}
+
+static void *strbuf_mmap_malloc(struct eembed_allocator *ea, size_t size)
+{
+	struct strbuf_mmap_allocator *ma =
+	    (struct strbuf_mmap_allocator *)ea->context;
+	if (size < ma->threshold) {
+		size_t total = size + Strbuf_mmap_header_size;
+		if (total < size) {
+			return NULL;
+		}
+		void *p = ma->small->malloc(ma->small, total);
+		if (!p) {
+			return NULL;
+		}
+		struct strbuf_mmap_header *h = (struct strbuf_mmap_header *)p;
+		return strbuf_mmap_block(h, size, 0);
+	}
+
+	size_t map_len = strbuf_mmap_map_len(size);
+	if (!map_len) {
+		return NULL;
+	}
+	void *map = mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
+	strbuf_mmap_advise(ma, map, map_len);
+	return strbuf_mmap_block((struct strbuf_mmap_header *)map, size,
+				 map_len);
+}
+
+static void strbuf_mmap_free(struct eembed_allocator *ea, void *ptr)
+{
+	if (!ptr) {
+		return;
+	}
+	struct strbuf_mmap_allocator *ma =
+	    (struct strbuf_mmap_allocator *)ea->context;
+	struct strbuf_mmap_header *h = strbuf_mmap_header(ptr);
+	if (h->map_len) {
+		munmap(h, h->map_len);
+	} else {
+		ma->small->free(ma->small, h);
+	}
+}
+
+static void *strbuf_mmap_calloc(struct eembed_allocator *ea, size_t nmemb,
+				size_t size)
+{
+	if (size && nmemb > (SIZE_MAX / size)) {
+		return NULL;
+	}
+	size_t total = nmemb * size;
+	void *p = strbuf_mmap_malloc(ea, total);
+	if (p && !strbuf_mmap_header(p)->map_len) {
+		/* fresh mappings are already zero */
+		eembed_memset(p, 0x00, total);
+	}
+	return p;
+}
+
+static void *strbuf_mmap_realloc(struct eembed_allocator *ea, void *ptr,
+				 size_t size)
+{
+	if (!ptr) {
+		return strbuf_mmap_malloc(ea, size);
+	}
+	struct strbuf_mmap_allocator *ma =
+	    (struct strbuf_mmap_allocator *)ea->context;
+	struct strbuf_mmap_header *h = strbuf_mmap_header(ptr);
+	if (h->map_len) {
+		size_t map_len = strbuf_mmap_map_len(size);
+		if (!map_len) {
+			return NULL;
+		}
+		if (map_len == h->map_len) {
+			h->size = size;
+			return ptr;
+		}
+		void *map = mremap(h, h->map_len, map_len, MREMAP_MAYMOVE);
+		if (map == MAP_FAILED) {
+			return NULL;
+		}
+		strbuf_mmap_advise(ma, map, map_len);
+		return strbuf_mmap_block((struct strbuf_mmap_header *)map, size,
+					 map_len);
+	}
+
+	if (size < ma->threshold && ma->small->realloc) {
+		size_t total = size + Strbuf_mmap_header_size;
+		if (total < size) {
+			return NULL;
+		}
+		h = (struct strbuf_mmap_header *)ma->small->realloc(ma->small,
+								    h, total);
+		if (!h) {
+			return NULL;
+		}
+		return strbuf_mmap_block(h, size, 0);
+	}
+
+	/* crossing the threshold is the last copy */
+	void *p = strbuf_mmap_malloc(ea, size);
+	if (!p) {
+		return NULL;
+	}
+	eembed_memcpy(p, ptr, (h->size < size) ? h->size : size);
+	strbuf_mmap_free(ea, ptr);
+	return p;
+}
+
+static void *strbuf_mmap_reallocarray(struct eembed_allocator *ea, void *ptr,
+				      size_t nmemb, size_t size)
+{
+	if (size && nmemb > (SIZE_MAX / size)) {
+		return NULL;
+	}
+	return strbuf_mmap_realloc(ea, ptr, nmemb * size);
+}
+
+struct eembed_allocator *strbuf_mmap_allocator(struct strbuf_mmap_allocator
+					       *ma,
+					       struct eembed_allocator *small,
+					       size_t threshold,
+					       unsigned flags)
+{
+	eembed_assert(ma);
+	ma->small = small ? small : eembed_global_allocator;
+	ma->threshold = threshold;
+	ma->flags = flags;
+	ma->ea.context = ma;
+	ma->ea.malloc = strbuf_mmap_malloc;
+	ma->ea.calloc = strbuf_mmap_calloc;
+	ma->ea.realloc = strbuf_mmap_realloc;
+	ma->ea.reallocarray = strbuf_mmap_reallocarray;
+	ma->ea.free = strbuf_mmap_free;
+	return &ma->ea;
+}
+
+#else /* #if EEMBED_HOSTED && defined(__linux__) */
+
+struct eembed_allocator *strbuf_mmap_allocator(struct strbuf_mmap_allocator
+					       *ma,
+					       struct eembed_allocator *small,
+					       size_t threshold,
+					       unsigned flags)
+{
+	(void)ma;
+	(void)threshold;
+	(void)flags;
+	return small ? small : eembed_global_allocator;
+}
+
+#endif /* #if EEMBED_HOSTED && defined(__linux__) */
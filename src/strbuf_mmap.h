@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* strbuf_mmap.h : an allocator for very large strbufs, hosted Linux only */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#ifndef STRBUF_MMAP_H
+#define STRBUF_MMAP_H 1
+
+#include <stddef.h>
+
+#include "eembed.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* for strbuf_mmap_allocator: madvise(MADV_HUGEPAGE) the mappings */
+#define STRBUF_MMAP_HUGE_PAGES 1
+
+#define STRBUF_MMAP_THRESHOLD_DEFAULT (4 * 1024 * 1024)
+
+struct strbuf_mmap_allocator {
+	struct eembed_allocator ea;
+	struct eembed_allocator *small;
+	size_t threshold;
+	unsigned flags;
+};
+
+/* blocks of at least "threshold" bytes get their own anonymous mapping,
+   which realloc grows with mremap(MREMAP_MAYMOVE) rather than copying;
+   smaller ones come from "small", or if NULL the global allocator. Used
+   as the allocator of a strbuf_new_custom, turn on strbuf_grow_by_realloc
+   so that growth goes through realloc, and a buffer is mapped once it
+   reaches "threshold". Where mmap is not available, "small" itself is
+   returned */
+struct eembed_allocator *strbuf_mmap_allocator(struct strbuf_mmap_allocator
+					       *ma,
+					       struct eembed_allocator *small,
+					       size_t threshold,
+					       unsigned flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef STRBUF_MMAP_H */
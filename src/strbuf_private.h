@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* strbuf_private.h : for the library's own modules, not for users */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#ifndef STRBUF_PRIVATE_H
+#define STRBUF_PRIVATE_H 1
+
+#include <stddef.h>
+
+#include "strbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the buffer as it is, and its size; unlike strbuf_expose, nothing is
+   moved, cleared or marked as changed */
+char *strbuf_buffer(strbuf_s *sb, size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef STRBUF_PRIVATE_H */
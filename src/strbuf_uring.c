@@ -0,0 +1,688 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* strbuf_uring.c : batched writes of strbufs, io_uring on Linux */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf_uring.h"
+#include "strbuf_private.h"
+#include "eembed.h"
+
+#if EEMBED_HOSTED && (defined(__unix__) || defined(__APPLE__))
+
+/* elsewhere, the writes are done with writev(2) */
+#if defined(__linux__)
+#define Strbuf_io_uring 1
+#else
+#define Strbuf_io_uring 0
+#endif
+
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if Strbuf_io_uring
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+enum strbuf_uring_state {
+	strbuf_uring_free = 0,
+	strbuf_uring_queued,
+	strbuf_uring_in_flight,
+	strbuf_uring_done
+};
+
+struct strbuf_uring_op {
+	strbuf_s *sbs[STRBUF_URING_MAX_BUFS];
+	struct iovec iov[2 * STRBUF_URING_MAX_BUFS];
+	size_t nsbs;
+	int iovcnt;
+	int fd;
+	int fixed;
+	int64_t file_off;
+	void *user;
+	int64_t res;
+	enum strbuf_uring_state state;
+};
+
+struct strbuf_uring {
+	struct eembed_allocator *ea;
+	struct strbuf_uring_op *ops;
+	/* free ops as a stack, queued and done ops as FIFOs */
+	unsigned *free_idx;
+	unsigned *queued_idx;
+	unsigned *done_idx;
+	unsigned entries;
+	unsigned free_len;
+	unsigned queued_len;
+	unsigned done_head;
+	unsigned done_len;
+	/* of the op at done_head, the strbufs already reaped */
+	size_t done_pos;
+	unsigned in_flight;
+
+	struct iovec *fixed;
+	size_t fixed_len;
+
+	/* io_uring; ring_fd is -1 when using writev */
+	int ring_fd;
+#if Strbuf_io_uring
+	/* in the submission queue, but not yet taken by the kernel */
+	unsigned sq_unsubmitted;
+	void *sq_map;
+	size_t sq_map_len;
+	void *cq_map;
+	size_t cq_map_len;
+	struct io_uring_sqe *sqes;
+	size_t sqes_len;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+#endif
+};
+
+#if Strbuf_io_uring
+
+static int strbuf_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int strbuf_io_uring_enter(int fd, unsigned to_submit,
+				 unsigned min_complete, unsigned flags)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+			    flags, NULL, 0);
+}
+
+static int strbuf_io_uring_register(int fd, unsigned opcode, void *arg,
+				    unsigned nr_args)
+{
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void strbuf_uring_unmap(strbuf_uring_s *u)
+{
+	if (u->sqes) {
+		munmap(u->sqes, u->sqes_len);
+	}
+	if (u->cq_map && u->cq_map != u->sq_map) {
+		munmap(u->cq_map, u->cq_map_len);
+	}
+	if (u->sq_map) {
+		munmap(u->sq_map, u->sq_map_len);
+	}
+	if (u->ring_fd >= 0) {
+		close(u->ring_fd);
+	}
+	u->sqes = NULL;
+	u->cq_map = NULL;
+	u->sq_map = NULL;
+	u->ring_fd = -1;
+}
+
+/* on any failure, leaves ring_fd as -1, so that writev is used */
+static void strbuf_uring_map(strbuf_uring_s *u)
+{
+	struct io_uring_params p;
+	eembed_memset(&p, 0x00, sizeof(p));
+	u->ring_fd = strbuf_io_uring_setup(u->entries, &p);
+	if (u->ring_fd < 0) {
+		u->ring_fd = -1;
+		return;
+	}
+
+	u->sq_map_len = p.sq_off.array + (p.sq_entries * sizeof(unsigned));
+	u->cq_map_len = p.cq_off.cqes
+	    + (p.cq_entries * sizeof(struct io_uring_cqe));
+	int single = (p.features & IORING_FEAT_SINGLE_MMAP) ? 1 : 0;
+	if (single && u->cq_map_len > u->sq_map_len) {
+		u->sq_map_len = u->cq_map_len;
+	}
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_SHARED | MAP_POPULATE;
+	void *m = mmap(NULL, u->sq_map_len, prot, flags, u->ring_fd,
+		       IORING_OFF_SQ_RING);
+	if (m == MAP_FAILED) {
+		strbuf_uring_unmap(u);
+		return;
+	}
+	u->sq_map = m;
+	if (single) {
+		u->cq_map = u->sq_map;
+	} else {
+		m = mmap(NULL, u->cq_map_len, prot, flags, u->ring_fd,
+			 IORING_OFF_CQ_RING);
+		if (m == MAP_FAILED) {
+			strbuf_uring_unmap(u);
+			return;
+		}
+		u->cq_map = m;
+	}
+	u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	m = mmap(NULL, u->sqes_len, prot, flags, u->ring_fd, IORING_OFF_SQES);
+	if (m == MAP_FAILED) {
+		strbuf_uring_unmap(u);
+		return;
+	}
+	u->sqes = (struct io_uring_sqe *)m;
+
+	char *sq = (char *)u->sq_map;
+	u->sq_head = (unsigned *)(sq + p.sq_off.head);
+	u->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	u->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	u->sq_array = (unsigned *)(sq + p.sq_off.array);
+	char *cq = (char *)u->cq_map;
+	u->cq_head = (unsigned *)(cq + p.cq_off.head);
+	u->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	u->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+}
+
+#else /* #if Strbuf_io_uring */
+
+static void strbuf_uring_unmap(strbuf_uring_s *u)
+{
+	(void)u;
+}
+
+static void strbuf_uring_map(strbuf_uring_s *u)
+{
+	u->ring_fd = -1;
+}
+
+#endif /* #if Strbuf_io_uring */
+
+static void strbuf_uring_mem_free(struct eembed_allocator *ea, void *p)
+{
+	if (p) {
+		ea->free(ea, p);
+	}
+}
+
+strbuf_uring_s *strbuf_uring_new(struct eembed_allocator *ea,
+				 unsigned entries, unsigned flags)
+{
+	if (!ea) {
+		ea = eembed_global_allocator;
+	}
+	if (!ea || !entries) {
+		return NULL;
+	}
+
+	size_t size = sizeof(strbuf_uring_s);
+	strbuf_uring_s *u = (strbuf_uring_s *)ea->malloc(ea, size);
+	if (!u) {
+		return NULL;
+	}
+	eembed_memset(u, 0x00, size);
+	u->ea = ea;
+	u->entries = entries;
+	u->ring_fd = -1;
+
+	size = entries * sizeof(struct strbuf_uring_op);
+	u->ops = (struct strbuf_uring_op *)ea->malloc(ea, size);
+	size_t idx_size = entries * sizeof(unsigned);
+	u->free_idx = (unsigned *)ea->malloc(ea, idx_size);
+	u->queued_idx = (unsigned *)ea->malloc(ea, idx_size);
+	u->done_idx = (unsigned *)ea->malloc(ea, idx_size);
+	if (!u->ops || !u->free_idx || !u->queued_idx || !u->done_idx) {
+		strbuf_uring_destroy(u);
+		return NULL;
+	}
+	eembed_memset(u->ops, 0x00, size);
+	for (unsigned i = 0; i < entries; ++i) {
+		u->free_idx[i] = entries - 1 - i;
+	}
+	u->free_len = entries;
+
+	if (!(flags & STRBUF_URING_NO_IO_URING)) {
+		strbuf_uring_map(u);
+	}
+	return u;
+}
+
+void strbuf_uring_destroy(strbuf_uring_s *u)
+{
+	if (!u) {
+		return;
+	}
+	/* the kernel may still be reading the buffers */
+	while (u->ring_fd >= 0 && u->in_flight) {
+		strbuf_uring_done_s done[STRBUF_URING_MAX_BUFS];
+		unsigned before = u->in_flight;
+		size_t max = STRBUF_URING_MAX_BUFS;
+		if (!strbuf_uring_reap(u, done, max, 1)
+		    && u->in_flight == before) {
+			break;
+		}
+	}
+	strbuf_uring_unmap(u);
+	strbuf_uring_mem_free(u->ea, u->fixed);
+	strbuf_uring_mem_free(u->ea, u->done_idx);
+	strbuf_uring_mem_free(u->ea, u->queued_idx);
+	strbuf_uring_mem_free(u->ea, u->free_idx);
+	strbuf_uring_mem_free(u->ea, u->ops);
+	strbuf_uring_mem_free(u->ea, u);
+}
+
+int strbuf_uring_is_io_uring(strbuf_uring_s *u)
+{
+	eembed_assert(u);
+	return u->ring_fd >= 0;
+}
+
+int strbuf_uring_register(strbuf_uring_s *u, strbuf_s **sbs, size_t n)
+{
+	eembed_assert(u);
+	eembed_assert(sbs || !n);
+	if (u->fixed_len) {
+		return -EBUSY;
+	}
+	if (!n) {
+		return 0;
+	}
+	struct eembed_allocator *ea = u->ea;
+	size_t size = n * sizeof(struct iovec);
+	struct iovec *fixed = (struct iovec *)ea->malloc(ea, size);
+	if (!fixed) {
+		return -ENOMEM;
+	}
+	for (size_t i = 0; i < n; ++i) {
+		size = 0;
+		fixed[i].iov_base = strbuf_buffer(sbs[i], &size);
+		fixed[i].iov_len = size;
+	}
+#if Strbuf_io_uring
+	if (u->ring_fd >= 0) {
+		int err = strbuf_io_uring_register(u->ring_fd,
+						   IORING_REGISTER_BUFFERS,
+						   fixed, (unsigned)n);
+		if (err < 0) {
+			err = -errno;
+			ea->free(ea, fixed);
+			return err;
+		}
+	}
+#endif
+	u->fixed = fixed;
+	u->fixed_len = n;
+	return 0;
+}
+
+static int strbuf_uring_fixed_index(strbuf_uring_s *u, struct iovec *iov)
+{
+	const char *b = (const char *)iov->iov_base;
+	for (size_t i = 0; i < u->fixed_len; ++i) {
+		const char *f = (const char *)u->fixed[i].iov_base;
+		if (b >= f && (b + iov->iov_len) <= (f + u->fixed[i].iov_len)) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+/* appends the iovecs for "len" bytes from "offset" of the string */
+static int strbuf_uring_iov(struct strbuf_uring_op *op, strbuf_s *sb,
+			    size_t offset, size_t len)
+{
+	const char *a, *b;
+	size_t a_len, b_len;
+	strbuf_spans(sb, &a, &a_len, &b, &b_len);
+	if (offset > (a_len + b_len) || len > (a_len + b_len - offset)) {
+		return -EINVAL;
+	}
+	if (offset < a_len) {
+		size_t n = (len < (a_len - offset)) ? len : (a_len - offset);
+		op->iov[op->iovcnt].iov_base = (void *)(a + offset);
+		op->iov[op->iovcnt].iov_len = n;
+		++op->iovcnt;
+		len -= n;
+		offset = 0;
+	} else {
+		offset -= a_len;
+	}
+	if (len) {
+		op->iov[op->iovcnt].iov_base = (void *)(b + offset);
+		op->iov[op->iovcnt].iov_len = len;
+		++op->iovcnt;
+	}
+	op->sbs[op->nsbs++] = sb;
+	return 0;
+}
+
+static struct strbuf_uring_op *strbuf_uring_op_get(strbuf_uring_s *u, int fd,
+						   int64_t file_off,
+						   void *user)
+{
+	if (!u->free_len) {
+		return NULL;
+	}
+	struct strbuf_uring_op *op = u->ops + u->free_idx[u->free_len - 1];
+	eembed_memset(op, 0x00, sizeof(*op));
+	op->fd = fd;
+	op->fixed = -1;
+	op->file_off = file_off;
+	op->user = user;
+	return op;
+}
+
+static void strbuf_uring_op_queue(strbuf_uring_s *u,
+				  struct strbuf_uring_op *op)
+{
+	--u->free_len;
+	op->state = strbuf_uring_queued;
+	u->queued_idx[u->queued_len++] = (unsigned)(op - u->ops);
+}
+
+int strbuf_uring_write(strbuf_uring_s *u, int fd, strbuf_s *sb,
+		       size_t offset, size_t len, int64_t file_off,
+		       void *user)
+{
+	eembed_assert(u);
+	eembed_assert(sb);
+	struct strbuf_uring_op *op = strbuf_uring_op_get(u, fd, file_off, user);
+	if (!op) {
+		return -EBUSY;
+	}
+	int err = strbuf_uring_iov(op, sb, offset, len);
+	if (err) {
+		return err;
+	}
+	if (op->iovcnt == 1) {
+		op->fixed = strbuf_uring_fixed_index(u, op->iov);
+	}
+	strbuf_uring_op_queue(u, op);
+	return 0;
+}
+
+int strbuf_uring_writev(strbuf_uring_s *u, int fd, strbuf_s **sbs, size_t n,
+			int64_t file_off, void *user)
+{
+	eembed_assert(u);
+	eembed_assert(sbs || !n);
+	if (n > STRBUF_URING_MAX_BUFS) {
+		return -EINVAL;
+	}
+	struct strbuf_uring_op *op = strbuf_uring_op_get(u, fd, file_off, user);
+	if (!op) {
+		return -EBUSY;
+	}
+	for (size_t i = 0; i < n; ++i) {
+		int err = strbuf_uring_iov(op, sbs[i], 0, strbuf_len(sbs[i]));
+		if (err) {
+			return err;
+		}
+	}
+	strbuf_uring_op_queue(u, op);
+	return 0;
+}
+
+static void strbuf_uring_finish(strbuf_uring_s *u, unsigned idx, int64_t res)
+{
+	struct strbuf_uring_op *op = u->ops + idx;
+	op->res = res;
+	op->state = strbuf_uring_done;
+	unsigned tail = (u->done_head + u->done_len) % u->entries;
+	u->done_idx[tail] = idx;
+	++u->done_len;
+}
+
+static int64_t strbuf_uring_writev_now(struct strbuf_uring_op *op)
+{
+	ssize_t r;
+	if (op->file_off < 0) {
+		r = writev(op->fd, op->iov, op->iovcnt);
+	} else {
+		r = pwritev(op->fd, op->iov, op->iovcnt, (off_t)op->file_off);
+	}
+	return (r < 0) ? -errno : (int64_t)r;
+}
+
+#if Strbuf_io_uring
+static void strbuf_uring_prep(strbuf_uring_s *u, unsigned idx, unsigned tail)
+{
+	struct strbuf_uring_op *op = u->ops + idx;
+	unsigned at = tail & *u->sq_mask;
+	struct io_uring_sqe *sqe = u->sqes + at;
+	eembed_memset(sqe, 0x00, sizeof(*sqe));
+	sqe->fd = op->fd;
+	sqe->off = (uint64_t)op->file_off;
+	sqe->user_data = idx;
+	if (op->fixed >= 0) {
+		sqe->opcode = IORING_OP_WRITE_FIXED;
+		sqe->addr = (uint64_t)(uintptr_t)op->iov[0].iov_base;
+		sqe->len = (uint32_t)op->iov[0].iov_len;
+		sqe->buf_index = (uint16_t)op->fixed;
+	} else {
+		sqe->opcode = IORING_OP_WRITEV;
+		sqe->addr = (uint64_t)(uintptr_t)op->iov;
+		sqe->len = (uint32_t)op->iovcnt;
+	}
+	u->sq_array[at] = at;
+	op->state = strbuf_uring_in_flight;
+	++u->in_flight;
+}
+
+/* takes back the entries the kernel has not taken, and finishes them */
+static void strbuf_uring_unsubmit(strbuf_uring_s *u, int64_t res)
+{
+	unsigned tail = *u->sq_tail - u->sq_unsubmitted;
+	for (unsigned i = 0; i < u->sq_unsubmitted; ++i) {
+		unsigned at = u->sq_array[(tail + i) & *u->sq_mask];
+		--u->in_flight;
+		strbuf_uring_finish(u, (unsigned)u->sqes[at].user_data, res);
+	}
+	u->sq_unsubmitted = 0;
+	__atomic_store_n(u->sq_tail, tail, __ATOMIC_RELEASE);
+}
+
+/* passes the kernel all unsubmitted entries; if it can not take them
+   now, they are kept for the next call, but on any other error they are
+   finished with it. Returns the number taken, or -errno */
+static int strbuf_uring_enter(strbuf_uring_s *u, unsigned min_complete,
+			      unsigned flags)
+{
+	int r;
+	do {
+		r = strbuf_io_uring_enter(u->ring_fd, u->sq_unsubmitted,
+					  min_complete, flags);
+	} while (r < 0 && errno == EINTR);
+	if (r < 0) {
+		int err = errno;
+		if (err != EAGAIN && err != EBUSY) {
+			strbuf_uring_unsubmit(u, -err);
+		}
+		return -err;
+	}
+	u->sq_unsubmitted -= ((unsigned)r < u->sq_unsubmitted)
+	    ? (unsigned)r : u->sq_unsubmitted;
+	return r;
+}
+#endif /* #if Strbuf_io_uring */
+
+int strbuf_uring_submit(strbuf_uring_s *u)
+{
+	eembed_assert(u);
+	unsigned queued = u->queued_len;
+	u->queued_len = 0;
+	if (u->ring_fd < 0) {
+		for (unsigned i = 0; i < queued; ++i) {
+			unsigned idx = u->queued_idx[i];
+			strbuf_uring_finish(u, idx,
+					    strbuf_uring_writev_now(u->ops +
+								    idx));
+		}
+		return (int)queued;
+	}
+
+#if Strbuf_io_uring
+	unsigned tail = *u->sq_tail;
+	for (unsigned i = 0; i < queued; ++i) {
+		strbuf_uring_prep(u, u->queued_idx[i], tail++);
+	}
+	__atomic_store_n(u->sq_tail, tail, __ATOMIC_RELEASE);
+	u->sq_unsubmitted += queued;
+	return strbuf_uring_enter(u, 0, 0);
+#else
+	return -ENOSYS;
+#endif
+}
+
+#if Strbuf_io_uring
+static void strbuf_uring_cq_drain(strbuf_uring_s *u)
+{
+	unsigned head = *u->cq_head;
+	unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+	for (; head != tail; ++head) {
+		struct io_uring_cqe *cqe = u->cqes + (head & *u->cq_mask);
+		--u->in_flight;
+		strbuf_uring_finish(u, (unsigned)cqe->user_data, cqe->res);
+	}
+	__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+#endif
+
+size_t strbuf_uring_reap(strbuf_uring_s *u, strbuf_uring_done_s *done,
+			 size_t max, int wait)
+{
+	eembed_assert(u);
+	eembed_assert(done || !max);
+#if Strbuf_io_uring
+	if (u->ring_fd >= 0) {
+		strbuf_uring_cq_drain(u);
+		while (wait && !u->done_len && u->in_flight) {
+			int r = strbuf_uring_enter(u, 1,
+						   IORING_ENTER_GETEVENTS);
+			strbuf_uring_cq_drain(u);
+			if (r < 0) {
+				break;
+			}
+		}
+	}
+#else
+	(void)wait;
+#endif
+
+	size_t filled = 0;
+	while (filled < max && u->done_len) {
+		unsigned idx = u->done_idx[u->done_head];
+		struct strbuf_uring_op *op = u->ops + idx;
+		while (filled < max && u->done_pos < op->nsbs) {
+			done[filled].sb = op->sbs[u->done_pos++];
+			done[filled].user = op->user;
+			done[filled].res = op->res;
+			++filled;
+		}
+		if (u->done_pos < op->nsbs) {
+			break;
+		}
+		u->done_pos = 0;
+		u->done_head = (u->done_head + 1) % u->entries;
+		--u->done_len;
+		op->state = strbuf_uring_free;
+		u->free_idx[u->free_len++] = idx;
+	}
+	return filled;
+}
+
+size_t strbuf_uring_pending(strbuf_uring_s *u)
+{
+	eembed_assert(u);
+	return u->queued_len + u->in_flight;
+}
+
+#else /* #if EEMBED_HOSTED && (defined(__unix__) || defined(__APPLE__)) */
+
+/* not available: strbuf_uring_new returns NULL, so the others can only be
+   called with a NULL "u", and do nothing */
+strbuf_uring_s *strbuf_uring_new(struct eembed_allocator *ea,
+				 unsigned entries, unsigned flags)
+{
+	(void)ea;
+	(void)entries;
+	(void)flags;
+	return NULL;
+}
+
+void strbuf_uring_destroy(strbuf_uring_s *u)
+{
+	eembed_assert(!u);
+	(void)u;
+}
+
+int strbuf_uring_is_io_uring(strbuf_uring_s *u)
+{
+	eembed_assert(!u);
+	(void)u;
+	return 0;
+}
+
+int strbuf_uring_register(strbuf_uring_s *u, strbuf_s **sbs, size_t n)
+{
+	eembed_assert(!u);
+	(void)u;
+	(void)sbs;
+	(void)n;
+	return -1;
+}
+
+int strbuf_uring_write(strbuf_uring_s *u, int fd, strbuf_s *sb,
+		       size_t offset, size_t len, int64_t file_off,
+		       void *user)
+{
+	eembed_assert(!u);
+	(void)u;
+	(void)fd;
+	(void)sb;
+	(void)offset;
+	(void)len;
+	(void)file_off;
+	(void)user;
+	return -1;
+}
+
+int strbuf_uring_writev(strbuf_uring_s *u, int fd, strbuf_s **sbs, size_t n,
+			int64_t file_off, void *user)
+{
+	eembed_assert(!u);
+	(void)u;
+	(void)fd;
+	(void)sbs;
+	(void)n;
+	(void)file_off;
+	(void)user;
+	return -1;
+}
+
+int strbuf_uring_submit(strbuf_uring_s *u)
+{
+	eembed_assert(!u);
+	(void)u;
+	return -1;
+}
+
+size_t strbuf_uring_reap(strbuf_uring_s *u, strbuf_uring_done_s *done,
+			 size_t max, int wait)
+{
+	eembed_assert(!u);
+	(void)u;
+	(void)done;
+	(void)max;
+	(void)wait;
+	return 0;
+}
+
+size_t strbuf_uring_pending(strbuf_uring_s *u)
+{
+	eembed_assert(!u);
+	(void)u;
+	return 0;
+}
+
+#endif /* #if EEMBED_HOSTED && (defined(__unix__) || defined(__APPLE__)) */
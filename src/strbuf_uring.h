@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* strbuf_uring.h : batched writes of strbufs, io_uring on Linux */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#ifndef STRBUF_URING_H
+#define STRBUF_URING_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "strbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct strbuf_uring;
+typedef struct strbuf_uring strbuf_uring_s;
+
+/* the most strbufs one strbuf_uring_writev may write */
+#define STRBUF_URING_MAX_BUFS 16
+
+/* for strbuf_uring_new: do not try io_uring, use writev(2) */
+#define STRBUF_URING_NO_IO_URING 1
+
+/* one per strbuf written; "res" is as from write(2): the bytes the whole
+   operation wrote, which may be short, or -errno */
+typedef struct strbuf_uring_done {
+	strbuf_s *sb;
+	void *user;
+	int64_t res;
+} strbuf_uring_done_s;
+
+/* room for "entries" operations in flight; if io_uring is not available,
+   as on hosts other than Linux, strbuf_uring_submit does the writes
+   itself, with writev(2). Returns NULL if out of memory, if "allocator" is
+   NULL and there is no default, or if the host is not POSIX */
+strbuf_uring_s *strbuf_uring_new(struct eembed_allocator *allocator,
+				 unsigned entries, unsigned flags);
+
+/* waits for any writes in flight */
+void strbuf_uring_destroy(strbuf_uring_s *u);
+
+/* non-zero if the writes go through io_uring */
+int strbuf_uring_is_io_uring(strbuf_uring_s *u);
+
+/* registers the buffers of pooled strbufs, so that writes of them need
+   not map the pages each time; each must keep its buffer, typically as it
+   is strbuf_no_grow, until strbuf_uring_destroy. Returns 0 or -errno */
+int strbuf_uring_register(strbuf_uring_s *u, strbuf_s **sbs, size_t n);
+
+/* queue a write of "len" bytes from "offset" of the string, at "file_off"
+   or, if it is -1, at the current file position. Until the strbuf is
+   returned by strbuf_uring_reap, it must not be changed or destroyed.
+   Queued operations may complete in any order, even on the same fd; to
+   keep output in order, write it with one strbuf_uring_writev. Returns 0,
+   or -EBUSY if the queue is full, or -EINVAL */
+int strbuf_uring_write(strbuf_uring_s *u, int fd, strbuf_s *sb,
+		       size_t offset, size_t len, int64_t file_off,
+		       void *user);
+
+/* queue one write of all of "n" strbufs, in order */
+int strbuf_uring_writev(strbuf_uring_s *u, int fd, strbuf_s **sbs, size_t n,
+			int64_t file_off, void *user);
+
+/* starts all queued writes with a single system call; returns the number
+   started, or -errno. Writes the kernel could not yet take, as with
+   -EAGAIN or -EBUSY, are started by the next strbuf_uring_submit or
+   strbuf_uring_reap; on any other error, they are reaped with it */
+int strbuf_uring_submit(strbuf_uring_s *u);
+
+/* fills "done" with up to "max" strbufs whose writes have finished, and
+   which may be used again; if "wait" and none are ready but some are in
+   flight, blocks for at least one. Returns the number filled */
+size_t strbuf_uring_reap(strbuf_uring_s *u, strbuf_uring_done_s *done,
+			 size_t max, int wait);
+
+/* the operations queued or in flight */
+size_t strbuf_uring_pending(strbuf_uring_s *u);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef STRBUF_URING_H */
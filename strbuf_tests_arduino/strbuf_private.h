@@ -0,0 +1 @@
+../src/strbuf_private.h
\ No newline at end of file
@@ -12,13 +12,33 @@ unsigned test_append_int(void);
 unsigned test_append_uint(void);
 unsigned test_append(void);
 unsigned test_avail(void);
+unsigned test_base64(void);
+unsigned test_escape(void);
 unsigned test_new_no_grow(void);
 unsigned test_prepend_float(void);
 unsigned test_prepend_int(void);
 unsigned test_prepend_uint(void);
 unsigned test_prepend(void);
+unsigned test_sizehint(void);
 unsigned test_trim(void);
+unsigned test_utf8(void);
+unsigned test_case(void);
+unsigned test_hash(void);
+unsigned test_intern(void);
+unsigned test_cmp(void);
+unsigned test_fmt(void);
+unsigned test_parse(void);
+unsigned test_insert(void);
+unsigned test_clone(void);
+unsigned test_take(void);
+unsigned test_ring(void);
+unsigned test_consume(void);
+unsigned test_reserve_tail(void);
+unsigned test_glob(void);
+unsigned test_redact(void);
+unsigned test_expand(void);
 unsigned test_expose_return(void);
+unsigned test_json(void);
 
 void setup(void)
 {
@@ -67,13 +87,33 @@ void loop(void)
 	failures += Test_func(test_append_uint);
 	failures += Test_func(test_append);
 	failures += Test_func(test_avail);
+	failures += Test_func(test_base64);
+	failures += Test_func(test_escape);
 	failures += Test_func(test_expose_return);
+	failures += Test_func(test_json);
 	failures += Test_func(test_new_no_grow);
 	failures += Test_func(test_prepend_float);
 	failures += Test_func(test_prepend_int);
 	failures += Test_func(test_prepend_uint);
 	failures += Test_func(test_prepend);
+	failures += Test_func(test_sizehint);
 	failures += Test_func(test_trim);
+	failures += Test_func(test_utf8);
+	failures += Test_func(test_case);
+	failures += Test_func(test_hash);
+	failures += Test_func(test_intern);
+	failures += Test_func(test_cmp);
+	failures += Test_func(test_fmt);
+	failures += Test_func(test_parse);
+	failures += Test_func(test_insert);
+	failures += Test_func(test_clone);
+	failures += Test_func(test_take);
+	failures += Test_func(test_ring);
+	failures += Test_func(test_consume);
+	failures += Test_func(test_reserve_tail);
+	failures += Test_func(test_glob);
+	failures += Test_func(test_redact);
+	failures += Test_func(test_expand);
 
 	Serial.println("=================================================");
 	if (failures) {
@@ -0,0 +1 @@
+../tests/test-base64.c
\ No newline at end of file
@@ -0,0 +1 @@
+../tests/test-case.c
\ No newline at end of file
@@ -0,0 +1 @@
+../tests/test-clone.c
\ No newline at end of file
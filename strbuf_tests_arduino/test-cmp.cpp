@@ -0,0 +1 @@
+../tests/test-cmp.c
\ No newline at end of file
@@ -0,0 +1 @@
+../tests/test-consume.c
\ No newline at end of file
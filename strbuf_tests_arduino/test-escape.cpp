@@ -0,0 +1 @@
+../tests/test-escape.c
\ No newline at end of file
@@ -0,0 +1 @@
+../tests/test-expand.c
\ No newline at end of file
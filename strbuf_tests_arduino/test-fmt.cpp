@@ -0,0 +1 @@
+../tests/test-fmt.c
\ No newline at end of file
@@ -0,0 +1 @@
+../tests/test-glob.c
\ No newline at end of file
@@ -0,0 +1 @@
+../tests/test-hash.c
\ No newline at end of file
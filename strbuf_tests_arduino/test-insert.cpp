@@ -0,0 +1 @@
+../tests/test-insert.c
\ No newline at end of file
@@ -0,0 +1 @@
+../tests/test-intern.c
\ No newline at end of file
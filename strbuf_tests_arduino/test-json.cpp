@@ -0,0 +1 @@
+../tests/test-json.c
\ No newline at end of file
@@ -0,0 +1 @@
+../tests/test-parse.c
\ No newline at end of file
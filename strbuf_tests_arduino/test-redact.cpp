@@ -0,0 +1 @@
+../tests/test-redact.c
\ No newline at end of file
@@ -0,0 +1 @@
+../tests/test-reserve-tail.c
\ No newline at end of file
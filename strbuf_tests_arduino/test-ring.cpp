@@ -0,0 +1 @@
+../tests/test-ring.c
\ No newline at end of file
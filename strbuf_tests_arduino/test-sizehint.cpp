@@ -0,0 +1 @@
+../tests/test-sizehint.c
\ No newline at end of file
@@ -0,0 +1 @@
+../tests/test-take.c
\ No newline at end of file
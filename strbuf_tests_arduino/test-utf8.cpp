@@ -0,0 +1 @@
+../tests/test-utf8.c
\ No newline at end of file
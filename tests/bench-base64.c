@@ -0,0 +1,102 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-base64.c: base64 and hex appenders, 1 KiB to 16 MiB */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* a byte at a time encoder into a separate buffer, then appended */
+static void naive_base64(strbuf_s *sb, const unsigned char *in, size_t len,
+			 char *tmp)
+{
+	const char *chars =
+	    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t j = 0;
+	unsigned bits = 0;
+	unsigned nbits = 0;
+	for (size_t i = 0; i < len; ++i) {
+		bits = (bits << 8) | in[i];
+		nbits += 8;
+		while (nbits >= 6) {
+			nbits -= 6;
+			tmp[j++] = chars[(bits >> nbits) & 0x3F];
+		}
+	}
+	if (nbits) {
+		tmp[j++] = chars[(bits << (6 - nbits)) & 0x3F];
+	}
+	while (j % 4) {
+		tmp[j++] = '=';
+	}
+	strbuf_append(sb, tmp, j);
+}
+
+static void bench_size(size_t len)
+{
+	unsigned char *data = (unsigned char *)malloc(len);
+	char *tmp = (char *)malloc(((len + 2) / 3) * 4 + 1);
+	for (size_t i = 0; i < len; ++i) {
+		data[i] = (unsigned char)((i * 131) ^ (i >> 7));
+	}
+	size_t loops = (64 * 1024 * 1024) / len;
+	strbuf_s *sb = strbuf_new(NULL, 0);
+	strbuf_s *out = strbuf_new(NULL, 0);
+	double mib = ((double)len * loops) / (1024.0 * 1024.0);
+
+	clock_t begin = clock();
+	for (size_t i = 0; i < loops; ++i) {
+		strbuf_set(sb, "", 0);
+		naive_base64(sb, data, len, tmp);
+	}
+	double naive = seconds(begin, clock());
+
+	begin = clock();
+	for (size_t i = 0; i < loops; ++i) {
+		strbuf_set(sb, "", 0);
+		strbuf_append_base64(sb, data, len);
+	}
+	double enc = seconds(begin, clock());
+
+	begin = clock();
+	for (size_t i = 0; i < loops; ++i) {
+		strbuf_set(out, "", 0);
+		strbuf_append_base64_decoded(out, strbuf_str(sb),
+					     strbuf_len(sb));
+	}
+	double dec = seconds(begin, clock());
+
+	begin = clock();
+	for (size_t i = 0; i < loops; ++i) {
+		strbuf_set(sb, "", 0);
+		strbuf_append_hex(sb, data, len);
+	}
+	double hex = seconds(begin, clock());
+
+	begin = clock();
+	for (size_t i = 0; i < loops; ++i) {
+		strbuf_set(out, "", 0);
+		strbuf_append_hex_decoded(out, strbuf_str(sb), strbuf_len(sb));
+	}
+	double hexd = seconds(begin, clock());
+
+	printf("%9zu bytes: naive %7.0f, base64 %7.0f, decode %7.0f,"
+	       " hex %7.0f, decode %7.0f MiB/s\n", len, mib / naive,
+	       mib / enc, mib / dec, mib / hex, mib / hexd);
+
+	strbuf_destroy(out);
+	strbuf_destroy(sb);
+	free(tmp);
+	free(data);
+}
+
+int main(void)
+{
+	bench_size(1024);
+	bench_size(64 * 1024);
+	bench_size(16 * 1024 * 1024);
+	return 0;
+}
@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-consume.c: parsing small messages from the front of a stream */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define Bench_reads 2000
+#define Bench_msg "PING 0123456789abcdef\n"
+#define Bench_msgs_per_read 40
+
+/* each read brings many messages, but the parser is behind by a lot */
+static void fill(strbuf_s *sb)
+{
+	for (size_t i = 0; i < Bench_msgs_per_read; ++i) {
+		strbuf_append(sb, Bench_msg, strlen(Bench_msg));
+	}
+}
+
+static size_t parse_one(strbuf_s *sb)
+{
+	const char *s = strbuf_str(sb);
+	const char *nl = strchr(s, '\n');
+	return nl ? (size_t)(nl - s) + 1 : 0;
+}
+
+int main(void)
+{
+	size_t backlog = 200;
+	size_t parsed = 0;
+	strbuf_s *sb = strbuf_new(NULL, 0);
+	for (size_t i = 0; i < backlog; ++i) {
+		fill(sb);
+	}
+	clock_t begin = clock();
+	for (size_t i = 0; i < Bench_reads; ++i) {
+		fill(sb);
+		for (size_t j = 0; j < Bench_msgs_per_read; ++j) {
+			size_t n = parse_one(sb);
+			const char *s = strbuf_str(sb);
+			strbuf_set(sb, s + n, strbuf_len(sb) - n);
+			parsed += n ? 1 : 0;
+		}
+	}
+	double set = seconds(begin, clock());
+	size_t expect_len = strbuf_len(sb);
+	strbuf_destroy(sb);
+
+	sb = strbuf_new(NULL, 0);
+	for (size_t i = 0; i < backlog; ++i) {
+		fill(sb);
+	}
+	begin = clock();
+	for (size_t i = 0; i < Bench_reads; ++i) {
+		fill(sb);
+		for (size_t j = 0; j < Bench_msgs_per_read; ++j) {
+			size_t n = parse_one(sb);
+			strbuf_consume(sb, n);
+			parsed -= n ? 1 : 0;
+		}
+	}
+	double consume = seconds(begin, clock());
+
+	printf("%d reads of %d messages: strbuf_set remainder %.3f s,"
+	       " strbuf_consume %.3f s, %.0fx%s\n", Bench_reads,
+	       Bench_msgs_per_read, set, consume, set / consume,
+	       (parsed || strbuf_len(sb) != expect_len)
+	       ? " (results differ)" : "");
+
+	strbuf_destroy(sb);
+	return 0;
+}
@@ -0,0 +1,99 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-expand.c: rendering a template with variables */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define Bench_vars 12
+#define Bench_renders 20000
+
+static char names[Bench_vars][16];
+static char values[Bench_vars][32];
+
+static const char *lookup(void *ctx, const char *name, size_t name_len,
+			  size_t *value_len)
+{
+	(void)ctx;
+	for (size_t i = 0; i < Bench_vars; ++i) {
+		if (strlen(names[i]) == name_len
+		    && memcmp(names[i], name, name_len) == 0) {
+			*value_len = strlen(values[i]);
+			return values[i];
+		}
+	}
+	return NULL;
+}
+
+/* find and replace, once per variable */
+static void render_chained(strbuf_s *sb, const char *tmpl, size_t len)
+{
+	strbuf_set(sb, tmpl, len);
+	for (size_t i = 0; i < Bench_vars; ++i) {
+		char key[24];
+		size_t key_len = (size_t)snprintf(key, 24, "${%s}", names[i]);
+		size_t value_len = strlen(values[i]);
+		const char *s = strbuf_str(sb);
+		for (const char *p = strstr(s, key); p; p = strstr(s, key)) {
+			size_t pos = (size_t)(p - s);
+			strbuf_replace_range(sb, pos, key_len, values[i],
+					     value_len);
+			s = strbuf_str(sb);
+		}
+	}
+}
+
+int main(void)
+{
+	char tmpl[2048];
+	size_t len = 0;
+	for (size_t i = 0; i < Bench_vars; ++i) {
+		snprintf(names[i], 16, "var_%zu", i);
+		snprintf(values[i], 32, "value number %zu", i * 31);
+	}
+	for (size_t i = 0; i < 3 * Bench_vars; ++i) {
+		const char *name = names[(i * 5) % Bench_vars];
+		len += (size_t)snprintf(tmpl + len, sizeof(tmpl) - len,
+					"literal text for line %zu: ${%s}\n",
+					i, name);
+	}
+
+	strbuf_s *chained = strbuf_new(NULL, 0);
+	clock_t begin = clock();
+	for (size_t i = 0; i < Bench_renders; ++i) {
+		render_chained(chained, tmpl, len);
+	}
+	double chain = seconds(begin, clock());
+
+	strbuf_s *sb = strbuf_new(NULL, 0);
+	begin = clock();
+	for (size_t i = 0; i < Bench_renders; ++i) {
+		strbuf_set(sb, "", 0);
+		strbuf_expand(sb, tmpl, len, lookup, NULL);
+	}
+	double expand = seconds(begin, clock());
+
+	strbuf_template_s *t = strbuf_template_compile(tmpl, len);
+	begin = clock();
+	for (size_t i = 0; i < Bench_renders; ++i) {
+		strbuf_set(sb, "", 0);
+		strbuf_template_expand(sb, t, lookup, NULL);
+	}
+	double compiled = seconds(begin, clock());
+
+	printf("%d renders of %zu bytes: find/replace %.3f s,"
+	       " strbuf_expand %.3f s (%.0fx), compiled %.3f s (%.0fx)%s\n",
+	       Bench_renders, len, chain, expand, chain / expand, compiled,
+	       chain / compiled,
+	       strcmp(strbuf_str(chained), strbuf_str(sb)) ?
+	       " (results differ)" : "");
+
+	strbuf_template_destroy(t);
+	strbuf_destroy(sb);
+	strbuf_destroy(chained);
+	return 0;
+}
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-fmt.c: a log line via strbuf_append_f and strbuf_append_fmt */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define Bench_lines (2 * 1000 * 1000)
+
+static void bench(const char *name, const char *format, int with_double)
+{
+	const char *levels[] = { "INFO", "WARN", "DEBUG", "ERROR" };
+	strbuf_s *sb = strbuf_new(NULL, 0);
+	strbuf_fmt_s *prog = strbuf_fmt_compile(format);
+	size_t bytes = 0;
+
+	clock_t begin = clock();
+	for (unsigned i = 0; i < Bench_lines; ++i) {
+		strbuf_set(sb, "", 0);
+		if (with_double) {
+			strbuf_append_f(sb, 120, format, levels[i % 4], i,
+					i * 2654435761u, (double)i / 7.0);
+		} else {
+			strbuf_append_f(sb, 120, format, levels[i % 4], i,
+					i * 2654435761u, i % 1000);
+		}
+		bytes += strbuf_len(sb);
+	}
+	double printf_secs = seconds(begin, clock());
+
+	begin = clock();
+	for (unsigned i = 0; i < Bench_lines; ++i) {
+		strbuf_set(sb, "", 0);
+		if (with_double) {
+			strbuf_append_fmt(sb, prog, levels[i % 4], i,
+					  i * 2654435761u, (double)i / 7.0);
+		} else {
+			strbuf_append_fmt(sb, prog, levels[i % 4], i,
+					  i * 2654435761u, i % 1000);
+		}
+		bytes -= strbuf_len(sb);
+	}
+	double fmt_secs = seconds(begin, clock());
+
+	printf("%-8s append_f %.3f s, append_fmt %.3f s, %.2fx%s\n", name,
+	       printf_secs, fmt_secs, printf_secs / fmt_secs,
+	       bytes ? " (output differs)" : "");
+
+	strbuf_fmt_destroy(prog);
+	strbuf_destroy(sb);
+}
+
+int main(void)
+{
+	bench("ints", "[%-5s] req=%u id=%08x status=%03u\n", 0);
+	bench("double", "[%-5s] req=%u id=%08x took=%.3fms\n", 1);
+	return 0;
+}
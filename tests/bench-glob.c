@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-glob.c: routing request paths through many patterns */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "bench.h"
+
+#include <fnmatch.h>
+#include <stdio.h>
+#include <time.h>
+
+#define Bench_patterns 200
+#define Bench_paths 20000
+
+int main(void)
+{
+	static char pattern_mem[Bench_patterns][64];
+	const char *patterns[Bench_patterns];
+	for (size_t i = 0; i < Bench_patterns; ++i) {
+		const char *forms[] = { "/api/v%zu/*/items/*", "*/res%zu.json",
+			"/static/%zu/*.[jc]ss", "/user/%zu/?*/profile"
+		};
+		snprintf(pattern_mem[i], 64, forms[i % 4], i);
+		patterns[i] = pattern_mem[i];
+	}
+
+	strbuf_s *paths[16];
+	for (size_t i = 0; i < 16; ++i) {
+		paths[i] = strbuf_new(NULL, 0);
+		strbuf_append_f(paths[i], 80, "/api/v%zu/shop/items/%zu",
+				i * 13, i * 977);
+	}
+	strbuf_set(paths[3], "/static/8/site.css", 18);
+	strbuf_set(paths[7], "/x/y/res41.json", 15);
+
+	size_t fn_hits = 0;
+	clock_t begin = clock();
+	for (size_t i = 0; i < Bench_paths; ++i) {
+		const char *path = strbuf_str(paths[i % 16]);
+		for (size_t j = 0; j < Bench_patterns; ++j) {
+			fn_hits += (fnmatch(patterns[j], path, 0) == 0) ? 1 : 0;
+		}
+	}
+	double fn = seconds(begin, clock());
+
+	strbuf_glob_set_s *set = strbuf_glob_set_compile(patterns,
+							 Bench_patterns);
+	size_t set_hits = 0;
+	begin = clock();
+	for (size_t i = 0; i < Bench_paths; ++i) {
+		set_hits += strbuf_glob_set_match(set, paths[i % 16], NULL, 0);
+	}
+	double globbed = seconds(begin, clock());
+
+	printf("%d paths against %d patterns: fnmatch %.3f s,"
+	       " strbuf_glob_set %.3f s, %.0fx%s\n", Bench_paths,
+	       Bench_patterns, fn, globbed, fn / globbed,
+	       (fn_hits != set_hits) ? " (results differ)" : "");
+
+	strbuf_glob_set_destroy(set);
+	for (size_t i = 0; i < 16; ++i) {
+		strbuf_destroy(paths[i]);
+	}
+	return 0;
+}
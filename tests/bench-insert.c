@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-insert.c: local edits in a large document */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define Bench_doc_size (1024 * 1024)
+#define Bench_edits 20000
+
+/* with room for the edits, which the emulation cannot grow in to */
+static strbuf_s *make_doc(void)
+{
+	strbuf_s *sb = strbuf_new(NULL, 0);
+	strbuf_append_f(sb, 2 * Bench_doc_size, "%*s", 2 * Bench_doc_size, "");
+	strbuf_set(sb, "", 0);
+	while (strbuf_len(sb) < Bench_doc_size) {
+		strbuf_append(sb, "lorem ipsum {{name}} dolor sit amet\n", 36);
+	}
+	return sb;
+}
+
+/* a templating pass: walking forward, replacing a token in each line */
+int main(void)
+{
+	strbuf_s *sb = make_doc();
+	size_t pos = 12;
+	clock_t begin = clock();
+	for (size_t i = 0; i < Bench_edits; ++i) {
+		size_t size = 0;
+		char *buf = strbuf_expose(sb, &size);
+		size_t len = strlen(buf);
+		if (len + 9 >= size) {
+			strbuf_return(sb);
+			break;
+		}
+		/* "{{name}}" is 8 bytes, "Margaret Hamilton" is 17 */
+		memmove(buf + pos + 17, buf + pos + 8, len - pos - 8 + 1);
+		memcpy(buf + pos, "Margaret Hamilton", 17);
+		strbuf_return(sb);
+		pos += 36 + 9;
+	}
+	double emulated = seconds(begin, clock());
+	strbuf_s *expect = sb;
+
+	sb = make_doc();
+	pos = 12;
+	begin = clock();
+	for (size_t i = 0; i < Bench_edits; ++i) {
+		strbuf_replace_range(sb, pos, 8, "Margaret Hamilton", 17);
+		pos += 36 + 9;
+	}
+	strbuf_str(sb);
+	double gap = seconds(begin, clock());
+
+	printf("%d edits: expose/memmove/return %.3f s,"
+	       " strbuf_replace_range %.3f s, %.0fx%s\n", Bench_edits,
+	       emulated, gap, emulated / gap,
+	       strbuf_cmp(sb, strbuf_str(expect), strbuf_len(expect))
+	       ? " (results differ)" : "");
+
+	strbuf_destroy(expect);
+	strbuf_destroy(sb);
+	return 0;
+}
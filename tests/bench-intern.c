@@ -0,0 +1,98 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-intern.c: a Zipf distributed stream of label names */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define Bench_labels 4096
+#define Bench_stream (1024 * 1024)
+
+/* label indexes with P(k) proportional to 1/(k+1) */
+static void zipf_stream(size_t *stream, size_t len)
+{
+	double *cdf = (double *)malloc(sizeof(double) * Bench_labels);
+	double total = 0.0;
+	for (size_t k = 0; k < Bench_labels; ++k) {
+		total += 1.0 / (double)(k + 1);
+		cdf[k] = total;
+	}
+	srand(42);
+	for (size_t i = 0; i < len; ++i) {
+		double r = total * ((double)rand() / ((double)RAND_MAX + 1.0));
+		size_t lo = 0;
+		size_t hi = Bench_labels - 1;
+		while (lo < hi) {
+			size_t mid = (lo + hi) / 2;
+			if (cdf[mid] <= r) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		stream[i] = lo;
+	}
+	free(cdf);
+}
+
+int main(void)
+{
+	char names[Bench_labels][40];
+	size_t lens[Bench_labels];
+	for (size_t k = 0; k < Bench_labels; ++k) {
+		int len = snprintf(names[k], 40, "http_request_label_%zu", k);
+		lens[k] = (size_t)len;
+	}
+	size_t *stream = (size_t *)malloc(sizeof(size_t) * Bench_stream);
+	strbuf_s **held;
+	held = (strbuf_s **)malloc(sizeof(strbuf_s *) * Bench_stream);
+	zipf_stream(stream, Bench_stream);
+
+	/* each occurrence becomes its own strbuf, held until the end */
+	size_t bytes = 0;
+	clock_t begin = clock();
+	for (size_t i = 0; i < Bench_stream; ++i) {
+		size_t k = stream[i];
+		held[i] = strbuf_new(names[k], lens[k]);
+		bytes += strbuf_struct_size() + lens[k] + 1;
+	}
+	for (size_t i = 0; i < Bench_stream; ++i) {
+		strbuf_destroy(held[i]);
+	}
+	double plain = seconds(begin, clock());
+	size_t plain_allocs = 2 * (size_t)Bench_stream;
+	size_t plain_bytes = bytes;
+
+	strbuf_intern_s *table = strbuf_intern_new(NULL, 8);
+	begin = clock();
+	for (size_t i = 0; i < Bench_stream; ++i) {
+		size_t k = stream[i];
+		held[i] = strbuf_intern(table, names[k], lens[k]);
+	}
+	size_t unique = strbuf_intern_count(table);
+	for (size_t i = 0; i < Bench_stream; ++i) {
+		strbuf_intern_release(table, held[i]);
+	}
+	double interned = seconds(begin, clock());
+	strbuf_intern_destroy(table);
+
+	bytes = 0;
+	for (size_t k = 0; k < Bench_labels; ++k) {
+		bytes += strbuf_struct_size() + sizeof(size_t) + lens[k] + 1;
+	}
+
+	printf("%d labels, %d occurrences, %zu distinct\n", Bench_labels,
+	       Bench_stream, unique);
+	printf("strbuf_new:    %.3f s, %zu allocations, %zu bytes held\n",
+	       plain, plain_allocs, plain_bytes);
+	printf("strbuf_intern: %.3f s, %zu allocations, < %zu bytes held\n",
+	       interned, unique, bytes);
+
+	free(held);
+	free(stream);
+	return 0;
+}
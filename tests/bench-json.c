@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-json.c: strbuf_json_s compared to an snprintf based emitter */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define Bench_loops 200000
+
+static const char *msg = "user \"admin\" logged in from\t10.0.0.1";
+
+static size_t emit_snprintf(strbuf_s *sb, unsigned i)
+{
+	char buf[256];
+	char esc[128];
+	size_t j = 0;
+	for (const char *s = msg; *s && j < sizeof(esc) - 7; ++s) {
+		if (*s == '"' || *s == '\\') {
+			esc[j++] = '\\';
+			esc[j++] = *s;
+		} else if ((unsigned char)*s < 0x20) {
+			j += (size_t)snprintf(esc + j, 7, "\\u%04x", *s);
+		} else {
+			esc[j++] = *s;
+		}
+	}
+	esc[j] = '\0';
+	int len = snprintf(buf, sizeof(buf),
+			   "{\"seq\":%u,\"level\":\"%s\",\"msg\":\"%s\","
+			   "\"ok\":%s,\"lat\":%.15g,\"tags\":[%d,%d,%d]}",
+			   i, "info", esc, (i & 1) ? "true" : "false",
+			   i * 0.25, -1, 2, -3);
+	strbuf_set(sb, "", 0);
+	strbuf_append(sb, buf, (size_t)len);
+	return strbuf_len(sb);
+}
+
+static size_t emit_json(strbuf_s *sb, unsigned i)
+{
+	strbuf_json_s json;
+	strbuf_set(sb, "", 0);
+	strbuf_json_init(&json, sb);
+	strbuf_json_object_begin(&json);
+	strbuf_json_key(&json, "seq", 3);
+	strbuf_json_uint(&json, i);
+	strbuf_json_key(&json, "level", 5);
+	strbuf_json_string(&json, "info", 4);
+	strbuf_json_key(&json, "msg", 3);
+	strbuf_json_string(&json, msg, strlen(msg));
+	strbuf_json_key(&json, "ok", 2);
+	strbuf_json_bool(&json, i & 1);
+	strbuf_json_key(&json, "lat", 3);
+	strbuf_json_double(&json, i * 0.25);
+	strbuf_json_key(&json, "tags", 4);
+	strbuf_json_array_begin(&json);
+	strbuf_json_int(&json, -1);
+	strbuf_json_int(&json, 2);
+	strbuf_json_int(&json, -3);
+	strbuf_json_array_end(&json);
+	strbuf_json_object_end(&json);
+	return strbuf_len(sb);
+}
+
+static double bench(const char *name, size_t (*emit)(strbuf_s *, unsigned))
+{
+	strbuf_s *sb = strbuf_new(NULL, 0);
+	size_t total = 0;
+	clock_t begin = clock();
+	for (unsigned i = 0; i < Bench_loops; ++i) {
+		total += emit(sb, i);
+	}
+	clock_t end = clock();
+	double secs = ((double)(end - begin)) / CLOCKS_PER_SEC;
+	printf("%-10s %u records, %zu bytes, %.3f sec, %.0f ns/record\n",
+	       name, Bench_loops, total, secs, (secs * 1e9) / Bench_loops);
+	strbuf_destroy(sb);
+	return secs;
+}
+
+int main(void)
+{
+	double a = bench("snprintf", emit_snprintf);
+	double b = bench("strbuf_json", emit_json);
+	printf("speedup: %.2fx\n", b > 0 ? a / b : 0.0);
+	return 0;
+}
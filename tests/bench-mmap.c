@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-mmap.c: growing a very large buffer */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "bench.h"
+#include "strbuf_mmap.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define Bench_max_size (256 * 1024 * 1024)
+
+static void fill(strbuf_s *sb, size_t *size)
+{
+	char *buf = strbuf_expose(sb, size);
+	for (size_t i = eembed_strlen(buf); i + 1 < *size; ++i) {
+		buf[i] = (char)('a' + (i % 26));
+	}
+	strbuf_return(sb);
+}
+
+/* a full buffer grows on the next append; only those appends are timed */
+static double grow_all(struct eembed_allocator *ea)
+{
+	strbuf_s *sb = strbuf_new_custom(ea, NULL, 0, NULL, 0);
+	strbuf_grow_by_realloc(sb, ea != NULL);
+	double elapsed = 0.0;
+	size_t size = 0;
+	fill(sb, &size);
+	while (size < Bench_max_size) {
+		clock_t begin = clock();
+		if (!strbuf_append(sb, "!", 1)) {
+			break;
+		}
+		elapsed += seconds(begin, clock());
+		fill(sb, &size);
+	}
+	strbuf_destroy(sb);
+	return elapsed;
+}
+
+int main(void)
+{
+	double plain = grow_all(NULL);
+
+	struct strbuf_mmap_allocator ma;
+	struct eembed_allocator *ea =
+	    strbuf_mmap_allocator(&ma, NULL, STRBUF_MMAP_THRESHOLD_DEFAULT,
+				  STRBUF_MMAP_HUGE_PAGES);
+	double mapped = grow_all(ea);
+
+	printf("growing a full buffer to %d bytes: malloc %.3f s,"
+	       " mremap %.3f s\n", Bench_max_size, plain, mapped);
+
+	return 0;
+}
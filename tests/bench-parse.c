@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-parse.c: strbuf_parse_* against strtoll and strtod */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define Bench_fields 4096
+#define Bench_rounds 500
+
+/* a line of comma separated fields, and the offset of each */
+static strbuf_s *make_line(size_t *offsets, int doubles)
+{
+	strbuf_s *sb = strbuf_new(NULL, 0);
+	srand(7);
+	for (size_t i = 0; i < Bench_fields; ++i) {
+		offsets[i] = strbuf_len(sb);
+		long long r = ((long long)rand() << 20) ^ rand();
+		if (doubles) {
+			strbuf_append_f(sb, 40, "%.*f,", (int)(i % 7),
+					(double)(r % 100000000) / 1000.0);
+		} else {
+			strbuf_append_f(sb, 40, "%lld,", (i % 3) ? r : -r);
+		}
+	}
+	return sb;
+}
+
+int main(void)
+{
+	size_t offsets[Bench_fields];
+	const char *s;
+	char *end;
+
+	strbuf_s *sb = make_line(offsets, 0);
+	s = strbuf_str(sb);
+	long long isum = 0;
+	clock_t begin = clock();
+	for (size_t r = 0; r < Bench_rounds; ++r) {
+		for (size_t i = 0; i < Bench_fields; ++i) {
+			isum += strtoll(s + offsets[i], &end, 10);
+		}
+	}
+	double libc = seconds(begin, clock());
+	int64_t i64;
+	begin = clock();
+	for (size_t r = 0; r < Bench_rounds; ++r) {
+		for (size_t i = 0; i < Bench_fields; ++i) {
+			strbuf_parse_int64(sb, offsets[i], 32, &i64);
+			isum -= i64;
+		}
+	}
+	double ours = seconds(begin, clock());
+	printf("int64:  strtoll %.3f s, strbuf_parse_int64 %.3f s, %.2fx%s\n",
+	       libc, ours, libc / ours, isum ? " (results differ)" : "");
+	strbuf_destroy(sb);
+
+	sb = make_line(offsets, 1);
+	s = strbuf_str(sb);
+	double d = 0;
+	begin = clock();
+	for (size_t r = 0; r < Bench_rounds; ++r) {
+		for (size_t i = 0; i < Bench_fields; ++i) {
+			d += strtod(s + offsets[i], &end);
+		}
+	}
+	libc = seconds(begin, clock());
+	begin = clock();
+	for (size_t r = 0; r < Bench_rounds; ++r) {
+		for (size_t i = 0; i < Bench_fields; ++i) {
+			strbuf_parse_double(sb, offsets[i], 32, &d);
+		}
+	}
+	ours = seconds(begin, clock());
+	size_t differ = 0;
+	for (size_t i = 0; i < Bench_fields; ++i) {
+		strbuf_parse_double(sb, offsets[i], 32, &d);
+		differ += (d != strtod(s + offsets[i], &end)) ? 1 : 0;
+	}
+	printf("double: strtod  %.3f s, strbuf_parse_double %.3f s, %.2fx%s\n",
+	       libc, ours, libc / ours, differ ? " (results differ)" : "");
+	strbuf_destroy(sb);
+
+	return 0;
+}
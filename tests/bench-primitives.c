@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-primitives.c: the copying under append, prepend and set */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define Bench_bytes (64 * 1024 * 1024)
+
+int main(void)
+{
+	static char text[4096];
+	for (size_t i = 0; i < sizeof(text) - 1; ++i) {
+		text[i] = (char)('a' + (i % 26));
+	}
+	const size_t sizes[] = { 16, 256, 4000 };
+	strbuf_s *sb = strbuf_new(NULL, 0);
+	size_t total = 0;
+
+	for (size_t j = 0; j < 3; ++j) {
+		size_t len = sizes[j];
+		size_t loops = Bench_bytes / len;
+
+		/* appending in to a buffer which is already big */
+		clock_t begin = clock();
+		for (size_t i = 0; i < loops; ++i) {
+			if ((i % 64) == 0) {
+				strbuf_set(sb, "", 0);
+			}
+			strbuf_append(sb, text, len);
+		}
+		double append = seconds(begin, clock());
+		total += strbuf_len(sb);
+
+		begin = clock();
+		for (size_t i = 0; i < loops; ++i) {
+			if ((i % 8) == 0) {
+				strbuf_set(sb, "", 0);
+			}
+			strbuf_prepend(sb, text, len);
+		}
+		double prepend = seconds(begin, clock());
+		total += strbuf_len(sb);
+
+		begin = clock();
+		for (size_t i = 0; i < loops; ++i) {
+			strbuf_set(sb, text + (i % 8), len);
+		}
+		double set = seconds(begin, clock());
+		total += strbuf_len(sb);
+
+		printf("%4zu byte strings, %8zu of each: append %.3f s,"
+		       " prepend %.3f s, set %.3f s\n", len, loops, append,
+		       prepend, set);
+	}
+
+	strbuf_destroy(sb);
+	return total ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-redact.c: masking many secrets in log lines */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define Bench_patterns 64
+#define Bench_lines 20000
+
+/* one strstr pass per pattern */
+static void redact_strstr(const char *const *patterns, size_t num, char *s)
+{
+	for (size_t i = 0; i < num; ++i) {
+		const char *pat = patterns[i];
+		size_t len = strlen(pat);
+		for (char *p = strstr(s, pat); p; p = strstr(p, pat)) {
+			memset(p, '*', len);
+		}
+	}
+}
+
+int main(void)
+{
+	static char pattern_mem[Bench_patterns][32];
+	const char *patterns[Bench_patterns];
+	for (size_t i = 0; i < Bench_patterns; ++i) {
+		snprintf(pattern_mem[i], 32, "key%zu_secret=", i * 7);
+		patterns[i] = pattern_mem[i];
+	}
+
+	static char lines[16][256];
+	for (size_t i = 0; i < 16; ++i) {
+		snprintf(lines[i], 256, "2020-05-%02zu 12:00:%02zu GET /api/v1/"
+			 "items/%zu?user=someone&key%zu_secret=abc&q=more+text"
+			 " 200 OK in %zu ms from 192.168.1.%zu", i + 1, i,
+			 i * 977, i * 7, i * 3, i);
+	}
+
+	char scratch[256];
+	clock_t begin = clock();
+	for (size_t i = 0; i < Bench_lines; ++i) {
+		strcpy(scratch, lines[i % 16]);
+		redact_strstr(patterns, Bench_patterns, scratch);
+	}
+	double naive = seconds(begin, clock());
+
+	strbuf_redactor_s *r = strbuf_redactor_new(patterns, Bench_patterns, 0);
+	strbuf_s *sb = strbuf_new(NULL, 0);
+	begin = clock();
+	for (size_t i = 0; i < Bench_lines; ++i) {
+		strbuf_set(sb, lines[i % 16], strlen(lines[i % 16]));
+		strbuf_redact(r, sb, '*');
+	}
+	double redacted = seconds(begin, clock());
+
+	printf("%d lines against %d patterns: strstr %.3f s,"
+	       " strbuf_redact %.3f s, %.0fx%s\n", Bench_lines,
+	       Bench_patterns, naive, redacted, naive / redacted,
+	       strcmp(scratch, strbuf_str(sb)) ? " (results differ)" : "");
+
+	strbuf_destroy(sb);
+	strbuf_redactor_destroy(r);
+	return 0;
+}
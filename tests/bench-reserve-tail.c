@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench-reserve-tail.c: a producer writing straight in to a strbuf */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define Bench_writes 20000
+#define Bench_chunk 64
+
+/* stands in for read(2) or a compressor */
+static size_t produce(char *dest, size_t avail, size_t i)
+{
+	size_t n = (Bench_chunk < avail) ? Bench_chunk : avail;
+	memset(dest, 'a' + (i % 26), n);
+	return n;
+}
+
+int main(void)
+{
+	strbuf_s *sb = strbuf_new(NULL, 0);
+	clock_t begin = clock();
+	for (size_t i = 0; i < Bench_writes; ++i) {
+		size_t len = strbuf_len(sb);
+		/* make room, as there is no other way to reserve it */
+		strbuf_append_f(sb, Bench_chunk, "%*s", Bench_chunk, "");
+		size_t size = 0;
+		char *buf = strbuf_expose(sb, &size);
+		size_t n = produce(buf + len, size - len - 1, i);
+		buf[len + n] = '\0';
+		strbuf_return(sb);
+	}
+	double exposed = seconds(begin, clock());
+	size_t expect_len = strbuf_len(sb);
+	strbuf_destroy(sb);
+
+	sb = strbuf_new(NULL, 0);
+	begin = clock();
+	for (size_t i = 0; i < Bench_writes; ++i) {
+		size_t avail = 0;
+		char *tail = strbuf_reserve_tail(sb, Bench_chunk, &avail);
+		strbuf_commit(sb, produce(tail, avail, i));
+	}
+	double reserved = seconds(begin, clock());
+
+	printf("%d writes of %d bytes: expose/return %.3f s,"
+	       " reserve_tail/commit %.3f s, %.0fx%s\n", Bench_writes,
+	       Bench_chunk, exposed, reserved, exposed / reserved,
+	       (strbuf_len(sb) != expect_len) ? " (lengths differ)" : "");
+
+	strbuf_destroy(sb);
+	return 0;
+}
@@ -0,0 +1,15 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* bench.h: helpers shared by the benchmarks */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#ifndef BENCH_H
+#define BENCH_H 1
+
+#include <time.h>
+
+static inline double seconds(clock_t begin, clock_t end)
+{
+	return ((double)(end - begin)) / CLOCKS_PER_SEC;
+}
+
+#endif /* #ifndef BENCH_H */
@@ -9,9 +9,8 @@ unsigned test_avail(void)
 {
 	unsigned failures = 0;
 
-	/* sizeof(strbuf_s) is about 64 */
 	/* we expect only about 16 bytes left to make use of a string data */
-	size_t buf_size = 80;
+	size_t buf_size = strbuf_struct_size() + 16;
 	unsigned char buf[buf_size];
 	strbuf_s *sb = strbuf_no_grow(buf, buf_size, NULL, 0);
 
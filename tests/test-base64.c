@@ -0,0 +1,152 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-base64.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+typedef const char *(*encode_func)(strbuf_s *sb, const void *data,
+				   size_t len);
+typedef const char *(*decode_func)(strbuf_s *sb, const char *src,
+				   size_t len);
+
+unsigned test_codec_inner(encode_func encode, decode_func decode,
+			  const char *in, const char *expected)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, "x", 1);
+
+	size_t in_len = eembed_strlen(in);
+	failures += check_str_m(encode(sb, in, in_len), expected, in);
+
+	strbuf_set(sb, "x", 1);
+	size_t len = eembed_strlen(expected + 1);
+	const char *rv = decode(sb, expected + 1, len);
+	failures += check_ptr_not_null_m(rv, expected);
+	failures += check_size_t(strbuf_len(sb), 1 + in_len);
+	failures += check_str_m(strbuf_str(sb) + 1, in, expected);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_decode_invalid(decode_func decode, const char *in)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, "x", 1);
+
+	failures += check_ptr_m(decode(sb, in, eembed_strlen(in)), NULL, in);
+	failures += check_str(strbuf_str(sb), "x");
+	failures += check_char(strbuf_str(sb)[2], '\0');
+
+	strbuf_destroy(sb);
+
+	/* a full ring would push out its oldest bytes to make room */
+	unsigned char mem[STRBUF_NO_GROW_SIZE(16)];
+	sb = strbuf_ring(mem, sizeof(mem));
+	size_t full = strbuf_avail(sb);
+	for (size_t i = 0; i < full; ++i) {
+		strbuf_append(sb, (i % 2) ? "b" : "a", 1);
+	}
+	failures += check_ptr_m(decode(sb, in, eembed_strlen(in)), NULL, in);
+	failures += check_size_t(strbuf_len(sb), full);
+	failures += check_char(strbuf_char(sb, 0), 'a');
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_binary_round_trip(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 125 * sizeof(void *);
+	unsigned char bytes[125 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	unsigned char data[256];
+	for (size_t i = 0; i < 256; ++i) {
+		data[i] = (unsigned char)(255 - i);
+	}
+
+	strbuf_s *enc = strbuf_new(NULL, 0);
+	strbuf_s *dec = strbuf_new(NULL, 0);
+
+	for (size_t len = 0; len < 40; ++len) {
+		strbuf_set(enc, "", 0);
+		strbuf_set(dec, "", 0);
+		strbuf_append_base64(enc, data, len);
+		strbuf_append_base64_decoded(dec, strbuf_str(enc),
+					     strbuf_len(enc));
+		failures += check_size_t(strbuf_len(dec), len);
+		failures += check_int(eembed_memcmp(strbuf_str(dec), data, len),
+				      0);
+
+		strbuf_set(enc, "", 0);
+		strbuf_set(dec, "", 0);
+		strbuf_append_base64url(enc, data, len);
+		strbuf_append_base64url_decoded(dec, strbuf_str(enc),
+						strbuf_len(enc));
+		failures += check_size_t(strbuf_len(dec), len);
+		failures += check_int(eembed_memcmp(strbuf_str(dec), data, len),
+				      0);
+	}
+
+	strbuf_destroy(dec);
+	strbuf_destroy(enc);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_base64(void)
+{
+	unsigned failures = 0;
+
+	encode_func b64 = strbuf_append_base64;
+	decode_func b64d = strbuf_append_base64_decoded;
+	failures += test_codec_inner(b64, b64d, "", "x");
+	failures += test_codec_inner(b64, b64d, "f", "xZg==");
+	failures += test_codec_inner(b64, b64d, "fo", "xZm8=");
+	failures += test_codec_inner(b64, b64d, "foo", "xZm9v");
+	failures += test_codec_inner(b64, b64d, "foobar", "xZm9vYmFy");
+	failures += test_codec_inner(b64, b64d, "Many hands make light work.",
+				     "xTWFueSBoYW5kcyBtYWtlIGxpZ2h0IHdvcmsu");
+	failures += test_codec_inner(b64, b64d, "\xfb\xff", "x+/8=");
+
+	encode_func url = strbuf_append_base64url;
+	decode_func urld = strbuf_append_base64url_decoded;
+	failures += test_codec_inner(url, urld, "f", "xZg");
+	failures += test_codec_inner(url, urld, "\xfb\xff", "x-_8");
+
+	encode_func hex = strbuf_append_hex;
+	decode_func hexd = strbuf_append_hex_decoded;
+	failures += test_codec_inner(hex, hexd, "\x01\xab\xff", "x01abff");
+
+	failures += test_decode_invalid(b64d, "Zm9v!");
+	failures += test_decode_invalid(b64d, "Z");
+	failures += test_decode_invalid(b64d, "Zm9vY===");
+	failures += test_decode_invalid(b64d, "AAA==");
+	failures += test_decode_invalid(b64d, "QQ=");
+	failures += test_decode_invalid(b64d, "Zg==Zg==");
+	failures += test_decode_invalid(b64d, "-_8=");
+	failures += test_decode_invalid(urld, "+/8=");
+	failures += test_decode_invalid(hexd, "abc");
+	failures += test_decode_invalid(hexd, "zz");
+
+	failures += test_binary_round_trip();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_base64)
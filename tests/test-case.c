@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-case.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+typedef const char *(*case_func)(strbuf_s *sb);
+
+unsigned test_case_map(case_func cfunc, const char *in, const char *expected)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, "  ", 2);
+	strbuf_append(sb, in, eembed_strlen(in));
+	strbuf_trim_l(sb);
+
+	failures += check_int(strbuf_utf8_valid(sb), 1);
+
+	failures += check_str_m(cfunc(sb), expected, in);
+	failures += check_size_t(strbuf_len(sb), eembed_strlen(expected));
+	failures += check_int(strbuf_utf8_valid(sb), 1);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_case_cmp(const char *a, const char *b, int expected)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, a, eembed_strlen(a));
+
+	int cmp = strbuf_casecmp(sb, b, eembed_strlen(b));
+	cmp = (cmp < 0) ? -1 : (cmp > 0) ? 1 : 0;
+	failures += check_int_m(cmp, expected, a);
+	failures += check_int_m(strbuf_caseeq(sb, b, eembed_strlen(b)),
+				expected == 0 ? 1 : 0, b);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_case(void)
+{
+	unsigned failures = 0;
+
+	failures += test_case_map(strbuf_to_lower, "", "");
+	failures += test_case_map(strbuf_to_lower, "Content-Type",
+				  "content-type");
+	failures += test_case_map(strbuf_to_lower, "@AZ[`az{ X-FORWARDED-FOR",
+				  "@az[`az{ x-forwarded-for");
+	failures += test_case_map(strbuf_to_lower, "CAF\xC3\x89 \xC3\x80 OK",
+				  "caf\xC3\x89 \xC3\x80 ok");
+	failures += test_case_map(strbuf_to_upper, "Content-Length: 42",
+				  "CONTENT-LENGTH: 42");
+	failures += test_case_map(strbuf_to_upper, "@AZ[`az{ x-forwarded-for",
+				  "@AZ[`AZ{ X-FORWARDED-FOR");
+	failures += test_case_map(strbuf_to_upper, "caf\xC3\xA9 \xC3\xA0 ok",
+				  "CAF\xC3\xA9 \xC3\xA0 OK");
+
+	failures += test_case_cmp("", "", 0);
+	failures += test_case_cmp("Host", "hOST", 0);
+	failures += test_case_cmp("Accept-Encoding", "ACCEPT-ENCODING", 0);
+	failures += test_case_cmp("Accept-Encoding", "accept-encodinG", 0);
+	failures += test_case_cmp("Accept-Encoding", "Accept-Language", -1);
+	failures += test_case_cmp("Accept-Language", "ACCEPT-ENCODING", 1);
+	failures += test_case_cmp("Accept", "Accept-Encoding", -1);
+	failures += test_case_cmp("accept-encoding", "ACCEPT", 1);
+	failures += test_case_cmp("[", "a", -1);
+	failures += test_case_cmp("A", "_", 1);
+	failures += test_case_cmp("\xC3\x89", "\xC3\xA9", -1);
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_case)
@@ -0,0 +1,145 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-clone.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+unsigned test_clone_copy_on_write(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 250 * sizeof(void *);
+	unsigned char bytes[250 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	strbuf_s *sb = strbuf_new("  shared prefix", 15);
+	strbuf_trim_l(sb);
+	uint64_t hash = strbuf_hash(sb);
+
+	strbuf_s *a = strbuf_clone(sb);
+	strbuf_s *b = strbuf_clone(a);
+	failures += check_int(a != NULL && a != sb, 1);
+	failures += check_ptr(strbuf_str(a), strbuf_str(sb));
+	failures += check_ptr(strbuf_str(b), strbuf_str(sb));
+	failures += check_int(strbuf_hash(b) == hash, 1);
+	failures += check_int(strbuf_eq(a, sb), 1);
+
+	failures += check_str(strbuf_append(a, " one", 4), "shared prefix one");
+	failures += check_int(strbuf_str(a) != strbuf_str(sb), 1);
+	failures += check_str(strbuf_str(sb), "shared prefix");
+	failures += check_str(strbuf_str(b), "shared prefix");
+
+	failures += check_str(strbuf_to_upper(b), "SHARED PREFIX");
+	failures += check_str(strbuf_str(sb), "shared prefix");
+
+	/* the original may also write, leaving the clones alone */
+	strbuf_s *c = strbuf_clone(sb);
+	failures += check_ptr(strbuf_erase(sb, 0, 7), sb);
+	failures += check_str(strbuf_str(sb), "prefix");
+	failures += check_str(strbuf_str(c), "shared prefix");
+
+	/* the last holder takes the buffer back without a copy */
+	strbuf_s *d = strbuf_clone(c);
+	const char *before = strbuf_str(d);
+	strbuf_destroy(c);
+	failures += check_str(strbuf_append(d, "!", 1), "shared prefix!");
+	failures += check_ptr(strbuf_str(d), before);
+
+	strbuf_destroy(d);
+	strbuf_destroy(b);
+	strbuf_destroy(a);
+	strbuf_destroy(sb);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_clone_no_grow(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 100 * sizeof(void *);
+	unsigned char bytes[100 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	unsigned char buf[200];
+	strbuf_s *sb = strbuf_no_grow(buf, sizeof(buf), "on the stack", 12);
+
+	/* a buffer the strbuf does not own is copied */
+	strbuf_s *clone = strbuf_clone(sb);
+	failures += check_int(clone != NULL, 1);
+	failures += check_int(strbuf_str(clone) != strbuf_str(sb), 1);
+	failures += check_str(strbuf_str(clone), "on the stack");
+	failures += check_str(strbuf_append(clone, "!", 1), "on the stack!");
+	failures += check_str(strbuf_str(sb), "on the stack");
+
+	strbuf_destroy(clone);
+	strbuf_destroy(sb);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_clone_frees(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+	struct eembed_allocator ea;
+	struct echeck_err_injecting_context ctx;
+
+	echeck_err_injecting_allocator_init(&ea, orig, &ctx, eembed_err_log);
+
+	strbuf_s *sb = strbuf_new_custom(&ea, NULL, 0, "abc", 3);
+	strbuf_s *clones[4];
+	for (size_t i = 0; i < 4; ++i) {
+		clones[i] = strbuf_clone(sb);
+	}
+	/* the struct and buffer, one share, and a struct per clone */
+	failures += check_unsigned_int_m(ctx.allocs, 7, "allocs");
+
+	strbuf_append(clones[1], "d", 1);
+	strbuf_destroy(sb);
+	strbuf_destroy(clones[0]);
+	strbuf_append(clones[2], "e", 1);
+	for (size_t i = 1; i < 4; ++i) {
+		strbuf_destroy(clones[i]);
+	}
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+
+	/* a failed copy leaves the clone as it was */
+	sb = strbuf_new_custom(&ea, NULL, 0, "abc", 3);
+	strbuf_s *clone = strbuf_clone(sb);
+	ctx.attempts_to_fail_bitmask = 1UL << ctx.attempts;
+	failures += check_ptr(strbuf_append(clone, "d", 1), NULL);
+	ctx.attempts_to_fail_bitmask = 0;
+	failures += check_str(strbuf_str(clone), "abc");
+	failures += check_str(strbuf_append(clone, "d", 1), "abcd");
+	failures += check_str(strbuf_str(sb), "abc");
+	strbuf_destroy(clone);
+	strbuf_destroy(sb);
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+	failures +=
+	    check_unsigned_int_m(ctx.free_bytes, ctx.alloc_bytes, "bytes");
+
+	return failures;
+}
+
+unsigned test_clone(void)
+{
+	unsigned failures = 0;
+
+	failures += test_clone_copy_on_write();
+	failures += test_clone_no_grow();
+	failures += test_clone_frees();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_clone)
@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-cmp.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+unsigned test_cmp_inner(const char *a, const char *b, int expected,
+			size_t prefix_len)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	/* leading space trimmed so that start is not zero */
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, " ", 1);
+	strbuf_append(sb, a, eembed_strlen(a));
+	strbuf_trim_l(sb);
+	size_t b_len = eembed_strlen(b);
+
+	int cmp = strbuf_cmp(sb, b, b_len);
+	cmp = (cmp < 0) ? -1 : (cmp > 0) ? 1 : 0;
+	failures += check_int_m(cmp, expected, a);
+	failures += check_size_t_m(strbuf_common_prefix_len(sb, b, b_len),
+				   prefix_len, a);
+	failures += check_int_m(strbuf_starts_with(sb, b, b_len),
+				prefix_len == b_len ? 1 : 0, b);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_cmp_ends_with(void)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, "/api/v1/users.json", 18);
+
+	failures += check_int(strbuf_ends_with(sb, ".json", 5), 1);
+	failures += check_int(strbuf_ends_with(sb, "", 0), 1);
+	failures += check_int(strbuf_ends_with(sb, NULL, 0), 1);
+	failures += check_int(strbuf_ends_with(sb, ".xml", 4), 0);
+	failures += check_int(strbuf_ends_with(sb, "/api/v1/users.json", 18),
+			      1);
+	failures += check_int(strbuf_ends_with(sb, "//api/v1/users.json", 19),
+			      0);
+	failures += check_int(strbuf_starts_with(sb, NULL, 0), 1);
+	failures += check_int(strbuf_cmp(sb, NULL, 0) > 0, 1);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_cmp(void)
+{
+	unsigned failures = 0;
+
+	failures += test_cmp_inner("", "", 0, 0);
+	failures += test_cmp_inner("a", "", 1, 0);
+	failures += test_cmp_inner("", "a", -1, 0);
+	failures += test_cmp_inner("/api/v1/users", "/api/v1/users", 0, 13);
+	failures += test_cmp_inner("/api/v1/users", "/api/v1/user", 1, 12);
+	failures += test_cmp_inner("/api/v1/user", "/api/v1/users", -1, 12);
+	failures += test_cmp_inner("/api/v1/users", "/api/v2/users", -1, 6);
+	failures += test_cmp_inner("/api/v2/users", "/api/v1/users", 1, 6);
+	failures += test_cmp_inner("/api/v1/users/42/orders/7",
+				   "/api/v1/users/42/orders/8", -1, 24);
+	failures += test_cmp_inner("/api/v1", "/api/v1/users", -1, 7);
+	failures += test_cmp_inner("\xFF", "\x01", 1, 0);
+	failures += test_cmp_inner("x\x01", "x\xFF", -1, 1);
+
+	failures += test_cmp_ends_with();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_cmp)
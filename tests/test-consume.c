@@ -0,0 +1,200 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-consume.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+unsigned test_consume_front(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 250 * sizeof(void *);
+	unsigned char bytes[250 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	strbuf_s *sb = strbuf_new("GET / HTTP/1.1\r\nHost: a\r\n", 25);
+	const char *before = strbuf_str(sb);
+
+	failures += check_ptr(strbuf_consume(sb, 16), sb);
+	failures += check_ptr(strbuf_str(sb), before + 16);
+	failures += check_str(strbuf_str(sb), "Host: a\r\n");
+	failures += check_size_t(strbuf_len(sb), 9);
+	failures += check_char(strbuf_char(sb, 0), 'H');
+
+	failures += check_ptr(strbuf_consume(sb, 999), sb);
+	failures += check_size_t(strbuf_len(sb), 0);
+	failures += check_str(strbuf_str(sb), "");
+	failures += check_ptr(strbuf_consume(sb, 1), sb);
+
+	/* an append which fits after the end does not move anything */
+	failures += check_str(strbuf_append(sb, "x", 1), "x");
+	failures += check_ptr(strbuf_str(sb), before + 25);
+
+	/* an append which does not fit after the end, but does once the
+	   string moves back, moves it instead of growing */
+	size_t avail = strbuf_avail(sb);
+	size_t size = 0;
+	strbuf_expose(sb, &size);
+	strbuf_return(sb);
+	strbuf_set(sb, "", 0);
+	for (size_t i = 0; i + 1 < size; ++i) {
+		strbuf_append(sb, "y", 1);
+	}
+	strbuf_consume(sb, size - 3);
+	failures += check_str(strbuf_append(sb, "zzzz", 4), "yyzzzz");
+	strbuf_expose(sb, &size);
+	strbuf_return(sb);
+	failures += check_int(size >= avail, 1);
+	failures += check_ptr(strbuf_str(sb), before);
+
+	/* also when the rest is longer than what was dropped */
+	size_t big_size = size;
+	strbuf_set(sb, "", 0);
+	for (size_t i = 0; i + 1 < big_size; ++i) {
+		strbuf_append(sb, "w", 1);
+	}
+	strbuf_consume(sb, big_size / 4);
+	size_t live = strbuf_len(sb);
+	strbuf_append(sb, "vvv", 3);
+	failures += check_size_t(strbuf_len(sb), live + 3);
+	failures += check_ptr(strbuf_str(sb), before);
+	strbuf_expose(sb, &size);
+	strbuf_return(sb);
+	failures += check_size_t(size, big_size);
+	failures += check_char(strbuf_char(sb, live + 2), 'v');
+	strbuf_set(sb, "yyzzzz", 6);
+
+	/* consuming from a clone writes nothing, so it stays shared */
+	strbuf_s *clone = strbuf_clone(sb);
+	strbuf_consume(clone, 2);
+	failures += check_ptr(strbuf_str(clone), before + 2);
+	failures += check_str(strbuf_str(sb), "yyzzzz");
+	failures += check_str(strbuf_append(clone, "!", 1), "zzzz!");
+	failures += check_str(strbuf_str(sb), "yyzzzz");
+	strbuf_destroy(clone);
+
+	strbuf_destroy(sb);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+/* with nothing consumed to reclaim, a plain append grows only to fit */
+unsigned test_consume_grow_to_fit(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 250 * sizeof(void *);
+	unsigned char bytes[250 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	char full[200];
+	eembed_memset(full, 'u', sizeof(full));
+	strbuf_s *sb = strbuf_new(full, sizeof(full));
+	size_t before = 0;
+	strbuf_expose(sb, &before);
+	strbuf_return(sb);
+	strbuf_append(sb, full, (before - sizeof(full)) - 1);
+	failures += check_size_t(strbuf_avail(sb), 0);
+
+	strbuf_append(sb, "u", 1);
+	size_t after = 0;
+	strbuf_expose(sb, &after);
+	strbuf_return(sb);
+	failures += check_int(after > before && after < (2 * before), 1);
+	failures += check_size_t(strbuf_len(sb), before);
+
+	strbuf_destroy(sb);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_consume_compact(void)
+{
+	unsigned failures = 0;
+
+	unsigned char mem[STRBUF_NO_GROW_SIZE(40)];
+	strbuf_s *sb = strbuf_no_grow(mem, sizeof(mem), "0123456789", 10);
+	const char *before = strbuf_str(sb);
+
+	strbuf_consume(sb, 4);
+	failures += check_ptr(strbuf_compact_if(sb, 50), before + 4);
+	failures += check_ptr(strbuf_compact_if(sb, 1), before);
+	failures += check_str(strbuf_str(sb), "456789");
+
+	/* across the gap left by an insert */
+	strbuf_insert(sb, 2, "ab", 2);
+	strbuf_consume(sb, 3);
+	failures += check_size_t(strbuf_len(sb), 5);
+	failures += check_char(strbuf_char(sb, 0), 'b');
+	failures += check_str(strbuf_str(sb), "b6789");
+
+	strbuf_insert(sb, 3, "cd", 2);
+	strbuf_consume(sb, 1);
+	failures += check_str(strbuf_str(sb), "67cd89");
+
+	/* a no_grow strbuf still moves the string back when it must */
+	size_t avail = strbuf_avail(sb);
+	for (size_t i = 0; i < avail; ++i) {
+		failures += check_int(strbuf_append(sb, "z", 1) != NULL, 1);
+	}
+	strbuf_consume(sb, 1);
+	failures += check_int(strbuf_append(sb, "!", 1) != NULL, 1);
+	failures += check_char(strbuf_char(sb, 0), '7');
+	failures += check_char(strbuf_char(sb, avail + 5), '!');
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_consume_ring(void)
+{
+	unsigned failures = 0;
+
+	unsigned char mem[STRBUF_NO_GROW_SIZE(16)];
+	strbuf_s *sb = strbuf_ring(mem, sizeof(mem));
+	size_t cap = strbuf_avail(sb);
+	for (size_t i = 0; i < cap + 5; ++i) {
+		char c = (char)('a' + i);
+		strbuf_append(sb, &c, 1);
+	}
+	size_t len = strbuf_len(sb);
+	char first = strbuf_char(sb, 0);
+	char last = strbuf_char(sb, len - 1);
+
+	strbuf_consume(sb, 2);
+	failures += check_size_t(strbuf_len(sb), len - 2);
+	failures += check_char(strbuf_char(sb, 0), (char)(first + 2));
+	strbuf_consume(sb, len - 3);
+	failures += check_size_t(strbuf_len(sb), 1);
+	failures += check_char(strbuf_char(sb, 0), last);
+	strbuf_append(sb, "!", 1);
+	failures += check_char(strbuf_char(sb, 1), '!');
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_consume(void)
+{
+	unsigned failures = 0;
+
+	failures += test_consume_front();
+	failures += test_consume_compact();
+	failures += test_consume_grow_to_fit();
+	failures += test_consume_ring();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_consume)
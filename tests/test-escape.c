@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-escape.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+unsigned test_escape_inner(enum strbuf_escape mode, const char *in,
+			   const char *expected)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, "[", 1);
+
+	size_t len = eembed_strlen(in);
+	strbuf_append_escaped(sb, in, len, mode);
+	strbuf_append(sb, "]", 1);
+	failures += check_str_m(strbuf_str(sb), expected, in);
+
+	/* the unescape of the escaped value gives back the input */
+	strbuf_set(sb, "", 0);
+	strbuf_append_escaped(sb, in, len, mode);
+	failures += check_str_m(strbuf_unescape(sb, mode), in, expected);
+	failures += check_size_t(strbuf_len(sb), len);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_unescape_inner(enum strbuf_escape mode, const char *in,
+			     const char *expected)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, in, eembed_strlen(in));
+
+	failures += check_str_m(strbuf_unescape(sb, mode), expected, in);
+	failures += check_size_t(strbuf_len(sb), eembed_strlen(expected));
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_escape_grows(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 125 * sizeof(void *);
+	unsigned char bytes[125 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	strbuf_s *sb = strbuf_new("x", 1);
+	const char *in = "<<<<<<<<<<<<<<<<<<<<";
+	const char *rv = strbuf_append_escaped(sb, in, 100, strbuf_escape_html);
+	failures += check_str(rv, "x&lt;&lt;&lt;&lt;&lt;&lt;&lt;&lt;&lt;&lt;"
+			      "&lt;&lt;&lt;&lt;&lt;&lt;&lt;&lt;&lt;&lt;");
+	strbuf_destroy(sb);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_escape(void)
+{
+	unsigned failures = 0;
+
+	enum strbuf_escape html = strbuf_escape_html;
+	failures += test_escape_inner(html, "plain text, nothing to do",
+				      "[plain text, nothing to do]");
+	failures += test_escape_inner(html, "<a href=\"x\">Tom & 'Jerry'</a>",
+				      "[&lt;a href=&quot;x&quot;&gt;Tom &amp; "
+				      "&#39;Jerry&#39;&lt;/a&gt;]");
+	failures += test_unescape_inner(html, "&lt;&#65;&#x42;&apos;&bogus;&",
+					"<AB'&bogus;&");
+
+	enum strbuf_escape url = strbuf_escape_url;
+	failures += test_escape_inner(url, "Az09-._~", "[Az09-._~]");
+	failures += test_escape_inner(url, "abcdefghijklmnopQRSTUVWXYZ0123@9",
+				      "[abcdefghijklmnopQRSTUVWXYZ0123%409]");
+	failures += test_escape_inner(url, "a b/c?d=e&f\xC3\xA9",
+				      "[a%20b%2Fc%3Fd%3De%26f%C3%A9]");
+	failures += test_unescape_inner(url, "%41%4a%zz%4", "AJ%zz%4");
+	failures += test_unescape_inner(url, "a%00b%41%000", "a%00bA%000");
+
+	enum strbuf_escape csv = strbuf_escape_csv;
+	failures += test_escape_inner(csv, "simple", "[simple]");
+	failures += test_escape_inner(csv, "a,b", "[\"a,b\"]");
+	failures += test_escape_inner(csv, "say \"hi\"\n",
+				      "[\"say \"\"hi\"\"\n\"]");
+	failures += test_unescape_inner(csv, "unquoted \"", "unquoted \"");
+
+	enum strbuf_escape shell = strbuf_escape_shell;
+	failures += test_escape_inner(shell, "/usr/bin/ls", "[/usr/bin/ls]");
+	failures += test_escape_inner(shell, "", "['']");
+	failures += test_escape_inner(shell, "abcdefghijklmnopqrstuvwxyz`",
+				      "['abcdefghijklmnopqrstuvwxyz`']");
+	failures += test_escape_inner(shell, "ABCDEFGHIJKLMNOP0123456789",
+				      "[ABCDEFGHIJKLMNOP0123456789]");
+	failures += test_escape_inner(shell, "it's $HOME",
+				      "['it'\\''s $HOME']");
+	failures += test_unescape_inner(shell, "a\\ b'c d'", "a bc d");
+
+	failures += test_escape_grows();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_escape)
@@ -0,0 +1,216 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-expand.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+struct test_expand_vars {
+	const char *names[4];
+	const char *values[4];
+	unsigned calls;
+};
+
+static const char *test_expand_lookup(void *ctx, const char *name,
+				      size_t name_len, size_t *value_len)
+{
+	struct test_expand_vars *vars = (struct test_expand_vars *)ctx;
+	++vars->calls;
+	for (size_t i = 0; i < 4 && vars->names[i]; ++i) {
+		if (eembed_strlen(vars->names[i]) == name_len
+		    && eembed_memcmp(vars->names[i], name, name_len) == 0) {
+			*value_len = eembed_strlen(vars->values[i]);
+			return vars->values[i];
+		}
+	}
+	return NULL;
+}
+
+unsigned test_expand_basics(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 500 * sizeof(void *);
+	unsigned char bytes[500 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	struct test_expand_vars vars = {
+		{ "user", "host", "empty", NULL },
+		{ "eric", "freesa.org", "", NULL },
+		0
+	};
+	strbuf_s *sb = strbuf_new("> ", 2);
+
+	const char *tmpl = "${user}@${host}: ${missing}|${empty:-none}|"
+	    "${user:-x}|$$5 $x ${open";
+	const char *s = strbuf_expand(sb, tmpl, eembed_strlen(tmpl),
+				      test_expand_lookup, &vars);
+	failures += check_str(s, "> eric@freesa.org: |none|eric|$5 $x ${open");
+	failures += check_unsigned_int_m(vars.calls, 5, "lookups");
+
+	/* only "tmpl_len" bytes are read */
+	strbuf_set(sb, "", 0);
+	s = strbuf_expand(sb, "${user}s and more", 8, test_expand_lookup,
+			  &vars);
+	failures += check_str(s, "erics");
+
+	strbuf_set(sb, "", 0);
+	s = strbuf_expand(sb, "${user}", 7, NULL, NULL);
+	failures += check_str(s, "");
+	s = strbuf_expand(sb, "", 0, test_expand_lookup, &vars);
+	failures += check_str(s, "");
+
+	strbuf_destroy(sb);
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_expand_compiled(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 500 * sizeof(void *);
+	unsigned char bytes[500 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	struct test_expand_vars vars = {
+		{ "name", "count", NULL, NULL },
+		{ "disk", "3", NULL, NULL },
+		0
+	};
+	char tmpl[] = "alert: ${name} has ${count:-no} errors ($$${count})";
+	strbuf_template_s *t = strbuf_template_compile(tmpl,
+						       eembed_strlen(tmpl));
+	failures += check_ptr_not_null(t);
+	if (!t) {
+		eembed_global_allocator = orig;
+		return failures;
+	}
+	/* the template was copied */
+	tmpl[0] = 'X';
+
+	strbuf_s *sb = strbuf_new(NULL, 0);
+	const char *expect[] = { "alert: disk has 3 errors ($3)",
+		"alert: disk has no errors ($)",
+		"alert: disk has no errors ($)"
+	};
+	for (size_t i = 0; i < 3; ++i) {
+		strbuf_set(sb, "", 0);
+		const char *s = strbuf_template_expand(sb, t,
+						       test_expand_lookup,
+						       &vars);
+		failures += check_str(s, expect[i]);
+		vars.values[1] = "";
+	}
+	failures += check_unsigned_int_m(vars.calls, 9, "lookups");
+
+	/* appends to a strbuf with a gap */
+	strbuf_set(sb, "ac", 2);
+	strbuf_insert(sb, 1, "b", 1);
+	vars.values[1] = "7";
+	failures += check_str(strbuf_template_expand(sb, t, test_expand_lookup,
+						     &vars),
+			      "abcalert: disk has 7 errors ($7)");
+
+	strbuf_template_destroy(t);
+
+	t = strbuf_template_compile("", 0);
+	failures += check_ptr_not_null(t);
+	strbuf_set(sb, "", 0);
+	failures += check_str(strbuf_template_expand(sb, t, NULL, NULL), "");
+	strbuf_template_destroy(t);
+
+	strbuf_destroy(sb);
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+/* a failed expansion leaves the string as it was; a ring is not made to
+   push out more than the expansion needs */
+unsigned test_expand_fixed(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 500 * sizeof(void *);
+	unsigned char bytes[500 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	/* more than either buffer below can hold */
+	const char *big = "0123456789abcdefghijklmnopqrstuvwxyz"
+	    "0123456789abcdefghijklmnopqrstuvwxyz"
+	    "0123456789abcdefghijklmnopqrstuvwxyz";
+	struct test_expand_vars vars = {
+		{ "aa", "bb", "long", NULL },
+		{ "x", "y", big, NULL },
+		0
+	};
+	const char *tmpl = "ab${aa}${long}";
+	size_t tmpl_len = eembed_strlen(tmpl);
+	strbuf_template_s *t = strbuf_template_compile(tmpl, tmpl_len);
+	failures += check_ptr_not_null(t);
+	if (!t) {
+		eembed_global_allocator = orig;
+		return failures;
+	}
+
+	STRBUF_STATIC(fixed, 20);
+	strbuf_set(fixed, "keep", 4);
+	failures += check_int(strbuf_avail(fixed) < eembed_strlen(big), 1);
+	failures += check_ptr(strbuf_expand(fixed, tmpl, tmpl_len,
+					    test_expand_lookup, &vars), NULL);
+	failures += check_str(strbuf_str(fixed), "keep");
+	failures += check_ptr(strbuf_template_expand(fixed, t,
+						     test_expand_lookup,
+						     &vars), NULL);
+	failures += check_str(strbuf_str(fixed), "keep");
+
+	unsigned char mem[STRBUF_NO_GROW_SIZE(16)];
+	strbuf_s *ring = strbuf_ring(mem, sizeof(mem));
+	strbuf_append(ring, "0123456789", 10);
+	failures += check_int(strbuf_avail(ring) < eembed_strlen(big), 1);
+	failures += check_ptr(strbuf_expand(ring, tmpl, tmpl_len,
+					    test_expand_lookup, &vars), NULL);
+	failures += check_str(strbuf_str(ring), "0123456789");
+	failures += check_ptr(strbuf_template_expand(ring, t,
+						     test_expand_lookup,
+						     &vars), NULL);
+	failures += check_str(strbuf_str(ring), "0123456789");
+
+	/* a template longer than the ring, with a short expansion */
+	const char *many = "${aa}-${bb}-${aa}-${bb}-${aa}-${bb}-"
+	    "${aa}-${bb}-${aa}-${bb}-${aa}-${bb}-";
+	size_t many_len = eembed_strlen(many);
+	failures += check_int(many_len > strbuf_avail(ring), 1);
+	failures += check_ptr_not_null(strbuf_expand(ring, many, many_len,
+						     test_expand_lookup,
+						     &vars));
+	failures += check_str(strbuf_str(ring),
+			      "0123456789x-y-x-y-x-y-x-y-x-y-x-y-");
+
+	strbuf_destroy(ring);
+	strbuf_template_destroy(t);
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_expand(void)
+{
+	unsigned failures = 0;
+
+	failures += test_expand_basics();
+	failures += test_expand_compiled();
+	failures += test_expand_fixed();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_expand)
@@ -40,6 +40,35 @@ unsigned test_expose_return_inner(const char *in, const char *append,
 	return failures;
 }
 
+/* what was past the end before a shorter set must not come back */
+unsigned test_expose_return_shortened(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 125 * sizeof(void *);
+	unsigned char bytes[125 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	strbuf_s *sb = strbuf_new("hello world", 11);
+	strbuf_set(sb, "hi", 2);
+
+	size_t buf_size = 0;
+	char *buf = strbuf_expose(sb, &buf_size);
+	buf[2] = '!';
+	strbuf_return(sb);
+
+	failures += check_str(strbuf_str(sb), "hi!");
+	failures += check_size_t(strbuf_len(sb), 3);
+
+	strbuf_destroy(sb);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
 unsigned test_expose_return(void)
 {
 	unsigned failures = 0;
@@ -47,6 +76,7 @@ unsigned test_expose_return(void)
 	failures += test_expose_return_inner("foo", "foo", "foofoo");
 	failures += test_expose_return_inner("", "baz", "baz");
 	failures += test_expose_return_inner(NULL, "wiz", "wiz");
+	failures += test_expose_return_shortened();
 
 	return failures;
 }
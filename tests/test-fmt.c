@@ -0,0 +1,186 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-fmt.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+#if EEMBED_HOSTED
+#include <stdio.h>
+#endif
+
+unsigned test_fmt_ints(void)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, "", 0);
+	strbuf_fmt_s *prog;
+
+	prog = strbuf_fmt_compile("[%d|%5d|%-5d|%05d|%+d|% d|%.3d|%.0d]");
+	failures += check_ptr_not_null(prog);
+	strbuf_append_fmt(sb, prog, -7, 42, 42, -42, 3, 3, 7, 0);
+	failures += check_str(strbuf_str(sb),
+			      "[-7|   42|42   |-0042|+3| 3|007|]");
+	strbuf_fmt_destroy(prog);
+
+	strbuf_set(sb, "", 0);
+	prog = strbuf_fmt_compile("%hhd %hu %ld %llu %zu %jd %lld");
+	failures += check_ptr_not_null(prog);
+	strbuf_append_fmt(sb, prog, 255, 65537, -123456L,
+			  18446744073709551615ULL, (size_t)12,
+			  (intmax_t)-5, (-9223372036854775807LL - 1));
+	failures += check_str(strbuf_str(sb),
+			      "-1 1 -123456 18446744073709551615 12 -5"
+			      " -9223372036854775808");
+	strbuf_fmt_destroy(prog);
+
+	strbuf_set(sb, "", 0);
+	prog = strbuf_fmt_compile("%x %X %#x %#X %08x %#010x %#x %lx");
+	failures += check_ptr_not_null(prog);
+	strbuf_append_fmt(sb, prog, 255u, 255u, 255u, 48879u, 48879u,
+			  48879u, 0u, 0xDEADBEEFUL);
+	failures += check_str(strbuf_str(sb),
+			      "ff FF 0xff 0XBEEF 0000beef 0x0000beef 0"
+			      " deadbeef");
+	strbuf_fmt_destroy(prog);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_fmt_strings(void)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, "log: ", 5);
+	strbuf_fmt_s *prog;
+
+	prog = strbuf_fmt_compile("%s=[%6s][%-6s][%.2s]%c%% %05s");
+	failures += check_ptr_not_null(prog);
+	strbuf_append_fmt(sb, prog, "key", "abc", "abc", "abcdef", '!',
+			  "z");
+	failures += check_str(strbuf_str(sb),
+			      "log: key=[   abc][abc   ][ab]!%     z");
+	strbuf_fmt_destroy(prog);
+
+	/* a program is reused without change */
+	strbuf_set(sb, "", 0);
+	prog = strbuf_fmt_compile("%s:%u;");
+	strbuf_append_fmt(sb, prog, "a", 1u);
+	strbuf_append_fmt(sb, prog, "bb", 22u);
+	strbuf_append_fmt(sb, prog, "", 0u);
+	failures += check_str(strbuf_str(sb), "a:1;bb:22;:0;");
+	strbuf_fmt_destroy(prog);
+
+	/* no conversions at all, and an empty format */
+	strbuf_set(sb, "", 0);
+	prog = strbuf_fmt_compile("100%% plain");
+	strbuf_append_fmt(sb, prog);
+	failures += check_str(strbuf_str(sb), "100% plain");
+	strbuf_fmt_destroy(prog);
+	prog = strbuf_fmt_compile("");
+	failures += check_ptr_not_null(prog);
+	strbuf_append_fmt(sb, prog);
+	failures += check_str(strbuf_str(sb), "100% plain");
+	strbuf_fmt_destroy(prog);
+
+	/* too long for the buffer: unchanged */
+	prog = strbuf_fmt_compile("%1000d");
+	failures += check_ptr(strbuf_append_fmt(sb, prog, 1), NULL);
+	failures += check_str(strbuf_str(sb), "100% plain");
+	strbuf_fmt_destroy(prog);
+
+	failures += check_ptr(strbuf_fmt_compile("%*d"), NULL);
+	failures += check_ptr(strbuf_fmt_compile("%n"), NULL);
+	failures += check_ptr(strbuf_fmt_compile("%ls"), NULL);
+	failures += check_ptr(strbuf_fmt_compile("%Ld"), NULL);
+	failures += check_ptr(strbuf_fmt_compile("trailing %"), NULL);
+	failures += check_ptr(strbuf_fmt_compile("%99999d"), NULL);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+#if EEMBED_HOSTED
+unsigned test_fmt_doubles(void)
+{
+	unsigned failures = 0;
+
+	strbuf_s *sb = strbuf_new(NULL, 0);
+	char expected[4096];
+	const char *format = "%f|%.3f|%10.2f|%-10.2e|%g|%G|%+.0f|%Lf";
+	strbuf_fmt_s *prog = strbuf_fmt_compile(format);
+	failures += check_ptr_not_null(prog);
+
+	double values[] = { 0.0, -1.5, 3.14159265358979, 1e300, -2.5e-300 };
+	for (size_t i = 0; i < 5; ++i) {
+		double d = values[i];
+		long double ld = d;
+		snprintf(expected, 4096, format, d, d, d, d, d, d, d, ld);
+		strbuf_set(sb, "", 0);
+		strbuf_append_fmt(sb, prog, d, d, d, d, d, d, d, ld);
+		failures += check_str(strbuf_str(sb), expected);
+	}
+
+	strbuf_fmt_destroy(prog);
+
+	/* fixed point, around rounding ties and across magnitudes */
+	format = "%.0f|%.1f|%.2f|%.3f|%09.4f|%-9.5f|% .6f|%+f|%.9f";
+	prog = strbuf_fmt_compile(format);
+	double d = -2000.0;
+	for (size_t i = 0; i < 4000; ++i) {
+		snprintf(expected, 4096, format, d, d, d, d, d, d, d, d, d);
+		strbuf_set(sb, "", 0);
+		strbuf_append_fmt(sb, prog, d, d, d, d, d, d, d, d, d);
+		failures += check_str(strbuf_str(sb), expected);
+		d += 1.0005;
+		if (i % 7 == 0) {
+			d = -d / 3.0;
+		}
+	}
+	double ties[] = { 0.5, 1.5, 2.5, 0.125, 0.375, 2.675, 1.005, -0.0,
+		-0.0004, 0.05, 1e-10, 123456789.987654321, 1099511627775.5
+	};
+	for (size_t i = 0; i < (sizeof(ties) / sizeof(ties[0])); ++i) {
+		d = ties[i];
+		snprintf(expected, 4096, format, d, d, d, d, d, d, d, d, d);
+		strbuf_set(sb, "", 0);
+		strbuf_append_fmt(sb, prog, d, d, d, d, d, d, d, d, d);
+		failures += check_str(strbuf_str(sb), expected);
+	}
+	strbuf_fmt_destroy(prog);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+#endif
+
+unsigned test_fmt(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 125 * sizeof(void *);
+	unsigned char bytes[125 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	failures += test_fmt_ints();
+	failures += test_fmt_strings();
+#if EEMBED_HOSTED
+	failures += test_fmt_doubles();
+#endif
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_fmt)
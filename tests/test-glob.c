@@ -0,0 +1,198 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-glob.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+static unsigned check_glob(const char *pattern, const char *str, int expect)
+{
+	strbuf_glob_s *g = strbuf_glob_compile(pattern);
+	unsigned failures = check_ptr_not_null(g);
+	if (!g) {
+		return failures;
+	}
+	strbuf_s *sb = strbuf_new(str, eembed_strlen(str));
+	failures += check_int_m(strbuf_glob_match(g, sb), expect, pattern);
+	strbuf_destroy(sb);
+	strbuf_glob_destroy(g);
+	return failures;
+}
+
+unsigned test_glob_basics(void)
+{
+	unsigned failures = 0;
+
+	failures += check_glob("", "", 1);
+	failures += check_glob("", "a", 0);
+	failures += check_glob("*", "", 1);
+	failures += check_glob("*", "/any/thing", 1);
+	failures += check_glob("abc", "abc", 1);
+	failures += check_glob("abc", "abcd", 0);
+	failures += check_glob("a?c", "abc", 1);
+	failures += check_glob("a?c", "ac", 0);
+	failures += check_glob("/api/*", "/api/v1/users", 1);
+	failures += check_glob("/api/*", "/apx/v1", 0);
+	failures += check_glob("*.json", "/a/b.json", 1);
+	failures += check_glob("*.json", "/a/b.jsonx", 0);
+	failures += check_glob("/api/*/u/*.json", "/api/v1/u/7.json", 1);
+	failures += check_glob("/api/*/u/*.json", "/api/v1/v/7.json", 0);
+	failures += check_glob("a*b*c", "axxbyyc", 1);
+	failures += check_glob("a*b*c", "axxcyyb", 0);
+	failures += check_glob("a**b", "ab", 1);
+	failures += check_glob("*ab*ab*", "xabyab", 1);
+	failures += check_glob("*aab", "aaab", 1);
+	failures += check_glob("ab*ba", "aba", 0);
+
+	failures += check_glob("[abc]x", "bx", 1);
+	failures += check_glob("[abc]x", "dx", 0);
+	failures += check_glob("[a-c0-9]", "7", 1);
+	failures += check_glob("[!a-c]", "b", 0);
+	failures += check_glob("[^a-c]", "d", 1);
+	failures += check_glob("[]]", "]", 1);
+	failures += check_glob("[a-]", "-", 1);
+	failures += check_glob("*[0-9].log", "app.3.log", 1);
+	failures += check_glob("\\*", "*", 1);
+	failures += check_glob("\\*", "x", 0);
+	failures += check_glob("a\\?", "a?", 1);
+
+	failures += check_ptr(strbuf_glob_compile("[abc"), NULL);
+	failures += check_ptr(strbuf_glob_compile("abc\\"), NULL);
+
+	/* no backtracking: this would take very long if each '*' retried */
+	char subject[401];
+	for (size_t i = 0; i < 400; ++i) {
+		subject[i] = 'a';
+	}
+	subject[400] = '\0';
+	failures += check_glob("*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*b", subject, 0);
+	failures += check_glob("*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a*a", subject, 1);
+
+	/* a gap is closed, and binary subjects work */
+	strbuf_glob_s *g = strbuf_glob_compile("a?c*");
+	strbuf_s *sb = strbuf_new("ac", 2);
+	strbuf_insert(sb, 1, "\0", 1);
+	failures += check_int(strbuf_glob_match(g, sb), 1);
+	failures += check_int(strbuf_glob_match_str(g, "abcdef", 6), 1);
+	failures += check_int(strbuf_glob_match_str(g, "abxdef", 6), 0);
+	strbuf_destroy(sb);
+	strbuf_glob_destroy(g);
+
+	return failures;
+}
+
+/* the obvious, backtracking, definition */
+static int glob_naive(const char *p, const char *s, size_t len)
+{
+	if (!*p) {
+		return len == 0;
+	}
+	if (*p == '*') {
+		for (size_t i = 0; i <= len; ++i) {
+			if (glob_naive(p + 1, s + i, len - i)) {
+				return 1;
+			}
+		}
+		return 0;
+	}
+	if (!len) {
+		return 0;
+	}
+	if (*p == '?' || *p == *s) {
+		return glob_naive(p + 1, s + 1, len - 1);
+	}
+	return 0;
+}
+
+unsigned test_glob_against_naive(void)
+{
+	unsigned failures = 0;
+
+	const char alpha[] = "ab*?";
+	char pattern[10];
+	char subject[12];
+	unsigned r = 7;
+	for (size_t i = 0; i < 3000; ++i) {
+		r = (r * 1103515245) + 12345;
+		size_t p_len = (r >> 16) % 8;
+		for (size_t j = 0; j < p_len; ++j) {
+			r = (r * 1103515245) + 12345;
+			pattern[j] = alpha[(r >> 16) % 4];
+		}
+		pattern[p_len] = '\0';
+		r = (r * 1103515245) + 12345;
+		size_t s_len = (r >> 16) % 11;
+		for (size_t j = 0; j < s_len; ++j) {
+			r = (r * 1103515245) + 12345;
+			subject[j] = alpha[(r >> 16) % 2];
+		}
+		subject[s_len] = '\0';
+
+		strbuf_glob_s *g = strbuf_glob_compile(pattern);
+		int expect = glob_naive(pattern, subject, s_len);
+		int actual = strbuf_glob_match_str(g, subject, s_len);
+		if (actual != expect) {
+			failures += check_str(subject, pattern);
+			failures += check_int(actual, expect);
+		}
+		strbuf_glob_destroy(g);
+	}
+
+	return failures;
+}
+
+unsigned test_glob_set(void)
+{
+	unsigned failures = 0;
+
+	const char *patterns[] = {
+		"/static/*",
+		"/api/*/users",
+		"*.json",
+		"/api/*",
+		"/admin/[a-z]*",
+	};
+	strbuf_glob_set_s *set = strbuf_glob_set_compile(patterns, 5);
+	failures += check_ptr_not_null(set);
+	if (!set) {
+		return failures;
+	}
+
+	size_t found[5];
+	strbuf_s *sb = strbuf_new("/api/v1/users", 13);
+	failures += check_size_t(strbuf_glob_set_match(set, sb, found, 5), 2);
+	failures += check_size_t(found[0], 1);
+	failures += check_size_t(found[1], 3);
+
+	strbuf_set(sb, "/api/v1/users.json", 18);
+	failures += check_size_t(strbuf_glob_set_match(set, sb, found, 1), 2);
+	failures += check_size_t(found[0], 2);
+
+	strbuf_set(sb, "/admin/x", 8);
+	failures += check_size_t(strbuf_glob_set_match(set, sb, found, 5), 1);
+	failures += check_size_t(found[0], 4);
+
+	strbuf_set(sb, "/nothing", 8);
+	failures += check_size_t(strbuf_glob_set_match(set, sb, NULL, 0), 0);
+
+	strbuf_destroy(sb);
+	strbuf_glob_set_destroy(set);
+
+	const char *bad[] = { "ok*", "[bad" };
+	failures += check_ptr(strbuf_glob_set_compile(bad, 2), NULL);
+
+	return failures;
+}
+
+unsigned test_glob(void)
+{
+	unsigned failures = 0;
+
+	failures += test_glob_basics();
+	failures += test_glob_against_naive();
+	failures += test_glob_set();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_glob)
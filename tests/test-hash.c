@@ -0,0 +1,107 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-hash.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+unsigned test_hash_lengths(void)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf1[buf_size];
+	unsigned char buf2[buf_size];
+	const char *text = "The quick brown fox jumps over the lazy dog, "
+	    "and then the quick brown fox jumps over the lazy dog again.";
+	size_t text_len = eembed_strlen(text);
+
+	strbuf_s *a = strbuf_no_grow(buf1, buf_size, NULL, 0);
+	strbuf_s *b = strbuf_no_grow(buf2, buf_size, NULL, 0);
+
+	/* cover the short, medium and 48 byte block paths */
+	uint64_t prev = strbuf_hash(a);
+	for (size_t i = 1; i <= text_len; ++i) {
+		strbuf_set(a, text, i);
+		/* same bytes, different position in the buffer */
+		strbuf_set(b, text + 1, i - 1);
+		strbuf_prepend(b, text, 1);
+
+		uint64_t h = strbuf_hash(a);
+		failures += check_int(h != prev, 1);
+		failures += check_int(strbuf_hash(b) == h, 1);
+		failures += check_int(strbuf_eq(a, b), 1);
+		prev = h;
+	}
+
+	strbuf_destroy(b);
+	strbuf_destroy(a);
+
+	return failures;
+}
+
+unsigned test_hash_invalidated(void)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf1[buf_size];
+	unsigned char buf2[buf_size];
+	strbuf_s *a = strbuf_no_grow(buf1, buf_size, "key", 3);
+	strbuf_s *b = strbuf_no_grow(buf2, buf_size, "  key", 5);
+
+	uint64_t key_hash = strbuf_hash(a);
+	failures += check_int(strbuf_eq(a, a), 1);
+	failures += check_int(strbuf_eq(a, b), 0);
+
+	strbuf_trim(b);
+	failures += check_int(strbuf_hash(b) == key_hash, 1);
+	failures += check_int(strbuf_eq(a, b), 1);
+
+	strbuf_append(b, "s", 1);
+	failures += check_int(strbuf_hash(b) != key_hash, 1);
+	strbuf_trim_r(b);
+	strbuf_set(b, "KEY", 3);
+	failures += check_int(strbuf_hash(b) != key_hash, 1);
+	failures += check_int(strbuf_eq(a, b), 0);
+
+	strbuf_to_lower(b);
+	failures += check_int(strbuf_hash(b) == key_hash, 1);
+
+	strbuf_prepend(b, "x", 1);
+	failures += check_int(strbuf_hash(b) != key_hash, 1);
+
+	char *raw = strbuf_expose(b, NULL);
+	raw[0] = 'k';
+	raw[1] = 'e';
+	raw[2] = 'y';
+	raw[3] = '\0';
+	strbuf_return(b);
+	failures += check_int(strbuf_hash(b) == key_hash, 1);
+
+	/* same length, different bytes, cached hashes differ */
+	strbuf_set(b, "kez", 3);
+	strbuf_hash(b);
+	failures += check_int(strbuf_eq(a, b), 0);
+
+	/* same length, different bytes, uncached */
+	strbuf_set(a, "kex", 3);
+	failures += check_int(strbuf_eq(a, b), 0);
+
+	strbuf_destroy(b);
+	strbuf_destroy(a);
+
+	return failures;
+}
+
+unsigned test_hash(void)
+{
+	unsigned failures = 0;
+
+	failures += test_hash_lengths();
+	failures += test_hash_invalidated();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_hash)
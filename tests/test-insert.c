@@ -0,0 +1,152 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-insert.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+unsigned test_insert_erase(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 250 * sizeof(void *);
+	unsigned char bytes[250 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	strbuf_s *sb = strbuf_new("  Hello world", 13);
+	strbuf_trim_l(sb);
+
+	failures += check_ptr(strbuf_insert(sb, 5, ",", 1), sb);
+	failures += check_size_t(strbuf_len(sb), 12);
+	failures += check_char(strbuf_char(sb, 5), ',');
+	failures += check_char(strbuf_char(sb, 6), ' ');
+	failures += check_char(strbuf_char(sb, 11), 'd');
+	failures += check_char(strbuf_char(sb, 12), '\0');
+	failures += check_ptr(strbuf_insert(sb, 6, " big", 4), sb);
+	failures += check_ptr(strbuf_insert(sb, 0, "Oh, ", 4), sb);
+	failures += check_ptr(strbuf_insert(sb, 999, "!", 1), sb);
+	failures += check_str(strbuf_str(sb), "Oh, Hello, big world!");
+
+	failures += check_ptr(strbuf_erase(sb, 9, 5), sb);
+	failures += check_size_t(strbuf_len(sb), 16);
+	failures += check_ptr(strbuf_erase(sb, 0, 4), sb);
+	failures += check_ptr(strbuf_erase(sb, 11, 999), sb);
+	failures += check_ptr(strbuf_erase(sb, 999, 1), sb);
+	failures += check_str(strbuf_str(sb), "Hello world");
+
+	failures += check_ptr(strbuf_replace_range(sb, 6, 5, "there", 5), sb);
+	failures += check_ptr(strbuf_replace_range(sb, 0, 5, "Hi", 2), sb);
+	failures += check_str(strbuf_str(sb), "Hi there");
+	failures += check_ptr(strbuf_replace_range(sb, 2, 0, ",", 1), sb);
+	failures += check_ptr(strbuf_replace_range(sb, 3, 6, NULL, 0), sb);
+	failures += check_str(strbuf_str(sb), "Hi,");
+
+	/* other operations see the gap closed */
+	strbuf_insert(sb, 2, " you", 4);
+	failures += check_str(strbuf_append(sb, " there", 6), "Hi you, there");
+	strbuf_erase(sb, 2, 4);
+	failures += check_str(strbuf_prepend(sb, "[", 1), "[Hi, there");
+	strbuf_insert(sb, 1, " ", 1);
+	failures += check_str(strbuf_trim(sb), "[ Hi, there");
+	strbuf_insert(sb, 1, "  ", 2);
+	failures += check_int(strbuf_ends_with(sb, "there", 5), 1);
+	failures += check_int(strbuf_cmp(sb, "[   Hi, there", 13), 0);
+	strbuf_erase(sb, 0, 1);
+	strbuf_insert(sb, 0, " ", 1);
+	failures += check_str(strbuf_trim(sb), "Hi, there");
+	strbuf_insert(sb, 3, "\xC3\xA9", 2);
+	failures += check_int(strbuf_utf8_valid(sb), 1);
+	strbuf_erase(sb, 3, 1);
+	failures += check_int(strbuf_utf8_valid(sb), 0);
+
+	strbuf_destroy(sb);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+/* many edits, checked against a plain array */
+unsigned test_insert_many(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 250 * sizeof(void *);
+	unsigned char bytes[250 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	char expect[400];
+	size_t len = 0;
+	strbuf_s *sb = strbuf_new(NULL, 0);
+	unsigned r = 7;
+	for (size_t i = 0; i < 300; ++i) {
+		r = (r * 1103515245) + 12345;
+		size_t pos = len ? ((r >> 8) % (len + 1)) : 0;
+		char c = (char)('a' + (i % 26));
+		if ((r >> 20) % 3 || len < 2) {
+			if (len < 300) {
+				eembed_memmove(expect + pos + 1, expect + pos,
+					       len - pos);
+				expect[pos] = c;
+				++len;
+				strbuf_insert(sb, pos, &c, 1);
+			}
+		} else {
+			size_t n = (pos + 2 <= len) ? 2 : (len - pos);
+			eembed_memmove(expect + pos, expect + pos + n,
+				       len - pos - n);
+			len -= n;
+			strbuf_erase(sb, pos, n);
+		}
+		failures += check_size_t(strbuf_len(sb), len);
+		if (i % 10 == 0) {
+			expect[len] = '\0';
+			failures += check_str(strbuf_str(sb), expect);
+		}
+	}
+	expect[len] = '\0';
+	failures += check_str(strbuf_str(sb), expect);
+
+	strbuf_destroy(sb);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_insert_no_grow(void)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = strbuf_struct_size() + 8;
+	unsigned char buf[200];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, "abc", 3);
+
+	failures += check_ptr(strbuf_insert(sb, 1, "1234", 4), sb);
+	failures += check_ptr(strbuf_insert(sb, 1, "5", 1), NULL);
+	failures += check_ptr(strbuf_replace_range(sb, 0, 1, "XY", 2), NULL);
+	failures += check_str(strbuf_str(sb), "a1234bc");
+	failures += check_ptr(strbuf_replace_range(sb, 1, 4, "X", 1), sb);
+	failures += check_str(strbuf_str(sb), "aXbc");
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_insert(void)
+{
+	unsigned failures = 0;
+
+	failures += test_insert_erase();
+	failures += test_insert_many();
+	failures += test_insert_no_grow();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_insert)
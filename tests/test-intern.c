@@ -0,0 +1,183 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-intern.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+#if EEMBED_HOSTED
+#define Test_intern_keys 1000
+#else
+#define Test_intern_keys 40
+#endif
+
+static size_t test_intern_key(char *buf, size_t i)
+{
+	size_t len = 0;
+	buf[len++] = 'k';
+	do {
+		buf[len++] = (char)('0' + (i % 10));
+		i /= 10;
+	} while (i);
+	buf[len] = '\0';
+	return len;
+}
+
+unsigned test_intern_basic(strbuf_intern_s *table)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *other = strbuf_no_grow(buf, buf_size, "label", 5);
+
+	strbuf_s *a = strbuf_intern(table, "label", 5);
+	strbuf_s *b = strbuf_intern(table, "labels", 5);
+	strbuf_s *c = strbuf_intern(table, "label2", 6);
+	strbuf_s *e = strbuf_intern(table, NULL, 0);
+
+	failures += check_ptr_not_null(a);
+	failures += check_ptr(b, a);
+	failures += check_int(c != a, 1);
+	failures += check_str(strbuf_str(a), "label");
+	failures += check_str(strbuf_str(c), "label2");
+	failures += check_str(strbuf_str(e), "");
+	failures += check_size_t(strbuf_len(a), 5);
+	failures += check_int(strbuf_hash(a) == strbuf_hash(other), 1);
+	failures += check_int(strbuf_eq(a, other), 1);
+	failures += check_size_t(strbuf_intern_count(table), 3);
+
+	/* two references to "label": still there after one release */
+	strbuf_intern_release(table, b);
+	failures += check_size_t(strbuf_intern_count(table), 3);
+	failures += check_ptr(strbuf_intern(table, "label", 5), a);
+	strbuf_intern_release(table, a);
+	strbuf_intern_release(table, a);
+	failures += check_size_t(strbuf_intern_count(table), 2);
+
+	strbuf_intern_release(table, c);
+	strbuf_intern_release(table, e);
+	strbuf_intern_release(table, NULL);
+	failures += check_size_t(strbuf_intern_count(table), 0);
+
+	strbuf_destroy(other);
+
+	return failures;
+}
+
+unsigned test_intern_many(strbuf_intern_s *table)
+{
+	unsigned failures = 0;
+
+	strbuf_s *interned[Test_intern_keys];
+	char key[40];
+
+	for (size_t i = 0; i < Test_intern_keys; ++i) {
+		size_t len = test_intern_key(key, i);
+		interned[i] = strbuf_intern(table, key, len);
+		failures += check_ptr_not_null(interned[i]);
+	}
+	failures += check_size_t(strbuf_intern_count(table), Test_intern_keys);
+
+	/* remove every third, which shifts probe chains back */
+	for (size_t i = 0; i < Test_intern_keys; i += 3) {
+		strbuf_intern_release(table, interned[i]);
+		interned[i] = NULL;
+	}
+
+	for (size_t i = 0; i < Test_intern_keys; ++i) {
+		size_t len = test_intern_key(key, i);
+		strbuf_s *sb = strbuf_intern(table, key, len);
+		failures += check_str(strbuf_str(sb), key);
+		if (interned[i]) {
+			failures += check_ptr(sb, interned[i]);
+			strbuf_intern_release(table, sb);
+		} else {
+			interned[i] = sb;
+		}
+	}
+	failures += check_size_t(strbuf_intern_count(table), Test_intern_keys);
+
+	for (size_t i = 0; i < Test_intern_keys; ++i) {
+		strbuf_intern_release(table, interned[i]);
+	}
+	failures += check_size_t(strbuf_intern_count(table), 0);
+
+	return failures;
+}
+
+unsigned test_intern_immutable(strbuf_intern_s *table)
+{
+	unsigned failures = 0;
+
+	strbuf_s *a = strbuf_intern(table, "interned", 8);
+	uint64_t hash = strbuf_hash(a);
+
+	failures += check_ptr(strbuf_consume(a, 3), NULL);
+	failures += check_ptr(strbuf_append(a, "x", 1), NULL);
+	failures += check_ptr(strbuf_prepend(a, "x", 1), NULL);
+	failures += check_ptr(strbuf_set(a, "x", 1), NULL);
+	failures += check_ptr(strbuf_insert(a, 1, "x", 1), NULL);
+	failures += check_ptr(strbuf_erase(a, 1, 1), NULL);
+	failures += check_ptr(strbuf_to_upper(a), NULL);
+	failures += check_ptr(strbuf_trim(a), NULL);
+	failures += check_ptr(strbuf_expose(a, NULL), NULL);
+	failures += check_ptr(strbuf_take(a, NULL), NULL);
+	char buf[8] = "adopted";
+	failures += check_ptr(strbuf_adopt(a, buf, 7, 8, NULL), NULL);
+
+	/* still canonical, and the same bytes */
+	failures += check_str(strbuf_str(a), "interned");
+	failures += check_int(strbuf_hash(a) == hash, 1);
+	strbuf_s *b = strbuf_intern(table, "interned", 8);
+	failures += check_ptr(b, a);
+
+	/* UTF-8 validity is known from interning, and asking writes nothing */
+	strbuf_s *u = strbuf_intern(table, "h\xC3\xA9", 3);
+	strbuf_s *bad = strbuf_intern(table, "\xFF", 1);
+	for (size_t i = 0; i < 2; ++i) {
+		failures += check_int(strbuf_utf8_valid(a), 1);
+		failures += check_int(strbuf_utf8_valid(u), 1);
+		failures += check_int(strbuf_utf8_valid(bad), 0);
+	}
+	failures += check_size_t(strbuf_utf8_len(u), 2);
+	strbuf_intern_release(table, bad);
+	strbuf_intern_release(table, u);
+
+	strbuf_intern_release(table, b);
+	strbuf_intern_release(table, a);
+	failures += check_size_t(strbuf_intern_count(table), 0);
+
+	return failures;
+}
+
+unsigned test_intern(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *ea = NULL;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 1024 * sizeof(void *);
+	unsigned char bytes[1024 * sizeof(void *)];
+	ea = eembed_bytes_allocator(bytes, bytes_len);
+#endif
+
+	strbuf_intern_s *table = strbuf_intern_new(ea, 1);
+	failures += check_ptr_not_null(table);
+	failures += test_intern_basic(table);
+	failures += test_intern_many(table);
+	failures += test_intern_immutable(table);
+	strbuf_intern_destroy(table);
+
+	table = strbuf_intern_new(ea, 3);
+	failures += check_ptr_not_null(table);
+	failures += test_intern_basic(table);
+	failures += test_intern_many(table);
+
+	/* destroy frees whatever is still interned */
+	strbuf_intern(table, "left", 4);
+	strbuf_intern_destroy(table);
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_intern)
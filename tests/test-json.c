@@ -0,0 +1,157 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-json.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+unsigned test_json_document(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 125 * sizeof(void *);
+	unsigned char bytes[125 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	strbuf_s *sb = strbuf_new(NULL, 0);
+	strbuf_json_s json;
+	strbuf_json_init(&json, sb);
+
+	strbuf_json_object_begin(&json);
+	strbuf_json_key(&json, "name", 4);
+	strbuf_json_string(&json, "a \"b\"\\c\n\x01", 10);
+	strbuf_json_key(&json, "list", 4);
+	strbuf_json_array_begin(&json);
+	strbuf_json_int(&json, -42);
+	strbuf_json_uint(&json, 18446744073709551615ULL);
+	strbuf_json_bool(&json, 1);
+	strbuf_json_bool(&json, 0);
+	strbuf_json_null(&json);
+	strbuf_json_array_begin(&json);
+	strbuf_json_array_end(&json);
+	strbuf_json_object_begin(&json);
+	strbuf_json_object_end(&json);
+	strbuf_json_array_end(&json);
+	strbuf_json_key(&json, "empty", 5);
+	strbuf_json_string(&json, "", 0);
+	const char *rv = strbuf_json_object_end(&json);
+
+	const char *expected = "{\"name\":\"a \\\"b\\\"\\\\c\\n\\u0001\","
+	    "\"list\":[-42,18446744073709551615,true,false,null,[],{}],"
+	    "\"empty\":\"\"}";
+	failures += check_str(rv, expected);
+	failures += check_str(strbuf_str(sb), expected);
+
+	strbuf_destroy(sb);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_json_long_string(void)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, NULL, 0);
+	strbuf_json_s json;
+	strbuf_json_init(&json, sb);
+
+	const char *in = "0123456789abcdef0123456789\tABCDEF\"";
+	const char *expected = "\"0123456789abcdef0123456789\\tABCDEF\\\"\"";
+	failures += check_str(strbuf_json_string(&json, in, 100), expected);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_json_misuse(void)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, NULL, 0);
+	strbuf_json_s json;
+	strbuf_json_init(&json, sb);
+
+	failures += check_ptr(strbuf_json_key(&json, "a", 1), NULL);
+	failures += check_ptr(strbuf_json_array_end(&json), NULL);
+
+	strbuf_json_object_begin(&json);
+	failures += check_ptr(strbuf_json_int(&json, 1), NULL);
+	failures += check_ptr(strbuf_json_array_end(&json), NULL);
+	strbuf_json_key(&json, "a", 1);
+	failures += check_ptr(strbuf_json_key(&json, "b", 1), NULL);
+	failures += check_ptr(strbuf_json_object_end(&json), NULL);
+	strbuf_json_int(&json, 1);
+	strbuf_json_object_end(&json);
+	failures += check_str(strbuf_str(sb), "{\"a\":1}");
+
+	strbuf_set(sb, "", 0);
+	strbuf_json_init(&json, sb);
+	for (size_t i = 0; i < STRBUF_JSON_MAX_DEPTH; ++i) {
+		strbuf_json_array_begin(&json);
+	}
+	failures += check_ptr(strbuf_json_array_begin(&json), NULL);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_json_double(void)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, NULL, 0);
+	strbuf_json_s json;
+	strbuf_json_init(&json, sb);
+
+	double zero = 0.0;
+	strbuf_json_array_begin(&json);
+	strbuf_json_double(&json, zero / zero);
+	strbuf_json_double(&json, 1.0 / zero);
+	strbuf_json_double(&json, zero);
+	strbuf_json_double(&json, -zero);
+#if EEMBED_HOSTED
+	strbuf_json_double(&json, 0.5);
+	strbuf_json_double(&json, 0.1);
+	strbuf_json_double(&json, -1e300);
+	strbuf_json_double(&json, 123.25);
+	strbuf_json_double(&json, -0.001);
+#endif
+	strbuf_json_array_end(&json);
+
+#if EEMBED_HOSTED
+	const char *expected = "[null,null,0,-0,0.5,0.1,-1e+300,123.25,-0.001]";
+	failures += check_str(strbuf_str(sb), expected);
+#else
+	failures += check_str(strbuf_str(sb), "[null,null,0,-0]");
+#endif
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_json(void)
+{
+	unsigned failures = 0;
+
+	failures += test_json_document();
+	failures += test_json_long_string();
+	failures += test_json_misuse();
+	failures += test_json_double();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_json)
@@ -0,0 +1,199 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-mmap.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "strbuf_mmap.h"
+#include "echeck.h"
+
+unsigned test_mmap_allocator(void)
+{
+	unsigned failures = 0;
+
+	struct eembed_allocator small;
+	struct echeck_err_injecting_context ctx;
+	echeck_err_injecting_allocator_init(&small, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	struct strbuf_mmap_allocator ma;
+	size_t threshold = 64 * 1024;
+	struct eembed_allocator *ea =
+	    strbuf_mmap_allocator(&ma, &small, threshold,
+				  STRBUF_MMAP_HUGE_PAGES);
+
+	char *p = (char *)ea->malloc(ea, 100);
+	failures += check_ptr_not_null(p);
+	eembed_memcpy(p, "small", 6);
+	p = (char *)ea->realloc(ea, p, 200);
+	failures += check_str(p, "small");
+
+	/* crossing the threshold, and then growing a mapping */
+	p = (char *)ea->realloc(ea, p, 2 * threshold);
+	failures += check_str(p, "small");
+	p[(2 * threshold) - 1] = 'x';
+	p = (char *)ea->realloc(ea, p, 64 * threshold);
+	failures += check_str(p, "small");
+	failures += check_char(p[(2 * threshold) - 1], 'x');
+	ea->free(ea, p);
+
+	unsigned char *z = (unsigned char *)ea->calloc(ea, threshold, 2);
+	failures += check_ptr_not_null(z);
+	size_t nonzero = 0;
+	for (size_t i = 0; z && i < 2 * threshold; ++i) {
+		nonzero += z[i] ? 1 : 0;
+	}
+	failures += check_size_t(nonzero, 0);
+	ea->free(ea, z);
+
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+
+	return failures;
+}
+
+unsigned test_mmap_strbuf(void)
+{
+	unsigned failures = 0;
+
+	struct eembed_allocator small;
+	struct echeck_err_injecting_context ctx;
+	echeck_err_injecting_allocator_init(&small, eembed_global_allocator,
+					    &ctx, eembed_err_log);
+
+	struct strbuf_mmap_allocator ma;
+	size_t threshold = 64 * 1024;
+	struct eembed_allocator *ea = strbuf_mmap_allocator(&ma, &small,
+							    threshold, 0);
+
+	strbuf_s *sb = strbuf_new_custom(ea, NULL, 0, NULL, 0);
+	failures += check_ptr_not_null(sb);
+	if (!sb) {
+		return failures;
+	}
+	strbuf_grow_by_realloc(sb, 1);
+
+	char chunk[1000];
+	for (size_t i = 0; i < sizeof(chunk); ++i) {
+		chunk[i] = (char)('a' + (i % 26));
+	}
+	size_t total = 0;
+	while (total < (16 * threshold)) {
+		if (!strbuf_append(sb, chunk, sizeof(chunk))) {
+			break;
+		}
+		total += sizeof(chunk);
+	}
+	failures += check_size_t(strbuf_len(sb), total);
+	failures += check_char(strbuf_char(sb, total - 1), chunk[999]);
+	failures += check_char(strbuf_char(sb, total), '\0');
+	failures += check_char(strbuf_char(sb, total - 1000), 'a');
+
+	/* once past the threshold, growth does not use the small allocator */
+	unsigned long small_bytes = ctx.alloc_bytes;
+	strbuf_append(sb, chunk, sizeof(chunk));
+	strbuf_append_f(sb, 40, "%zu", total);
+	failures += check_int(ctx.alloc_bytes - small_bytes < 100, 1);
+
+	strbuf_trim_l(sb);
+	strbuf_consume(sb, 1000);
+	strbuf_insert(sb, 10, "inserted", 8);
+	failures += check_int(strbuf_starts_with(sb, "abcdefghijinserted", 18),
+			      1);
+
+	strbuf_destroy(sb);
+	failures += check_unsigned_int_m(ctx.frees, ctx.allocs, "alloc/free");
+
+	return failures;
+}
+
+/* forwards to the global allocator, counting the reallocs */
+static struct eembed_allocator *test_mmap_orig;
+static unsigned test_mmap_reallocs;
+
+static void *test_mmap_malloc(struct eembed_allocator *ea, size_t size)
+{
+	(void)ea;
+	return test_mmap_orig->malloc(test_mmap_orig, size);
+}
+
+static void *test_mmap_calloc(struct eembed_allocator *ea, size_t nmemb,
+			      size_t size)
+{
+	(void)ea;
+	return test_mmap_orig->calloc(test_mmap_orig, nmemb, size);
+}
+
+static void *test_mmap_realloc(struct eembed_allocator *ea, void *ptr,
+			       size_t size)
+{
+	(void)ea;
+	++test_mmap_reallocs;
+	return test_mmap_orig->realloc(test_mmap_orig, ptr, size);
+}
+
+static void *test_mmap_reallocarray(struct eembed_allocator *ea, void *ptr,
+				    size_t nmemb, size_t size)
+{
+	(void)ea;
+	++test_mmap_reallocs;
+	return test_mmap_orig->reallocarray(test_mmap_orig, ptr, nmemb, size);
+}
+
+static void test_mmap_free(struct eembed_allocator *ea, void *ptr)
+{
+	(void)ea;
+	test_mmap_orig->free(test_mmap_orig, ptr);
+}
+
+/* growth only goes through realloc once asked to, whatever the size */
+unsigned test_mmap_grow_by_realloc(void)
+{
+	unsigned failures = 0;
+
+	test_mmap_orig = eembed_global_allocator;
+	struct eembed_allocator counting;
+	counting.context = NULL;
+	counting.malloc = test_mmap_malloc;
+	counting.calloc = test_mmap_calloc;
+	counting.realloc = test_mmap_realloc;
+	counting.reallocarray = test_mmap_reallocarray;
+	counting.free = test_mmap_free;
+
+	char chunk[1000];
+	eembed_memset(chunk, 'x', sizeof(chunk));
+	for (int on = 0; on < 2; ++on) {
+		test_mmap_reallocs = 0;
+		strbuf_s *sb = strbuf_new_custom(&counting, NULL, 0, NULL, 0);
+		failures += check_ptr_not_null(sb);
+		if (!sb) {
+			return failures;
+		}
+		strbuf_grow_by_realloc(sb, on);
+		for (size_t i = 0; i < 1000; ++i) {
+			strbuf_append(sb, chunk, sizeof(chunk));
+		}
+		failures += check_size_t(strbuf_len(sb), 1000 * 1000);
+		failures += check_int(test_mmap_reallocs > 0, on);
+		strbuf_destroy(sb);
+	}
+
+	return failures;
+}
+
+unsigned test_mmap(void)
+{
+	unsigned failures = 0;
+	if (!EEMBED_HOSTED) {
+		struct eembed_log *log = eembed_out_log;
+		log->append_s(log, " (skipping test_mmap)");
+		log->append_eol(log);
+		return 0;
+	}
+
+	failures += test_mmap_allocator();
+	failures += test_mmap_strbuf();
+	failures += test_mmap_grow_by_realloc();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_mmap)
@@ -182,6 +182,32 @@ unsigned test_from_char_buf(void)
 	return failures;
 }
 
+unsigned test_static_macro(void)
+{
+	unsigned failures = 0;
+
+	STRBUF_STATIC(sb, 2 * STRBUF_INT64_MAX_CHARS);
+	failures += check_ptr_not_null(sb);
+	size_t avail = strbuf_avail(sb);
+	failures += check_int(avail >= (2 * STRBUF_INT64_MAX_CHARS), 1);
+	size_t struct_size = strbuf_struct_size();
+	failures += check_int(STRBUF_STRUCT_SIZE_MAX >= struct_size, 1);
+
+	strbuf_append_int(sb, INT64_MIN);
+	strbuf_append_int(sb, INT64_MIN);
+	failures += check_str(strbuf_str(sb),
+			      "-9223372036854775808-9223372036854775808");
+	for (size_t i = 2 * STRBUF_INT64_MAX_CHARS; i < avail; ++i) {
+		strbuf_append(sb, "x", 1);
+	}
+	failures += check_size_t(strbuf_avail(sb), 0);
+	failures += check_ptr(strbuf_append(sb, "x", 1), NULL);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
 /* TODO: split into 4 tests? */
 unsigned test_new_no_grow(void)
 {
@@ -191,6 +217,7 @@ unsigned test_new_no_grow(void)
 	failures += test_custom_small_buffer();
 	failures += test_no_grow();
 	failures += test_from_char_buf();
+	failures += test_static_macro();
 
 	return failures;
 }
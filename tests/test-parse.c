@@ -0,0 +1,145 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-parse.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+#if EEMBED_HOSTED
+#include <stdlib.h>
+#endif
+
+unsigned test_parse_int_inner(const char *in, size_t consumed, int64_t val)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	/* the number is not at the start, and is followed by more text */
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, "x=", 2);
+	strbuf_append(sb, in, eembed_strlen(in));
+	strbuf_append(sb, ";9", 2);
+
+	int64_t i = 12345;
+	size_t len = eembed_strlen(in);
+	failures += check_size_t_m(strbuf_parse_int64(sb, 2, len, &i),
+				   consumed, in);
+	failures += check_long_m(i, consumed ? val : 12345, in);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_parse_uint_inner(const char *in, size_t consumed, uint64_t val)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, in, eembed_strlen(in));
+
+	uint64_t u = 12345;
+	failures += check_size_t_m(strbuf_parse_uint64(sb, 0, SIZE_MAX, &u),
+				   consumed, in);
+	failures += check_int_m(u == (consumed ? val : 12345), 1, in);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_parse_double_inner(const char *in, size_t consumed, double val)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, in, eembed_strlen(in));
+
+	double d = 0.5;
+#if EEMBED_HOSTED
+	char *end = NULL;
+	val = strtod(in, &end);
+	consumed = (size_t)(end - in);
+#endif
+	failures += check_size_t_m(strbuf_parse_double(sb, 0, SIZE_MAX, &d),
+				   consumed, in);
+	if (val == val) {
+		failures += check_int_m(d == (consumed ? val : 0.5), 1, in);
+	} else {
+		failures += check_int_m(d != d, 1, in);
+	}
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_parse(void)
+{
+	unsigned failures = 0;
+
+	failures += test_parse_int_inner("0", 1, 0);
+	failures += test_parse_int_inner("-0", 2, 0);
+	failures += test_parse_int_inner("+42", 3, 42);
+	failures += test_parse_int_inner("-42abc", 3, -42);
+	failures += test_parse_int_inner("12345678", 8, 12345678);
+	failures += test_parse_int_inner("1234567890123456789", 19,
+					 1234567890123456789LL);
+	failures += test_parse_int_inner("0000000000000000000000000007", 28, 7);
+	failures += test_parse_int_inner("9223372036854775807", 19, INT64_MAX);
+	failures += test_parse_int_inner("-9223372036854775808", 20,
+					 INT64_MIN);
+	failures += test_parse_int_inner("9223372036854775808", 0, 0);
+	failures += test_parse_int_inner("-9223372036854775809", 0, 0);
+	failures += test_parse_int_inner("1234567a90", 7, 1234567);
+	failures += test_parse_int_inner("", 0, 0);
+	failures += test_parse_int_inner("-", 0, 0);
+	failures += test_parse_int_inner(" 1", 0, 0);
+	failures += test_parse_int_inner("1 2", 1, 1);
+
+	failures += test_parse_uint_inner("18446744073709551615", 20,
+					  UINT64_MAX);
+	failures += test_parse_uint_inner("18446744073709551616", 0, 0);
+	failures += test_parse_uint_inner("99999999999999999999", 0, 0);
+	failures += test_parse_uint_inner("-1", 0, 0);
+	failures += test_parse_uint_inner("+8", 2, 8);
+
+	failures += test_parse_double_inner("0", 1, 0.0);
+	failures += test_parse_double_inner("1.5", 3, 1.5);
+	failures += test_parse_double_inner("-0.25", 5, -0.25);
+	failures += test_parse_double_inner("12345.678", 9, 12345.678);
+	failures += test_parse_double_inner(".5", 2, 0.5);
+	failures += test_parse_double_inner("5.", 2, 5.0);
+	failures += test_parse_double_inner("1e3", 3, 1000.0);
+	failures += test_parse_double_inner("1E-3x", 4, 0.001);
+	failures += test_parse_double_inner("2e", 1, 2.0);
+	failures += test_parse_double_inner("2e+", 1, 2.0);
+	failures += test_parse_double_inner(".", 0, 0.0);
+	failures += test_parse_double_inner("-", 0, 0.0);
+	failures += test_parse_double_inner("0.000001", 8, 0.000001);
+	failures += test_parse_double_inner("9007199254740993", 16,
+					    9007199254740993.0);
+	failures += test_parse_double_inner("Infinity", 8, 1e308 * 10);
+	failures += test_parse_double_inner("-inf", 4, -1e308 * 10);
+#if EEMBED_HOSTED
+	/* beyond the fast path; the expected values come from strtod */
+	failures += test_parse_double_inner("nan", 3, 0);
+	failures += test_parse_double_inner("1e23", 4, 0);
+	failures += test_parse_double_inner("1.7976931348623157e308", 22, 0);
+	failures += test_parse_double_inner("1e309", 5, 0);
+	failures += test_parse_double_inner("4.9e-324", 8, 0);
+	failures += test_parse_double_inner("1e-400", 6, 0);
+	failures +=
+	    test_parse_double_inner("0.1000000000000000055511151231257827",
+				    36, 0);
+	failures += test_parse_double_inner("123456789012345678901234567890",
+					    30, 0);
+	failures += test_parse_double_inner("2.2250738585072011e-308", 23, 0);
+#endif
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_parse)
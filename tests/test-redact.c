@@ -0,0 +1,152 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-redact.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+unsigned test_redact_basics(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 500 * sizeof(void *);
+	unsigned char bytes[500 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	const char *patterns[] = { "he", "she", "his", "hers", "secret" };
+	strbuf_redactor_s *r = strbuf_redactor_new(patterns, 5, 0);
+	failures += check_ptr_not_null(r);
+	if (!r) {
+		eembed_global_allocator = orig;
+		return failures;
+	}
+
+	strbuf_s *sb = strbuf_new("ushers say his secret", 21);
+	/* "she", "he" and "hers" overlap, and are all masked */
+	failures += check_str(strbuf_redact(r, sb, '*'),
+			      "u***** say *** ******");
+	failures += check_size_t(strbuf_len(sb), 21);
+
+	strbuf_set(sb, "nothing to see", 14);
+	failures += check_str(strbuf_redact(r, sb, '*'), "nothing to see");
+
+	/* across a gap, and leaving a clone alone */
+	strbuf_set(sb, "a scret", 7);
+	strbuf_insert(sb, 3, "e", 1);
+	strbuf_s *clone = strbuf_clone(sb);
+	failures += check_str(strbuf_redact(r, clone, '#'), "a ######");
+	failures += check_str(strbuf_str(sb), "a secret");
+	strbuf_destroy(clone);
+
+	strbuf_destroy(sb);
+	strbuf_redactor_destroy(r);
+
+	const char *empty[] = { "ok", "" };
+	failures += check_ptr(strbuf_redactor_new(empty, 2, 0), NULL);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_redact_tokens(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 500 * sizeof(void *);
+	unsigned char bytes[500 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	const char *patterns[] = { "bearer ", "ghp_", "password=" };
+	unsigned flags = STRBUF_REDACT_ICASE | STRBUF_REDACT_TOKEN;
+	strbuf_redactor_s *r = strbuf_redactor_new(patterns, 3, flags);
+
+	const char *line = "Authorization: Bearer abc.def, key=ghp_XYZ1 "
+	    "PASSWORD=hunter2&user=me";
+	strbuf_s *sb = strbuf_new(line, eembed_strlen(line));
+	failures += check_str(strbuf_redact(r, sb, 'x'),
+			      "Authorization: xxxxxxxxxxxxxx, key=xxxxxxxx "
+			      "xxxxxxxxxxxxxxxx&user=me");
+
+	strbuf_destroy(sb);
+	strbuf_redactor_destroy(r);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+/* each pattern on its own, at every position */
+static void redact_naive(const char *const *patterns, size_t num, char *s,
+			 size_t len)
+{
+	char orig[64];
+	eembed_memcpy(orig, s, len);
+	for (size_t i = 0; i < num; ++i) {
+		size_t p_len = eembed_strlen(patterns[i]);
+		for (size_t j = 0; j + p_len <= len; ++j) {
+			if (eembed_memcmp(orig + j, patterns[i], p_len) == 0) {
+				eembed_memset(s + j, '-', p_len);
+			}
+		}
+	}
+}
+
+unsigned test_redact_against_naive(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 500 * sizeof(void *);
+	unsigned char bytes[500 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	const char *patterns[] = { "aba", "b", "abab", "bba", "aaaa" };
+	strbuf_redactor_s *r = strbuf_redactor_new(patterns, 5, 0);
+	strbuf_s *sb = strbuf_new(NULL, 0);
+	char subject[64];
+	char expect[64];
+	unsigned seed = 5;
+	for (size_t i = 0; i < 500; ++i) {
+		seed = (seed * 1103515245) + 12345;
+		size_t len = (seed >> 16) % 40;
+		for (size_t j = 0; j < len; ++j) {
+			seed = (seed * 1103515245) + 12345;
+			subject[j] = "abc"[(seed >> 16) % 3];
+		}
+		subject[len] = '\0';
+		eembed_memcpy(expect, subject, len + 1);
+		redact_naive(patterns, 5, expect, len);
+
+		strbuf_set(sb, subject, len);
+		const char *actual = strbuf_redact(r, sb, '-');
+		if (eembed_strcmp(actual, expect) != 0) {
+			failures += check_str(subject, "");
+			failures += check_str(actual, expect);
+		}
+	}
+	strbuf_destroy(sb);
+	strbuf_redactor_destroy(r);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_redact(void)
+{
+	unsigned failures = 0;
+
+	failures += test_redact_basics();
+	failures += test_redact_tokens();
+	failures += test_redact_against_naive();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_redact)
@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-reserve-tail.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+/* a producer which knows nothing of strbufs, as read(2) would be */
+static size_t produce(char *dest, size_t avail, const char *src, size_t len)
+{
+	size_t n = (len < avail) ? len : avail;
+	eembed_memcpy(dest, src, n);
+	return n;
+}
+
+unsigned test_reserve_tail_grow(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 250 * sizeof(void *);
+	unsigned char bytes[250 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	strbuf_s *sb = strbuf_new("head:", 5);
+	size_t avail = 0;
+	char *tail = strbuf_reserve_tail(sb, 10, &avail);
+	failures += check_ptr_not_null(tail);
+	failures += check_int(avail >= 10, 1);
+
+	/* binary-safe: the length is what was committed, NULs and all */
+	size_t n = produce(tail, avail, "a\0b\0c", 5);
+	failures += check_str(strbuf_commit(sb, n), "head:a");
+	failures += check_size_t(strbuf_len(sb), 10);
+	failures += check_char(strbuf_char(sb, 7), 'b');
+	failures += check_char(strbuf_char(sb, 9), 'c');
+	failures += check_char(strbuf_char(sb, 10), '\0');
+
+	/* more than is there, so it grows */
+	avail = 0;
+	tail = strbuf_reserve_tail(sb, 1000, &avail);
+	failures += check_int(tail != NULL && avail >= 1000, 1);
+	for (size_t i = 0; i < avail; ++i) {
+		tail[i] = 'x';
+	}
+	strbuf_commit(sb, 3);
+	failures += check_size_t(strbuf_len(sb), 13);
+	failures += check_char(strbuf_char(sb, 12), 'x');
+	failures += check_char(strbuf_char(sb, 13), '\0');
+
+	/* what was written but not committed is not in the string */
+	strbuf_set(sb, "abc", 3);
+	tail = strbuf_reserve_tail(sb, 100, &avail);
+	for (size_t i = 0; i < avail; ++i) {
+		tail[i] = 'x';
+	}
+	failures += check_str(strbuf_commit(sb, 3), "abcxxx");
+	size_t size = 0;
+	char *buf = strbuf_expose(sb, &size);
+	failures += check_str(buf, "abcxxx");
+	failures += check_str(strbuf_return(sb), "abcxxx");
+	failures += check_size_t(strbuf_len(sb), 6);
+	failures += check_str(strbuf_append(sb, "def", 3), "abcxxxdef");
+
+	strbuf_reserve_tail(sb, 0, NULL);
+	failures += check_str(strbuf_commit(sb, 0), "abcxxxdef");
+
+	/* the NULL would not fit after SIZE_MAX bytes */
+	failures += check_ptr(strbuf_reserve_tail(sb, SIZE_MAX, &avail), NULL);
+	failures += check_str(strbuf_str(sb), "abcxxxdef");
+
+	strbuf_destroy(sb);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_reserve_tail_no_grow(void)
+{
+	unsigned failures = 0;
+
+	STRBUF_STATIC(sb, 20);
+	size_t avail = 0;
+	char *tail = strbuf_reserve_tail(sb, 20, &avail);
+	failures += check_ptr_not_null(tail);
+	strbuf_commit(sb, produce(tail, avail, "0123456789", 10));
+	failures += check_str(strbuf_str(sb), "0123456789");
+
+	size_t left = strbuf_avail(sb);
+	failures += check_ptr(strbuf_reserve_tail(sb, left + 1, &avail), NULL);
+	failures += check_ptr_not_null(strbuf_reserve_tail(sb, left, &avail));
+	failures += check_size_t(avail, left);
+	failures += check_ptr(strbuf_reserve_tail(sb, SIZE_MAX, &avail), NULL);
+
+	/* room made by consuming is used before failing */
+	strbuf_consume(sb, 5);
+	tail = strbuf_reserve_tail(sb, left + 5, &avail);
+	failures += check_ptr_not_null(tail);
+	strbuf_commit(sb, produce(tail, avail, "!", 1));
+	failures += check_str(strbuf_str(sb), "56789!");
+
+	return failures;
+}
+
+unsigned test_reserve_tail_ring(void)
+{
+	unsigned failures = 0;
+
+	unsigned char mem[STRBUF_NO_GROW_SIZE(16)];
+	strbuf_s *sb = strbuf_ring(mem, sizeof(mem));
+	size_t cap = strbuf_avail(sb);
+
+	const char *abc = "abcdefghijklmnopqrstuvwxyz";
+	size_t written = 0;
+	for (size_t i = 0; i < 10; ++i) {
+		size_t avail = 0;
+		char *tail = strbuf_reserve_tail(sb, 5, &avail);
+		failures += check_int(tail != NULL && avail >= 5, 1);
+		for (size_t j = 0; j < 5; ++j) {
+			tail[j] = abc[(written + j) % 26];
+		}
+		strbuf_commit(sb, 5);
+		written += 5;
+	}
+	size_t len = strbuf_len(sb);
+	failures += check_int(len > 0 && len <= cap, 1);
+	failures += check_char(strbuf_char(sb, len - 1),
+			       abc[(written - 1) % 26]);
+	failures += check_char(strbuf_char(sb, 0), abc[(written - len) % 26]);
+
+	/* more than the ring holds is not reserved, and nothing is lost */
+	failures += check_ptr(strbuf_reserve_tail(sb, cap + 1, NULL), NULL);
+	failures += check_ptr(strbuf_reserve_tail(sb, SIZE_MAX, NULL), NULL);
+	failures += check_size_t(strbuf_len(sb), len);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_reserve_tail(void)
+{
+	unsigned failures = 0;
+
+	failures += test_reserve_tail_grow();
+	failures += test_reserve_tail_no_grow();
+	failures += test_reserve_tail_ring();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_reserve_tail)
@@ -0,0 +1,244 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-ring.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+static size_t spans_copy(strbuf_s *sb, char *out)
+{
+	const char *a, *b;
+	size_t a_len, b_len;
+	strbuf_spans(sb, &a, &a_len, &b, &b_len);
+	eembed_memcpy(out, a, a_len);
+	eembed_memcpy(out + a_len, b, b_len);
+	out[a_len + b_len] = '\0';
+	return a_len + b_len;
+}
+
+unsigned test_ring_basics(void)
+{
+	unsigned failures = 0;
+
+	unsigned char mem[STRBUF_NO_GROW_SIZE(16)];
+	strbuf_s *sb = strbuf_ring(mem, sizeof(mem));
+	failures += check_ptr_not_null(sb);
+	if (!sb) {
+		return failures;
+	}
+	size_t cap = strbuf_avail(sb);
+	failures += check_int(cap >= 16, 1);
+
+	/* fill exactly, then each append evicts as much as it adds */
+	for (size_t i = 0; i < cap; ++i) {
+		char c = (char)('a' + (i % 26));
+		failures += check_int(strbuf_append(sb, &c, 1) != NULL, 1);
+	}
+	failures += check_size_t(strbuf_len(sb), cap);
+	failures += check_char(strbuf_char(sb, 0), 'a');
+
+	const char *a, *b;
+	size_t a_len, b_len;
+	strbuf_spans(sb, &a, &a_len, &b, &b_len);
+	const char *first = a;
+
+	failures += check_int(strbuf_append(sb, "123", 3) != NULL, 1);
+	/* while wrapped, a byte holds the NULL of the older part */
+	size_t len = strbuf_len(sb);
+	failures += check_int(len == cap || len == cap - 1, 1);
+	failures += check_char(strbuf_char(sb, len - 1), '3');
+	failures += check_char(strbuf_char(sb, len), '\0');
+
+	/* wrapped, and nothing was moved */
+	strbuf_spans(sb, &a, &a_len, &b, &b_len);
+	failures += check_ptr(a, first + (cap + 3 - len));
+	failures += check_size_t(a_len + b_len, len);
+	failures += check_int(eembed_strncmp(b + b_len - 3, "123", 3) == 0, 1);
+
+	char expect[80];
+	char out[80];
+	size_t skip = cap + 3 - len;
+	for (size_t i = 0; i < len - 3; ++i) {
+		expect[i] = (char)('a' + ((i + skip) % 26));
+	}
+	eembed_memcpy(expect + len - 3, "123", 4);
+	spans_copy(sb, out);
+	failures += check_str(out, expect);
+	failures += check_char(strbuf_char(sb, 0), expect[0]);
+
+	/* and unwrapping gives the same string */
+	failures += check_str(strbuf_linearize(sb), expect);
+	failures += check_size_t(strbuf_len(sb), len);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+/* appends of mixed sizes, checked against the tail of a plain array */
+unsigned test_ring_many(void)
+{
+	unsigned failures = 0;
+
+	unsigned char mem[STRBUF_NO_GROW_SIZE(37)];
+	strbuf_s *sb = strbuf_ring(mem, sizeof(mem));
+	size_t cap = strbuf_avail(sb);
+
+	char all[2000];
+	size_t all_len = 0;
+	char chunk[50];
+	char out[200];
+	unsigned r = 11;
+	for (size_t i = 0; i < 200 && all_len < 1900; ++i) {
+		r = (r * 1103515245) + 12345;
+		size_t n = ((r >> 16) % (cap + 5)) % 40;
+		for (size_t j = 0; j < n; ++j) {
+			chunk[j] = (char)('A' + ((all_len + j) % 26));
+		}
+		eembed_memcpy(all + all_len, chunk, n);
+		all_len += n;
+		all[all_len] = '\0';
+		strbuf_append(sb, chunk, n);
+
+		size_t keep = strbuf_len(sb);
+		size_t least = all_len < (cap - 1) ? all_len : (cap - 1);
+		failures += check_int(keep >= least && keep <= cap, 1);
+		const char *want = all + all_len - keep;
+		failures += check_char(strbuf_char(sb, 0), want[0]);
+		spans_copy(sb, out);
+		failures += check_str(out, want);
+		if (i % 17 == 0) {
+			failures += check_str(strbuf_str(sb), want);
+		}
+	}
+
+	/* one append larger than the ring keeps its own end */
+	char big[200];
+	for (size_t i = 0; i < 199; ++i) {
+		big[i] = (char)('0' + (i % 10));
+	}
+	big[199] = '\0';
+	strbuf_append(sb, big, 199);
+	failures += check_str(strbuf_str(sb), big + 199 - cap);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_ring_formats(void)
+{
+	unsigned failures = 0;
+
+	unsigned char mem[STRBUF_NO_GROW_SIZE(24)];
+	strbuf_s *sb = strbuf_ring(mem, sizeof(mem));
+	size_t cap = strbuf_avail(sb);
+
+	for (int i = 0; i < 100; ++i) {
+		strbuf_append_int(sb, i);
+		strbuf_append_hex(sb, "\x0A", 1);
+		strbuf_append_escaped(sb, "<", 1, strbuf_escape_html);
+	}
+	/* ... "990a&lt;" */
+	const char *s = strbuf_str(sb);
+	size_t len = strbuf_len(sb);
+	failures += check_int(len <= cap && len + 9 > cap, 1);
+	failures += check_str(s + len - 8, "990a&lt;");
+	failures += check_int(strbuf_utf8_valid(sb), 1);
+
+	/* other edits see the ring unwrapped */
+	strbuf_set(sb, "xyz", 3);
+	failures += check_str(strbuf_prepend(sb, "w", 1), "wxyz");
+	failures += check_str(strbuf_append(sb, "!", 1), "wxyz!");
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+/* an insert leaves a gap, which appending must close before wrapping */
+unsigned test_ring_after_insert(void)
+{
+	unsigned failures = 0;
+
+	unsigned char mem[STRBUF_NO_GROW_SIZE(16)];
+	strbuf_s *sb = strbuf_ring(mem, sizeof(mem));
+	size_t cap = strbuf_avail(sb);
+
+	strbuf_append(sb, "abcdefghij", 10);
+	strbuf_insert(sb, 2, "XY", 2);
+	for (size_t i = 0; i < 20; ++i) {
+		strbuf_append(sb, "0123456789", 10);
+	}
+	size_t len = strbuf_len(sb);
+	failures += check_int(len <= cap && len + 2 >= cap, 1);
+
+	char out[80];
+	failures += check_size_t(spans_copy(sb, out), len);
+	failures += check_str(out + len - 10, "0123456789");
+
+	/* the oldest part wraps from here */
+	strbuf_set(sb, "abcdefghij", 10);
+	strbuf_insert(sb, 10, "XY", 2);
+	strbuf_append(sb, "0123", 4);
+	failures += check_size_t(spans_copy(sb, out), strbuf_len(sb));
+	failures += check_str(out, "abcdefghijXY0123" + (16 - strbuf_len(sb)));
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_ring_adopt(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 125 * sizeof(void *);
+	unsigned char bytes[125 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	unsigned char mem[STRBUF_NO_GROW_SIZE(16)];
+	strbuf_s *sb = strbuf_ring(mem, sizeof(mem));
+	for (size_t i = 0; i < 10; ++i) {
+		strbuf_append(sb, "0123456789", 10);
+	}
+
+	struct eembed_allocator *heap = eembed_global_allocator;
+	char *buf = (char *)heap->malloc(heap, 8);
+	eembed_memcpy(buf, "adopted", 8);
+	failures += check_ptr(strbuf_adopt(sb, buf, 7, 8, NULL), sb);
+	failures += check_size_t(strbuf_len(sb), 7);
+	char out[80];
+	failures += check_size_t(spans_copy(sb, out), 7);
+	failures += check_str(out, "adopted");
+
+	/* no longer a ring: it grows rather than evicting */
+	for (size_t i = 0; i < 4; ++i) {
+		strbuf_append(sb, "0123456789", 10);
+	}
+	failures += check_size_t(strbuf_len(sb), 47);
+	failures += check_int(strbuf_starts_with(sb, "adopted", 7), 1);
+
+	strbuf_destroy(sb);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_ring(void)
+{
+	unsigned failures = 0;
+
+	failures += test_ring_basics();
+	failures += test_ring_many();
+	failures += test_ring_formats();
+	failures += test_ring_after_insert();
+	failures += test_ring_adopt();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_ring)
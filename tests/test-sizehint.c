@@ -0,0 +1,86 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-sizehint.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+static size_t capacity(strbuf_s *sb)
+{
+	return strbuf_len(sb) + strbuf_avail(sb);
+}
+
+unsigned test_sizehint_learns(size_t len, size_t max_size)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 125 * sizeof(void *);
+	unsigned char bytes[125 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+
+	strbuf_sizehint_s hint = STRBUF_SIZEHINT_INIT(max_size);
+
+	char str[len + 1];
+	eembed_memset(str, 'x', len);
+	str[len] = '\0';
+
+	strbuf_s *sb = strbuf_new_hinted(&hint, NULL, 0);
+	failures += check_ptr_not_null(sb);
+	if (!sb) {
+		return failures;
+	}
+	failures += check_int(capacity(sb) < len ? 1 : 0, 1);
+	strbuf_append(sb, str, len);
+	strbuf_destroy(sb);
+
+	for (size_t i = 0; i < 20; ++i) {
+		sb = strbuf_new_hinted(&hint, NULL, 0);
+		strbuf_append(sb, str, (i == 0) ? 3 : len);
+		strbuf_destroy(sb);
+	}
+
+	sb = strbuf_new_hinted(&hint, "", 0);
+	failures += check_ptr_not_null(sb);
+	if (!sb) {
+		return failures;
+	}
+	if (max_size) {
+		failures += check_int(capacity(sb) < max_size ? 1 : 0, 1);
+	} else {
+		failures += check_int(capacity(sb) >= len ? 1 : 0, 1);
+		failures += check_int(capacity(sb) < (2 * len) ? 1 : 0, 1);
+	}
+	failures += check_str(strbuf_append(sb, str, len), str);
+	strbuf_destroy(sb);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_sizehint_null(void)
+{
+	unsigned failures = 0;
+
+	strbuf_s *sb = strbuf_new_hinted(NULL, "foo", 3);
+	failures += check_str(strbuf_str(sb), "foo");
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_sizehint(void)
+{
+	unsigned failures = 0;
+
+	failures += test_sizehint_learns(40, 0);
+	failures += test_sizehint_learns(90, 0);
+	failures += test_sizehint_learns(90, 64);
+	failures += test_sizehint_null();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_sizehint)
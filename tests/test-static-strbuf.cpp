@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-static-strbuf.cpp */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.hpp"
+#include "echeck.h"
+
+#include <cstdint>
+
+namespace ls = libstrbuf;
+
+static_assert(ls::max_chars<int8_t>() >= 4);
+static_assert(ls::max_chars<uint64_t>() >= 20);
+static_assert(ls::max_chars<int64_t>() >= 20);
+static_assert(ls::max_chars<bool>() == 5);
+static_assert(!std::is_move_constructible_v<ls::static_strbuf<8>>);
+
+/* a log line, proven at compile time to fit */
+constexpr const char log_prefix[] = "req ";
+constexpr std::size_t log_line_max = (sizeof(log_prefix) - 1)
+    + ls::max_chars_sum<uint32_t, char, int64_t, char, double>();
+
+unsigned test_static_strbuf_fits(void)
+{
+	unsigned failures = 0;
+
+	ls::static_strbuf<log_line_max> line;
+	failures += check_size_t(line.capacity(), log_line_max);
+	failures += check_int(strbuf_avail(line.get()) >= log_line_max, 1);
+
+	line << log_prefix << (uint32_t)4294967295U << ' ' << INT64_MIN
+	    << ' ' << -2.2250738585072014e-308;
+	failures += check_int(line.fail(), 0);
+	failures += check_str(line.c_str(),
+			      "req 4294967295 -9223372036854775808"
+			      " -2.2250738585072014e-308");
+	failures += check_int(line.size() <= log_line_max, 1);
+
+	return failures;
+}
+
+unsigned test_static_strbuf_full(void)
+{
+	unsigned failures = 0;
+
+	/* the buffer may be rounded up a little */
+	ls::static_strbuf<5> s("abc");
+	size_t room = 3 + strbuf_avail(s.get());
+	failures += check_str(s.c_str(), "abc");
+	failures += check_int(s.append("de"), 1);
+	while (s.size() < room) {
+		s.append("f");
+	}
+	failures += check_int(s.append("g"), 0);
+	failures += check_size_t(s.size(), room);
+
+	/* the buffer is inside the object */
+	const unsigned char *obj = (const unsigned char *)&s;
+	const unsigned char *str = (const unsigned char *)s.c_str();
+	failures += check_int(str >= obj && str < obj + sizeof(s), 1);
+
+	s.set("");
+	s << 123 << 45;
+	failures += check_int(s.fail(), 0);
+	while (s.size() < room) {
+		s << 6;
+	}
+	s << 7;
+	failures += check_int(s.fail(), 1);
+	failures += check_size_t(s.size(), room);
+
+	return failures;
+}
+
+unsigned test_static_strbuf(void)
+{
+	unsigned failures = 0;
+
+	failures += test_static_strbuf_fits();
+	failures += test_static_strbuf_full();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_static_strbuf)
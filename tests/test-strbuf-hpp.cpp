@@ -0,0 +1,108 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-strbuf-hpp.cpp */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.hpp"
+#include "echeck.h"
+
+#include <cstdint>
+#include <string>
+
+/* libstrbuf::strbuf is named in full, as ::strbuf is the C struct */
+namespace ls = libstrbuf;
+
+static_assert(!std::is_copy_constructible_v<ls::strbuf>);
+static_assert(!std::is_copy_assignable_v<ls::strbuf>);
+static_assert(std::is_nothrow_move_constructible_v<ls::strbuf>);
+static_assert(std::is_nothrow_move_assignable_v<ls::strbuf>);
+
+unsigned test_strbuf_hpp_basics(void)
+{
+	unsigned failures = 0;
+
+	ls::strbuf s("hello");
+	failures += check_str(s.c_str(), "hello");
+	failures += check_size_t(s.size(), 5);
+
+	std::string_view v = s;
+	failures += check_size_t(v.size(), 5);
+	failures += check_ptr(v.data(), s.c_str());
+
+	std::string_view part("worldwide", 5);
+	failures += check_int(s.append(", "), 1);
+	failures += check_int(s.append(part), 1);
+	failures += check_int(s.append(std::string_view()), 1);
+	failures += check_str(s.c_str(), "hello, world");
+
+	ls::strbuf t(std::move(s));
+	failures += check_str(t.c_str(), "hello, world");
+	failures += check_ptr(s.get(), NULL);
+	failures += check_size_t(s.view().size(), 0);
+	failures += check_int(s.fail(), 1);
+
+	s = std::move(t);
+	failures += check_str(s.c_str(), "hello, world");
+	failures += check_ptr(t.get(), NULL);
+
+	ls::strbuf c = s.clone();
+	failures += check_ptr(c.c_str(), s.c_str());
+	c.set("changed");
+	failures += check_str(c.c_str(), "changed");
+	failures += check_str(s.c_str(), "hello, world");
+
+	strbuf_s *raw = c.release();
+	failures += check_str(strbuf_str(raw), "changed");
+	strbuf_destroy(raw);
+
+	return failures;
+}
+
+unsigned test_strbuf_hpp_stream(void)
+{
+	unsigned failures = 0;
+
+	ls::strbuf s;
+	s << "i=" << -42 << ' ' << (uint64_t)18446744073709551615ULL;
+	s << " b=" << true << " f=" << 0.1 << " h=" << 1.5f;
+	s << " " << std::string("str") << " " << (short)7;
+	failures += check_int(s.fail(), 0);
+	failures += check_int(!!s, 1);
+	failures += check_str(s.c_str(),
+			      "i=-42 18446744073709551615 b=true f=0.1 h=1.5"
+			      " str 7");
+
+	s.set("");
+	s << 1e300 << " " << -5e-324 << " " << INT64_MIN;
+	failures += check_str(s.c_str(),
+			      "1e+300 -5e-324 -9223372036854775808");
+
+	/* a full no_grow strbuf fails, and stays failed until cleared */
+	unsigned char mem[200];
+	size_t size = strbuf_struct_size() + 8;
+	ls::strbuf n(strbuf_no_grow(mem, size, "", 0));
+	n << 1234567;
+	failures += check_int(n.fail(), 0);
+	n << 89;
+	failures += check_int(n.fail(), 1);
+	n << 0;
+	failures += check_str(n.c_str(), "1234567");
+	n.clear();
+	n.set("");
+	n << 0;
+	failures += check_int(n.fail(), 0);
+	failures += check_str(n.c_str(), "0");
+
+	return failures;
+}
+
+unsigned test_strbuf_hpp(void)
+{
+	unsigned failures = 0;
+
+	failures += test_strbuf_hpp_basics();
+	failures += test_strbuf_hpp_stream();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_strbuf_hpp)
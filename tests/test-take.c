@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-take.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+unsigned test_take_owned(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 250 * sizeof(void *);
+	unsigned char bytes[250 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+	struct eembed_allocator *gea = eembed_global_allocator;
+
+	strbuf_s *sb = strbuf_new("   a string", 11);
+	strbuf_trim_l(sb);
+	strbuf_insert(sb, 1, " new", 4);
+
+	size_t len = 0;
+	char *buf = strbuf_take(sb, &len);
+	failures += check_str(buf, "a new string");
+	failures += check_size_t(len, 12);
+
+	failures += check_size_t(strbuf_len(sb), 0);
+	failures += check_str(strbuf_str(sb), "");
+	failures += check_str(strbuf_append(sb, "more", 4), "more");
+	failures += check_str(buf, "a new string");
+
+	/* and back again */
+	failures += check_ptr(strbuf_adopt(sb, buf, len, 20, NULL), sb);
+	failures += check_ptr(strbuf_str(sb), buf);
+	failures += check_size_t(strbuf_len(sb), 12);
+	failures += check_size_t(strbuf_avail(sb), 7);
+	failures += check_str(strbuf_append(sb, "!", 1), "a new string!");
+
+	/* a taken strbuf can be destroyed without being used again */
+	failures += check_ptr(strbuf_take(sb, NULL), buf);
+	failures += check_str(buf, "a new string!");
+	strbuf_destroy(sb);
+	gea->free(gea, buf);
+
+	/* a caller's buffer, with a short len, gets zeroes past the end */
+	char *mine = (char *)gea->malloc(gea, 16);
+	eembed_memcpy(mine, "0123456789abcdef", 16);
+	sb = strbuf_new(NULL, 0);
+	failures += check_ptr(strbuf_adopt(sb, mine, 4, 16, NULL), sb);
+	failures += check_str(strbuf_str(sb), "0123");
+	failures += check_char(mine[15], '\0');
+	failures += check_ptr(strbuf_adopt(sb, mine, 16, 16, NULL), NULL);
+	failures += check_str(strbuf_str(sb), "0123");
+	strbuf_destroy(sb);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_take_not_owned(void)
+{
+	unsigned failures = 0;
+	struct eembed_allocator *orig = eembed_global_allocator;
+#if !EEMBED_HOSTED
+	const size_t bytes_len = 100 * sizeof(void *);
+	unsigned char bytes[100 * sizeof(void *)];
+	struct eembed_allocator *ea = eembed_bytes_allocator(bytes, bytes_len);
+	eembed_global_allocator = ea;
+#endif
+	struct eembed_allocator *gea = eembed_global_allocator;
+
+	unsigned char mem[200];
+	strbuf_s *sb = strbuf_no_grow(mem, sizeof(mem), "stack", 5);
+
+	/* the no_grow buffer is not the strbuf's to give */
+	failures += check_ptr(strbuf_take(sb, NULL), NULL);
+	failures += check_str(strbuf_str(sb), "stack");
+
+	/* but it may adopt a heap buffer, and then grow */
+	char *buf = (char *)gea->malloc(gea, 8);
+	eembed_memcpy(buf, "heap", 5);
+	failures += check_ptr(strbuf_adopt(sb, buf, 4, 8, gea), sb);
+	strbuf_append(sb, " and more", 9);
+	failures += check_str(strbuf_str(sb), "heap and more");
+	strbuf_destroy(sb);
+
+	/* a shared buffer stays with the other clone */
+	sb = strbuf_new("shared", 6);
+	strbuf_s *clone = strbuf_clone(sb);
+	buf = strbuf_take(clone, NULL);
+	failures += check_str(buf, "shared");
+	failures += check_int(buf != strbuf_str(sb), 1);
+	failures += check_str(strbuf_str(sb), "shared");
+	strbuf_destroy(clone);
+	strbuf_destroy(sb);
+	gea->free(gea, buf);
+
+	eembed_global_allocator = orig;
+	return failures;
+}
+
+unsigned test_take(void)
+{
+	unsigned failures = 0;
+
+	failures += test_take_owned();
+	failures += test_take_not_owned();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_take)
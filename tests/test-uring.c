@@ -0,0 +1,210 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-uring.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf_uring.h"
+#include "echeck.h"
+
+#if EEMBED_HOSTED && (defined(__unix__) || defined(__APPLE__))
+
+#include <errno.h>
+#include <unistd.h>
+
+static size_t read_all(int fd, char *buf, size_t size)
+{
+	size_t used = 0;
+	while (used < size) {
+		ssize_t r = read(fd, buf + used, size - used);
+		if (r <= 0) {
+			break;
+		}
+		used += (size_t)r;
+	}
+	buf[used] = '\0';
+	return used;
+}
+
+static unsigned test_uring_batch(unsigned flags)
+{
+	unsigned failures = 0;
+
+	int fds[2];
+	failures += check_int(pipe(fds), 0);
+
+	strbuf_uring_s *u = strbuf_uring_new(NULL, 4, flags);
+	failures += check_ptr_not_null(u);
+	if (!u) {
+		return failures;
+	}
+	if (flags & STRBUF_URING_NO_IO_URING) {
+		failures += check_int(strbuf_uring_is_io_uring(u), 0);
+	}
+
+	strbuf_s *a = strbuf_new("alpha ", 6);
+	strbuf_s *b = strbuf_new("beta ", 5);
+	strbuf_s *c = strbuf_new("gamma", 5);
+	/* a gap is written as two parts, without closing it */
+	strbuf_insert(c, 1, "--", 2);
+
+	strbuf_s *abc[3] = { a, b, c };
+	failures += check_int(strbuf_uring_writev(u, fds[1], abc, 3, -1, a), 0);
+	failures += check_size_t(strbuf_uring_pending(u), 1);
+	failures += check_int(strbuf_uring_submit(u), 1);
+
+	strbuf_uring_done_s done[4];
+	size_t n = 0;
+	while (n < 3) {
+		n += strbuf_uring_reap(u, done + n, 3 - n, 1);
+	}
+	failures += check_size_t(strbuf_uring_pending(u), 0);
+	failures += check_ptr(done[0].sb, a);
+	failures += check_ptr(done[1].sb, b);
+	failures += check_ptr(done[2].sb, c);
+	failures += check_ptr(done[2].user, a);
+	failures += check_unsigned_long_m((unsigned long)done[2].res, 18,
+					  "res");
+
+	/* a range of one, after the buffers have been given back */
+	strbuf_set(a, "0123456789", 10);
+	failures += check_int(strbuf_uring_write(u, fds[1], a, 2, 3, -1, b), 0);
+	failures += check_int(strbuf_uring_write(u, fds[1], a, 8, 3, -1, b),
+			      -EINVAL);
+	failures += check_int(strbuf_uring_submit(u), 1);
+	n = strbuf_uring_reap(u, done, 4, 1);
+	failures += check_size_t(n, 1);
+	failures += check_ptr(done[0].user, b);
+	failures += check_unsigned_long_m((unsigned long)done[0].res, 3,
+					  "res");
+
+	close(fds[1]);
+	char buf[80];
+	read_all(fds[0], buf, sizeof(buf) - 1);
+	failures += check_str(buf, "alpha beta g--amma234");
+	close(fds[0]);
+
+	strbuf_uring_destroy(u);
+	strbuf_destroy(c);
+	strbuf_destroy(b);
+	strbuf_destroy(a);
+
+	return failures;
+}
+
+static unsigned test_uring_full_and_fixed(unsigned flags)
+{
+	unsigned failures = 0;
+
+	int fds[2];
+	failures += check_int(pipe(fds), 0);
+
+	strbuf_uring_s *u = strbuf_uring_new(NULL, 2, flags);
+	failures += check_ptr_not_null(u);
+	if (!u) {
+		return failures;
+	}
+
+	unsigned char mem0[STRBUF_NO_GROW_SIZE(32)];
+	unsigned char mem1[STRBUF_NO_GROW_SIZE(32)];
+	strbuf_s *pool[2];
+	pool[0] = strbuf_no_grow(mem0, sizeof(mem0), "", 0);
+	pool[1] = strbuf_no_grow(mem1, sizeof(mem1), "", 0);
+	/* registering changes nothing, even a string holding a NUL */
+	char *tail = strbuf_reserve_tail(pool[1], 3, NULL);
+	tail[0] = 'a';
+	tail[1] = '\0';
+	tail[2] = 'b';
+	strbuf_commit(pool[1], 3);
+	failures += check_int(strbuf_uring_register(u, pool, 2), 0);
+	failures += check_int(strbuf_uring_register(u, pool, 2), -EBUSY);
+	failures += check_size_t(strbuf_len(pool[1]), 3);
+	failures += check_char(strbuf_char(pool[1], 2), 'b');
+	strbuf_set(pool[1], "", 0);
+
+	strbuf_append(pool[0], "fixed ", 6);
+	strbuf_append(pool[1], "buffers", 7);
+	for (size_t i = 0; i < 2; ++i) {
+		size_t len = strbuf_len(pool[i]);
+		failures += check_int(strbuf_uring_write(u, fds[1], pool[i], 0,
+							 len, -1, NULL), 0);
+	}
+	failures += check_int(strbuf_uring_write(u, fds[1], pool[0], 0, 1, -1,
+						 NULL), -EBUSY);
+	failures += check_int(strbuf_uring_submit(u), 2);
+
+	/* a buffer is only handed back once its own write is done */
+	strbuf_uring_done_s done[2];
+	size_t n = 0;
+	while (n < 2) {
+		n += strbuf_uring_reap(u, done + n, 1, 1);
+	}
+	failures += check_int(done[0].sb != done[1].sb, 1);
+	failures += check_int(done[0].res > 0 && done[1].res > 0, 1);
+
+	close(fds[1]);
+	char buf[80];
+	size_t len = read_all(fds[0], buf, sizeof(buf) - 1);
+	failures += check_size_t(len, 13);
+	close(fds[0]);
+
+	strbuf_uring_destroy(u);
+	strbuf_destroy(pool[1]);
+	strbuf_destroy(pool[0]);
+
+	return failures;
+}
+
+/* a failed write is still reaped, with its error */
+static unsigned test_uring_bad_fd(unsigned flags)
+{
+	unsigned failures = 0;
+
+	strbuf_uring_s *u = strbuf_uring_new(NULL, 2, flags);
+	failures += check_ptr_not_null(u);
+	if (!u) {
+		return failures;
+	}
+
+	strbuf_s *a = strbuf_new("lost", 4);
+	failures += check_int(strbuf_uring_write(u, -1, a, 0, 4, -1, NULL), 0);
+	failures += check_int(strbuf_uring_submit(u) >= 0, 1);
+
+	strbuf_uring_done_s done[1];
+	size_t n = strbuf_uring_reap(u, done, 1, 1);
+	failures += check_size_t(n, 1);
+	failures += check_ptr(done[0].sb, a);
+	failures += check_int((int)done[0].res, -EBADF);
+	failures += check_size_t(strbuf_uring_pending(u), 0);
+
+	strbuf_uring_destroy(u);
+	strbuf_destroy(a);
+
+	return failures;
+}
+
+unsigned test_uring(void)
+{
+	unsigned failures = 0;
+
+	failures += test_uring_batch(0);
+	failures += test_uring_batch(STRBUF_URING_NO_IO_URING);
+	failures += test_uring_full_and_fixed(0);
+	failures += test_uring_full_and_fixed(STRBUF_URING_NO_IO_URING);
+	failures += test_uring_bad_fd(0);
+	failures += test_uring_bad_fd(STRBUF_URING_NO_IO_URING);
+
+	return failures;
+}
+
+#else
+
+unsigned test_uring(void)
+{
+	struct eembed_log *log = eembed_out_log;
+	log->append_s(log, " (skipping test_uring)");
+	log->append_eol(log);
+	return 0;
+}
+
+#endif
+
+ECHECK_TEST_MAIN(test_uring)
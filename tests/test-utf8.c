@@ -0,0 +1,109 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* test-utf8.c */
+/* Copyright (C) 2020 Eric Herman <eric@freesa.org> */
+
+#include "strbuf.h"
+#include "echeck.h"
+
+unsigned test_utf8_valid_inner(const char *in, int expected)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, in, eembed_strlen(in));
+
+	failures += check_int_m(strbuf_utf8_valid(sb), expected, in);
+	/* the second call may be answered from the cached flag */
+	failures += check_int_m(strbuf_utf8_valid(sb), expected, in);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_utf8_len_offset(void)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	/* 1, 2, 3 and 4 byte code points, repeated to span several words */
+	const char *s = "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80"
+	    "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80";
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, s, eembed_strlen(s));
+
+	failures += check_size_t(strbuf_len(sb), 20);
+	failures += check_size_t(strbuf_utf8_len(sb), 8);
+
+	size_t offsets[] = { 0, 1, 3, 6, 10, 11, 13, 16, 20, 20 };
+	for (size_t i = 0; i < 10; ++i) {
+		failures += check_size_t(strbuf_utf8_offset(sb, i), offsets[i]);
+	}
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_utf8_flag_kept(void)
+{
+	unsigned failures = 0;
+
+	size_t buf_size = 125 * sizeof(void *);
+	unsigned char buf[buf_size];
+	strbuf_s *sb = strbuf_no_grow(buf, buf_size, "caf\xC3\xA9", 5);
+
+	failures += check_int(strbuf_utf8_valid(sb), 1);
+
+	strbuf_append(sb, " \xE2\x82\xAC", 4);
+	strbuf_append_int(sb, 42);
+	strbuf_prepend(sb, "  ", 2);
+	strbuf_trim(sb);
+	failures += check_int(strbuf_utf8_valid(sb), 1);
+
+	/* an invalid append drops the flag, and the check finds it */
+	strbuf_append(sb, "\xC3", 1);
+	failures += check_int(strbuf_utf8_valid(sb), 0);
+
+	strbuf_set(sb, "ok", 2);
+	failures += check_int(strbuf_utf8_valid(sb), 1);
+
+	/* bytes written through expose are not trusted */
+	char *raw = strbuf_expose(sb, NULL);
+	raw[2] = (char)0xFF;
+	strbuf_return(sb);
+	failures += check_int(strbuf_utf8_valid(sb), 0);
+
+	strbuf_destroy(sb);
+
+	return failures;
+}
+
+unsigned test_utf8(void)
+{
+	unsigned failures = 0;
+
+	failures += test_utf8_valid_inner("", 1);
+	failures += test_utf8_valid_inner("plain ASCII text, long enough", 1);
+	failures += test_utf8_valid_inner("na\xC3\xAFve caf\xC3\xA9", 1);
+	failures += test_utf8_valid_inner("\xE2\x82\xAC \xF0\x9F\x98\x80", 1);
+	failures += test_utf8_valid_inner("\xF4\x8F\xBF\xBF", 1);
+	failures += test_utf8_valid_inner("\xED\x9F\xBF", 1);
+
+	failures += test_utf8_valid_inner("\x80", 0);
+	failures += test_utf8_valid_inner("\xC0\xAF", 0);
+	failures += test_utf8_valid_inner("\xE0\x80\xAF", 0);
+	failures += test_utf8_valid_inner("\xED\xA0\x80", 0);
+	failures += test_utf8_valid_inner("\xF4\x90\x80\x80", 0);
+	failures += test_utf8_valid_inner("\xF5\x80\x80\x80", 0);
+	failures += test_utf8_valid_inner("abcdefgh\xE2\x82", 0);
+	failures += test_utf8_valid_inner("\xE2\x82x", 0);
+
+	failures += test_utf8_len_offset();
+	failures += test_utf8_flag_kept();
+
+	return failures;
+}
+
+ECHECK_TEST_MAIN(test_utf8)